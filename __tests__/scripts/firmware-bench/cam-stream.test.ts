@@ -0,0 +1,67 @@
+/**
+ * Camera Stream Parser Tests
+ *
+ * @jest-environment node
+ */
+
+import { countSkipped, parseHeaders, splitParts } from '@/scripts/firmware-bench/cam-stream';
+
+function part(seq: number, body: string): string {
+  return `--frame\r\nContent-Type: image/jpeg\r\nContent-Length: ${body.length}\r\n` +
+    `X-Frame-Seq: ${seq}\r\nX-Timestamp-Us: ${seq * 100000}\r\n\r\n${body}\r\n`;
+}
+
+describe('parseHeaders', () => {
+  it('lower-cases names and trims values', () => {
+    expect(parseHeaders('Content-Length:  42 \r\nX-Frame-Seq: 7')).toEqual({
+      'content-length': '42',
+      'x-frame-seq': '7',
+    });
+  });
+
+  it('ignores lines without a colon', () => {
+    expect(parseHeaders('--frame\r\nX-Grab-Us: 900')).toEqual({ 'x-grab-us': '900' });
+  });
+});
+
+describe('splitParts', () => {
+  it('splits complete parts and keeps a partial one', () => {
+    const stream = part(1, 'AAAA') + part(2, 'BBBBBB') + part(3, 'CCCC').slice(0, 40);
+    const { parts, rest } = splitParts(Buffer.from(stream, 'latin1'));
+    expect(parts.map((p) => p.headers['x-frame-seq'])).toEqual(['1', '2']);
+    expect(parts.map((p) => p.bytes)).toEqual([4, 6]);
+    expect(rest.toString('latin1')).toBe('\r\n' + part(3, 'CCCC').slice(0, 40));
+  });
+
+  it('waits for a body that has not fully arrived', () => {
+    const whole = part(1, 'AAAAAAAA');
+    const first = splitParts(Buffer.from(whole.slice(0, whole.length - 6), 'latin1'));
+    expect(first.parts).toEqual([]);
+
+    const second = splitParts(Buffer.concat([first.rest, Buffer.from(whole.slice(-6), 'latin1')]));
+    expect(second.parts).toHaveLength(1);
+    expect(second.parts[0].bytes).toBe(8);
+  });
+
+  it('does not mistake a CRLF pair inside the body for a header end', () => {
+    const { parts } = splitParts(Buffer.from(part(1, 'A\r\n\r\nB') + part(2, 'C'), 'latin1'));
+    expect(parts.map((p) => p.headers['x-frame-seq'])).toEqual(['1', '2']);
+  });
+
+  it('skips header blocks without a Content-Length', () => {
+    const { parts } = splitParts(Buffer.from('HTTP preamble\r\n\r\n' + part(5, 'AB'), 'latin1'));
+    expect(parts).toHaveLength(1);
+    expect(parts[0].headers['x-frame-seq']).toBe('5');
+  });
+});
+
+describe('countSkipped', () => {
+  it('counts gaps in the sequence', () => {
+    expect(countSkipped([{ seq: 1 }, { seq: 2 }, { seq: 5 }, { seq: 6 }, { seq: 8 }])).toBe(3);
+  });
+
+  it('counts nothing for a contiguous run', () => {
+    expect(countSkipped([{ seq: 10 }, { seq: 11 }, { seq: 12 }])).toBe(0);
+    expect(countSkipped([])).toBe(0);
+  });
+});
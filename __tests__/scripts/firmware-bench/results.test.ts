@@ -0,0 +1,124 @@
+/**
+ * Firmware Benchmark Result Comparison Tests
+ *
+ * @jest-environment node
+ */
+
+import {
+  BenchResult,
+  BenchTarget,
+  RESULT_FORMAT,
+  compareResults,
+  formatRegressions,
+} from '@/scripts/firmware-bench/results';
+
+function result(metrics: Record<string, number>, target: BenchTarget = 'stepper'): BenchResult {
+  return {
+    format: RESULT_FORMAT,
+    target,
+    label: '',
+    firmware: null,
+    endpoint: '',
+    startedAt: '2026-01-01T00:00:00.000Z',
+    durationS: 0,
+    options: {},
+    metrics,
+    phases: {},
+    devicePerf: null,
+  };
+}
+
+function regressed(base: Record<string, number>, current: Record<string, number>, tolerancePct = 10) {
+  return compareResults(result(base), result(current), tolerancePct).map((r) => r.metric);
+}
+
+describe('compareResults', () => {
+  describe('lower is better', () => {
+    it('flags an increase beyond the tolerance', () => {
+      const regressions = compareResults(
+        result({ rtt_p99_ms: 10 }), result({ rtt_p99_ms: 12 }), 10);
+      expect(regressions).toHaveLength(1);
+      expect(regressions[0]).toMatchObject({ metric: 'rtt_p99_ms', baseline: 10, current: 12 });
+      expect(regressions[0].changePct).toBeCloseTo(20);
+    });
+
+    it('accepts a change within the tolerance', () => {
+      expect(regressed({ rtt_p99_ms: 10 }, { rtt_p99_ms: 10.5 })).toEqual([]);
+    });
+
+    it('accepts an improvement', () => {
+      expect(regressed({ rtt_p99_ms: 10 }, { rtt_p99_ms: 2 })).toEqual([]);
+    });
+  });
+
+  describe('higher is better', () => {
+    it.each(['max_sustainable_hz', 'stream_fps', 'sensor_stream_hz'])('flags a drop in %s', (metric) => {
+      expect(regressed({ [metric]: 800 }, { [metric]: 400 })).toEqual([metric]);
+      expect(regressed({ [metric]: 800 }, { [metric]: 1600 })).toEqual([]);
+    });
+
+    it('reports the drop as a negative change', () => {
+      const [regression] = compareResults(
+        result({ max_sustainable_hz: 800 }), result({ max_sustainable_hz: 400 }), 10);
+      expect(regression.changePct).toBeCloseTo(-50);
+    });
+  });
+
+  describe('noise floors', () => {
+    it('ignores latencies that stay under the floor', () => {
+      expect(regressed({ rtt_p50_ms: 0.4 }, { rtt_p50_ms: 0.9 })).toEqual([]);
+    });
+
+    it('flags latencies that cross the floor', () => {
+      expect(regressed({ rtt_p50_ms: 0.8 }, { rtt_p50_ms: 1.2 })).toEqual(['rtt_p50_ms']);
+    });
+
+    it('honours a custom floor', () => {
+      expect(compareResults(result({ rtt_p99_ms: 2 }), result({ rtt_p99_ms: 4 }), 10, 5)).toEqual([]);
+    });
+
+    it('ignores loss under 0.1%', () => {
+      expect(regressed({ latency_loss_pct: 0.02 }, { latency_loss_pct: 0.09 })).toEqual([]);
+    });
+  });
+
+  describe('zero baseline', () => {
+    it('flags any increase as new', () => {
+      const [regression] = compareResults(
+        result({ device_overruns: 0 }), result({ device_overruns: 3 }), 10);
+      expect(regression.metric).toBe('device_overruns');
+      expect(regression.changePct).toBe(Infinity);
+    });
+
+    it('flags loss appearing above the floor', () => {
+      expect(regressed({ soak_loss_pct: 0 }, { soak_loss_pct: 0.5 })).toEqual(['soak_loss_pct']);
+    });
+
+    it('accepts zero staying zero', () => {
+      expect(regressed({ device_overruns: 0 }, { device_overruns: 0 })).toEqual([]);
+    });
+  });
+
+  it('skips metrics missing from the current run', () => {
+    expect(regressed({ rtt_p99_ms: 10, soak_rtt_p99_ms: 10 }, { rtt_p99_ms: 10 })).toEqual([]);
+  });
+
+  it('refuses to compare different targets', () => {
+    expect(() => compareResults(result({}, 'stepper'), result({}, 'fc'), 10)).toThrow();
+  });
+});
+
+describe('formatRegressions', () => {
+  it('reports a clean comparison', () => {
+    expect(formatRegressions([])).toBe('No regressions against the baseline.');
+  });
+
+  it('formats percentages and new metrics', () => {
+    const text = formatRegressions([
+      { metric: 'rtt_p99_ms', baseline: 10, current: 12, changePct: 20 },
+      { metric: 'device_overruns', baseline: 0, current: 3, changePct: Infinity },
+    ]);
+    expect(text).toContain('REGRESSION rtt_p99_ms: 10 -> 12 (20.0%)');
+    expect(text).toContain('REGRESSION device_overruns: 0 -> 3 (new)');
+  });
+});
@@ -0,0 +1,81 @@
+/**
+ * Firmware Benchmark Statistics Tests
+ *
+ * @jest-environment node
+ */
+
+import { percentile, round, summarize, summarizeIntervals } from '@/scripts/firmware-bench/stats';
+
+describe('percentile', () => {
+  const sorted = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10];
+
+  it('returns 0 for no samples', () => {
+    expect(percentile([], 50)).toBe(0);
+  });
+
+  it('uses the nearest rank', () => {
+    expect(percentile(sorted, 50)).toBe(5);
+    expect(percentile(sorted, 90)).toBe(9);
+    expect(percentile(sorted, 99)).toBe(10);
+  });
+
+  it('clamps to the first and last sample', () => {
+    expect(percentile(sorted, 0)).toBe(1);
+    expect(percentile(sorted, 100)).toBe(10);
+  });
+});
+
+describe('summarize', () => {
+  it('returns zeros for no samples', () => {
+    expect(summarize([])).toEqual({
+      count: 0, min: 0, mean: 0, p50: 0, p90: 0, p99: 0, p999: 0, max: 0,
+    });
+  });
+
+  it('sorts numerically, not as strings', () => {
+    const summary = summarize([10, 9, 100, 1]);
+    expect(summary.min).toBe(1);
+    expect(summary.max).toBe(100);
+    expect(summary.p50).toBe(9);
+    expect(summary.mean).toBe(30);
+  });
+
+  it('does not reorder the caller\'s samples', () => {
+    const samples = [3, 1, 2];
+    summarize(samples);
+    expect(samples).toEqual([3, 1, 2]);
+  });
+
+  it('rounds to three digits', () => {
+    expect(summarize([1 / 3]).mean).toBe(0.333);
+  });
+
+  it('reports the tail of a large run', () => {
+    const samples = Array.from({ length: 1000 }, (_, i) => i + 1);
+    const summary = summarize(samples);
+    expect(summary.count).toBe(1000);
+    expect(summary.p99).toBe(990);
+    expect(summary.p999).toBe(999);
+  });
+});
+
+describe('summarizeIntervals', () => {
+  it('has no jitter for a steady stream', () => {
+    const summary = summarizeIntervals([0, 10, 20, 30]);
+    expect(summary.count).toBe(3);
+    expect(summary.mean).toBe(10);
+    expect(summary.jitter).toBe(0);
+  });
+
+  it('reports jitter as the sample standard deviation', () => {
+    const summary = summarizeIntervals([0, 10, 30]);
+    expect(summary.mean).toBe(15);
+    expect(summary.jitter).toBe(round(Math.sqrt(50)));
+  });
+
+  it('handles fewer than two timestamps', () => {
+    expect(summarizeIntervals([5]).count).toBe(0);
+    expect(summarizeIntervals([5]).jitter).toBe(0);
+    expect(summarizeIntervals([]).count).toBe(0);
+  });
+});
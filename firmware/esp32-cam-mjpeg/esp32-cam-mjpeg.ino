@@ -2,17 +2,50 @@
  * ESP32-CAM MJPEG WiFi Streamer — V1 Hardware
  *
  * Streams MJPEG video over HTTP for host PC VLM inference.
- * Single endpoint: GET /stream returns multipart/x-mixed-replace JPEG frames.
+ * GET /stream returns multipart/x-mixed-replace JPEG frames; several
+ * clients (VLM host, debug dashboard, recorder) can stream at once.
+ * GET /capture returns a single fresh JPEG for on-demand VLM inference.
+ * GET /control changes resolution, JPEG quality and FPS at runtime, and
+ * enables adaptive bitrate (quality/FPS follow send time and RSSI).
+ * Without PSRAM the resolution cannot go above the boot FRAME_SIZE.
+ * Every frame carries X-Timestamp-Us and timing headers; /status exposes
+ * p50/p95/p99 latency histograms (latency_histogram.h).
+ * GET /time answers the host's clock sync pings (time_sync.h); frames then
+ * also carry X-Host-Timestamp-Us on the host clock, the same timebase as
+ * the stepper's odometry.
+ * GET /perf reports cycle-counter timings of the capture loop, socket
+ * writes and HTTP handlers (perf_profiler.h); ?reset=1 clears them.
+ * With no stream client and no requests for the idle timeout the board
+ * drops to 80 MHz with WiFi modem sleep, the sensor already in standby;
+ * any request wakes it. GET /power reports and configures this
+ * (power_manager.h).
  *
  * Hardware: ESP32-CAM (AI-Thinker) board
  * Default: QVGA (320x240) at ~10fps
  *
  * Architecture: ESP32-CAM -> WiFi -> Host PC (Qwen3-VL)
+ *
+ * Tasks:
+ *   captureTask  grabs each frame once and publishes it to the frame hub;
+ *                serves /capture requests and idles the sensor when unused
+ *   streamTask   one per client slot; sends the newest frame straight from
+ *                the camera buffer, skipping frames while it is behind
+ *   httpd        esp_http_server task: /, /status, /capture, /control,
+ *                /time, /perf, /power, /stream hand-off
+ *                (the stream socket is then owned by a streamTask)
  */
 
 #include "esp_camera.h"
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
 #include <WiFi.h>
-#include <WebServer.h>
+#include "frame_hub.h"
+#include "latency_histogram.h"
+#include "perf_profiler.h"
+#define POWER_USE_WIFI 1
+#include "power_manager.h"
+#include "time_sync.h"
 
 // =============================================================================
 // WiFi Configuration
@@ -51,28 +84,152 @@ const char* WIFI_PASSWORD = "YOUR_WIFI_PASSWORD";
 // Streaming Configuration
 // =============================================================================
 
+// Boot defaults; all three can be changed at runtime via /control
 #define FRAME_SIZE    FRAMESIZE_QVGA   // 320x240
 #define JPEG_QUALITY  12               // 0-63, lower = better quality
 #define TARGET_FPS    10
 
-const int FRAME_INTERVAL_MS = 1000 / TARGET_FPS;
+// Buffers are sized for this resolution at init; /control cannot exceed it
+#define MAX_FRAME_SIZE FRAMESIZE_SVGA
+
 const char* STREAM_BOUNDARY = "frame";
 const char* STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=frame";
 
+#define STREAM_MAX_CLIENTS  3      // Concurrent /stream clients (<= HUB_MAX_CLIENTS)
+#define CAPTURE_TRIGGER_MODE true  // Sensor standby between /capture requests when not streaming
+#define CAPTURE_TIMEOUT_MS  1000   // Give up waiting for an on-demand frame
+#define CAPTURE_BACKOFF_MIN_MS 10  // First retry delay after esp_camera_fb_get() fails
+#define CAPTURE_BACKOFF_MAX_MS 500
+
+// Adaptive bitrate: evaluated once per interval while streaming
+#define ADAPT_INTERVAL_MS   1000
+#define ADAPT_QUALITY_WORST 40     // Highest (worst) JPEG quality value it may pick
+#define ADAPT_QUALITY_STEP  4
+#define ADAPT_FPS_MIN       2
+#define ADAPT_RSSI_WEAK     -75    // dBm: degrade below this
+#define ADAPT_RSSI_GOOD     -65    // dBm: recover above this
+// Frame buffers: one held as the newest frame, one per client still sending
+// an older frame, one being filled by the driver. 3 lets one slow client lag
+// without stalling capture; raise it (via /control fb_count) for more.
+#define CAMERA_FB_COUNT     3
+#define CAMERA_FB_MAX       HUB_MAX_FRAMES
+#define CAPTURE_CORE        1
+#define STREAM_CORE         0
+#define HTTPD_CORE          0
+#define HTTP_PORT           80
+#define POWER_CHECK_MS      1000   // Idle check interval while nobody streams
+
 // =============================================================================
 // Global Objects
 // =============================================================================
 
-WebServer server(80);
+httpd_handle_t camServer = nullptr;
 bool cameraReady = false;
-unsigned long frameCount = 0;
-unsigned long streamStartTime = 0;
+volatile unsigned long frameCount = 0;      // Frames captured since capture started
+volatile unsigned long streamStartTime = 0;
+
+// One streaming client slot, served by its own task. While `active`, the
+// task owns the socket: httpd's close callback only flags `sessionClosed`.
+struct StreamClient {
+  int fd;
+  TaskHandle_t task;
+  volatile bool active;
+  volatile bool sessionClosed;  // httpd has dropped the session
+  uint32_t frames;       // Frames sent to this client
+  uint32_t dropped;      // Frames skipped because the client was still sending
+};
+
+StreamClient streamClients[STREAM_MAX_CLIENTS];
+portMUX_TYPE streamMux = portMUX_INITIALIZER_UNLOCKED;
+TaskHandle_t captureTaskHandle = nullptr;
+
+// On-demand capture (/capture)
+bool triggerMode = CAPTURE_TRIGGER_MODE;
+volatile TaskHandle_t captureWaiter = nullptr;  // httpd task waiting for a frame
+bool sensorStandby = false;                     // Owned by captureTask
+volatile unsigned long captureCount = 0;
+
+// Frame scheduler statistics (captureTask)
+volatile unsigned long framesSkipped = 0;   // Deadlines missed and dropped
+volatile unsigned long captureErrors = 0;   // esp_camera_fb_get() failures
+
+struct FrameSizeInfo {
+  const char* name;
+  framesize_t size;
+  uint16_t width;
+  uint16_t height;
+};
+
+static const FrameSizeInfo FRAME_SIZES[] = {
+  {"qqvga", FRAMESIZE_QQVGA, 160, 120},
+  {"qcif",  FRAMESIZE_QCIF,  176, 144},
+  {"hqvga", FRAMESIZE_HQVGA, 240, 176},
+  {"qvga",  FRAMESIZE_QVGA,  320, 240},
+  {"cif",   FRAMESIZE_CIF,   400, 296},
+  {"hvga",  FRAMESIZE_HVGA,  480, 320},
+  {"vga",   FRAMESIZE_VGA,   640, 480},
+  {"svga",  FRAMESIZE_SVGA,  800, 600},
+};
+
+// Requested settings: written by /control (httpd), applied by captureTask
+struct CameraSettings {
+  framesize_t frameSize;
+  int quality;         // 0-63, lower = better
+  int fps;
+  bool adaptive;
+  int fbCount;         // Driver frame buffers; changing it re-initializes the camera
+};
+
+CameraSettings cameraSettings = {FRAME_SIZE, JPEG_QUALITY, TARGET_FPS, false, CAMERA_FB_COUNT};
+volatile bool settingsDirty = false;
+
+// Applied values (owned by captureTask); adaptive mode moves these between
+// the requested settings (best) and its limits (worst)
+volatile framesize_t activeFrameSize = FRAME_SIZE;
+volatile int activeQuality = JPEG_QUALITY;
+volatile int activeFps = TARGET_FPS;
+int activeFbCount = 0;                      // Set by initCamera()
+bool fbInPsram = false;
+framesize_t bufferFrameSize = MAX_FRAME_SIZE;  // Largest size the buffers hold
+
+// Smoothed per-frame send time across all stream clients, microseconds
+volatile uint32_t sendTimeAvgUs = 0;
+
+// Response buffer for /status and /control (only used from the httpd task)
+char statusBuffer[1024];
+
+// Per-frame timing, microseconds
+LatencyHistogram grabHist;   // esp_camera_fb_get() latency
+LatencyHistogram sendHist;   // Writing one frame to one client
+LatencyHistogram ageHist;    // Sensor timestamp -> send complete ("glass to wire")
+
+// Profiled sections (perf_profiler.h), reported by /perf
+enum PerfId {
+  PERF_CAPTURE,      // One captured frame: grab, publish, adapt (budget: frame interval)
+  PERF_SOCKET_SEND,  // One sendAll() to a stream client
+  PERF_HTTP_CAPTURE, // One /capture request, including the wait for a frame
+  PERF_HTTP_STATUS,  // Building one /status reply
+  PERF_COUNT
+};
+
+PerfSection perfSections[PERF_COUNT] = {
+  {"capture",      1000000 / TARGET_FPS},
+  {"socket_send",  0},
+  {"http_capture", 0},
+  {"http_status",  0},
+};
 
 // =============================================================================
 // Camera Initialization
 // =============================================================================
 
-bool initCamera() {
+/**
+ * Initialize the camera with `fbCount` frame buffers. With PSRAM the
+ * buffers go there, sized for MAX_FRAME_SIZE so /control can switch
+ * resolution freely. Without PSRAM only one DRAM buffer at the active
+ * resolution fits, and /control rejects anything larger.
+ */
+bool initCamera(int fbCount) {
   camera_config_t config;
   config.ledc_channel = LEDC_CHANNEL_0;
   config.ledc_timer = LEDC_TIMER_0;
@@ -94,10 +251,22 @@ bool initCamera() {
   config.pin_reset = RESET_GPIO_NUM;
   config.xclk_freq_hz = 20000000;
   config.pixel_format = PIXFORMAT_JPEG;
-  config.frame_size = FRAME_SIZE;
-  config.jpeg_quality = JPEG_QUALITY;
-  config.fb_count = 2;  // Double buffer for smooth streaming
-  config.grab_mode = CAMERA_GRAB_LATEST;
+  config.jpeg_quality = activeQuality;
+
+  fbInPsram = psramFound();
+  if (fbInPsram) {
+    config.frame_size = MAX_FRAME_SIZE;  // Size the buffers for the largest mode
+    config.fb_count = constrain(fbCount, 1, CAMERA_FB_MAX);
+    config.fb_location = CAMERA_FB_IN_PSRAM;
+    config.grab_mode = CAMERA_GRAB_LATEST;
+  } else {
+    config.frame_size = activeFrameSize;
+    config.fb_count = 1;                 // grabFrame() frees it before each grab
+    config.fb_location = CAMERA_FB_IN_DRAM;
+    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+  }
+  activeFbCount = config.fb_count;
+  bufferFrameSize = config.frame_size;
 
   esp_err_t err = esp_camera_init(&config);
   if (err != ESP_OK) {
@@ -116,102 +285,822 @@ bool initCamera() {
     sensor->set_exposure_ctrl(sensor, 1);  // Auto exposure
     sensor->set_aec2(sensor, 1);           // Auto exposure DSP
     sensor->set_gain_ctrl(sensor, 1);      // Auto gain
+    sensor->set_framesize(sensor, activeFrameSize);
   }
 
-  Serial.println("[CAM] Camera initialized");
+  Serial.printf("[CAM] Camera initialized: %d frame buffers in %s\n",
+    activeFbCount, fbInPsram ? "PSRAM" : "DRAM");
   return true;
 }
 
 // =============================================================================
-// HTTP Stream Handler
+// Capture Task
 // =============================================================================
 
-void handleStream() {
-  WiFiClient client = server.client();
+int64_t frameTimestampUs(const camera_fb_t* fb) {
+  return (int64_t)fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec;
+}
+
+/**
+ * Put the OV2640 into (or out of) standby via COM2, keeping its registers.
+ * Waking takes about one frame time, far less than esp_camera_init().
+ */
+void setSensorStandby(bool standby) {
+  if (standby == sensorStandby) {
+    return;
+  }
+  sensor_t* sensor = esp_camera_sensor_get();
+  if (sensor) {
+    sensor->set_reg(sensor, 0x100 | 0x09, 0x10, standby ? 0x10 : 0x00);  // Bank 1, COM2 bit 4
+  }
+  sensorStandby = standby;
+}
+
+/**
+ * esp_camera_fb_get() for the capture task. With a single driver buffer
+ * (no PSRAM, or fb_count=1) the hub's newest frame is the very buffer the
+ * driver needs to fill next, so the hub lets go of it first; the grab then
+ * waits only for readers still sending it.
+ */
+camera_fb_t* grabFrame() {
+  if (activeFbCount == 1) {
+    hub_drop_latest();
+  }
+  return esp_camera_fb_get();
+}
+
+/**
+ * Grab one frame for a /capture request and publish it. Frames buffered
+ * before the sensor woke up are discarded, so the result is never older
+ * than the request.
+ */
+void captureOnce() {
+  bool wasStandby = sensorStandby;
+  setSensorStandby(false);
+  int64_t requestUs = esp_timer_get_time();
+
+  for (int attempt = 0; attempt <= activeFbCount; attempt++) {
+    int64_t grabStart = esp_timer_get_time();
+    camera_fb_t* fb = grabFrame();
+    if (!fb) {
+      break;
+    }
+    if (!wasStandby || frameTimestampUs(fb) >= requestUs) {
+      uint32_t grabUs = esp_timer_get_time() - grabStart;
+      hist_record(grabHist, grabUs);
+      hub_publish(fb, grabUs);
+      captureCount++;
+      break;
+    }
+    esp_camera_fb_return(fb);
+  }
+}
+
+// =============================================================================
+// Camera Settings & Adaptive Bitrate (executed on captureTask)
+// =============================================================================
+
+int frameIntervalMs() {
+  return 1000 / activeFps;
+}
+
+const FrameSizeInfo* findFrameSize(framesize_t size) {
+  for (const FrameSizeInfo& info : FRAME_SIZES) {
+    if (info.size == size) {
+      return &info;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Apply settings changed through /control. Called between frames, so the
+ * sensor is never reconfigured while a frame is being read out.
+ */
+void applyCameraSettings() {
+  if (!settingsDirty) {
+    return;
+  }
+  settingsDirty = false;
 
-  // Send multipart header
-  String response = "HTTP/1.1 200 OK\r\n";
-  response += "Content-Type: " + String(STREAM_CONTENT_TYPE) + "\r\n";
-  response += "Access-Control-Allow-Origin: *\r\n";
-  response += "Cache-Control: no-cache\r\n";
-  response += "Connection: keep-alive\r\n\r\n";
-  client.print(response);
+  CameraSettings wanted = cameraSettings;
+  if (wanted.fbCount != activeFbCount && fbInPsram) {
+    activeFrameSize = wanted.frameSize;
+    activeQuality = wanted.quality;
+    activeFps = wanted.fps;
+    reinitCamera(wanted.fbCount);
+    return;
+  }
 
-  streamStartTime = millis();
-  frameCount = 0;
+  sensor_t* sensor = esp_camera_sensor_get();
+  if (sensor) {
+    if (wanted.frameSize != activeFrameSize) {
+      sensor->set_framesize(sensor, wanted.frameSize);
+    }
+    sensor->set_quality(sensor, wanted.quality);
+  }
+  activeFrameSize = wanted.frameSize;
+  activeQuality = wanted.quality;
+  activeFps = wanted.fps;
+}
 
-  Serial.printf("[CAM] Stream started for %s\n", client.remoteIP().toString().c_str());
+/**
+ * Re-initialize the driver with a new buffer count. Every buffer must be
+ * back with the driver first: drop the hub's newest frame and give
+ * clients still sending a moment to finish.
+ */
+void reinitCamera(int fbCount) {
+  hub_drop_latest();
+  for (int i = 0; i < 100 && hub_frames_in_use() > 0; i++) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  if (hub_frames_in_use() > 0) {
+    Serial.println("[CAM] Buffers still in use — fb_count unchanged");
+    return;
+  }
+  esp_camera_deinit();
+  sensorStandby = false;
+  cameraReady = initCamera(fbCount);
+}
 
-  while (client.connected()) {
-    unsigned long frameStart = millis();
+/**
+ * Stream tasks report how long each frame took to send.
+ */
+void recordSendTime(uint32_t us) {
+  portENTER_CRITICAL(&streamMux);
+  sendTimeAvgUs = sendTimeAvgUs == 0 ? us : (sendTimeAvgUs * 7 + us) / 8;
+  portEXIT_CRITICAL(&streamMux);
+}
+
+/**
+ * One adaptive bitrate step. Degrade when frames take most of the frame
+ * interval to send or RSSI is weak: first raise the JPEG quality value
+ * (smaller frames), then lower FPS. Recover in the opposite order when the
+ * link has clear headroom, never beyond the requested settings.
+ */
+void adaptBitrate() {
+  uint32_t budgetUs = frameIntervalMs() * 1000UL;
+  uint32_t sendUs = sendTimeAvgUs;
+  int rssi = WiFi.RSSI();
+  int quality = activeQuality;
+  int fps = activeFps;
+
+  if (sendUs > budgetUs * 8 / 10 || rssi < ADAPT_RSSI_WEAK) {
+    if (quality < ADAPT_QUALITY_WORST) {
+      quality = min(quality + ADAPT_QUALITY_STEP, ADAPT_QUALITY_WORST);
+    } else if (fps > ADAPT_FPS_MIN) {
+      fps--;
+    }
+  } else if (sendUs < budgetUs * 4 / 10 && rssi > ADAPT_RSSI_GOOD) {
+    if (fps < cameraSettings.fps) {
+      fps++;
+    } else if (quality > cameraSettings.quality) {
+      quality = max(quality - ADAPT_QUALITY_STEP, cameraSettings.quality);
+    }
+  }
 
-    camera_fb_t* fb = esp_camera_fb_get();
+  if (quality != activeQuality) {
+    sensor_t* sensor = esp_camera_sensor_get();
+    if (sensor) {
+      sensor->set_quality(sensor, quality);
+    }
+    activeQuality = quality;
+  }
+  activeFps = fps;
+}
+
+void notifyCaptureWaiter() {
+  TaskHandle_t waiter = captureWaiter;
+  if (waiter) {
+    captureWaiter = nullptr;
+    xTaskNotifyGive(waiter);
+  }
+}
+
+/**
+ * Capture frames at activeFps while at least one client is streaming and
+ * publish them to the frame hub. With no stream clients, only /capture
+ * requests are served and (in trigger mode) the sensor sits in standby.
+ */
+void captureTask(void* param) {
+  unsigned long lastAdapt = 0;
+  int64_t deadline = 0;       // When the next frame is due (esp_timer us)
+  uint32_t backoffMs = 0;
+
+  for (;;) {
+    applyCameraSettings();
+
+    if (hub_reader_count() == 0) {
+      if (triggerMode) {
+        setSensorStandby(true);
+      }
+      // Woken by a stream, /capture or /control; check for idle meanwhile
+      while (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(POWER_CHECK_MS))) {
+        power_update(captureWaiter != nullptr);
+      }
+      applyCameraSettings();
+      if (captureWaiter) {
+        captureOnce();
+        notifyCaptureWaiter();
+      }
+      if (hub_reader_count() > 0) {
+        setSensorStandby(false);
+        streamStartTime = millis();
+        frameCount = 0;
+        deadline = esp_timer_get_time();
+      }
+      continue;
+    }
+
+    // Sleep until this frame's absolute deadline; time spent sending or
+    // grabbing the previous frame does not push the schedule back
+    int64_t now = esp_timer_get_time();
+    if (deadline > now) {
+      vTaskDelay(pdMS_TO_TICKS((deadline - now) / 1000));
+    }
+
+    uint32_t passStart = perf_cycles();
+    int64_t grabStart = esp_timer_get_time();
+    camera_fb_t* fb = grabFrame();
     if (!fb) {
-      Serial.println("[CAM] Frame capture failed");
+      // Back off exponentially instead of spinning on a failing sensor
+      captureErrors++;
+      backoffMs = backoffMs == 0 ? CAPTURE_BACKOFF_MIN_MS
+                                 : min(backoffMs * 2, (uint32_t)CAPTURE_BACKOFF_MAX_MS);
+      if (backoffMs == CAPTURE_BACKOFF_MIN_MS) {
+        Serial.println("[CAM] Frame capture failed");
+      }
+      vTaskDelay(pdMS_TO_TICKS(backoffMs));
+      deadline = esp_timer_get_time();
       continue;
     }
+    backoffMs = 0;
+    uint32_t grabUs = esp_timer_get_time() - grabStart;
+    hist_record(grabHist, grabUs);
+    hub_publish(fb, grabUs);
+    frameCount++;
+    notifyCaptureWaiter();
+    power_update(true);   // Streaming: the idle timeout starts when it ends
+
+    if (cameraSettings.adaptive && millis() - lastAdapt >= ADAPT_INTERVAL_MS) {
+      lastAdapt = millis();
+      adaptBitrate();
+    }
+    perfSections[PERF_CAPTURE].budgetUs = frameIntervalMs() * 1000;
+    perf_record_cycles(perfSections[PERF_CAPTURE], perf_cycles() - passStart);
 
-    // Send MJPEG frame with boundary
-    String header = "--" + String(STREAM_BOUNDARY) + "\r\n";
-    header += "Content-Type: image/jpeg\r\n";
-    header += "Content-Length: " + String(fb->len) + "\r\n\r\n";
+    // Next deadline is one interval after this one. If we are more than
+    // half an interval past it, drop those slots rather than bursting
+    // frames to catch up: steady spacing beats peak rate.
+    int64_t intervalUs = frameIntervalMs() * 1000LL;
+    deadline += intervalUs;
+    now = esp_timer_get_time();
+    while (now - deadline > intervalUs / 2) {
+      deadline += intervalUs;
+      framesSkipped++;
+    }
+  }
+}
 
-    client.print(header);
-    client.write(fb->buf, fb->len);
-    client.print("\r\n");
+// =============================================================================
+// Stream Tasks
+// =============================================================================
 
-    esp_camera_fb_return(fb);
-    frameCount++;
+bool sendAll(int fd, const void* data, size_t len) {
+  PERF_SCOPE(perfSections[PERF_SOCKET_SEND]);
+  const uint8_t* p = (const uint8_t*)data;
+  while (len > 0) {
+    int sent = send(fd, p, len, 0);
+    if (sent <= 0) {
+      return false;
+    }
+    p += sent;
+    len -= sent;
+  }
+  return true;
+}
+
+/**
+ * Serve one /stream client: wait for a published frame, send it directly
+ * from the camera buffer, repeat. Frames published while a send is in
+ * progress are skipped, never queued.
+ */
+void streamTask(void* param) {
+  StreamClient* sc = (StreamClient*)param;
+  char header[320];
 
-    // Throttle to target FPS
-    unsigned long elapsed = millis() - frameStart;
-    if (elapsed < FRAME_INTERVAL_MS) {
-      delay(FRAME_INTERVAL_MS - elapsed);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // Woken by handleStream()
+    if (!sc->active) {
+      continue;
+    }
+
+    int n = snprintf(header, sizeof(header),
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: %s\r\n"
+      "Access-Control-Allow-Origin: *\r\n"
+      "Cache-Control: no-cache\r\n"
+      "Connection: keep-alive\r\n\r\n", STREAM_CONTENT_TYPE);
+    bool ok = sendAll(sc->fd, header, n);
+
+    Serial.printf("[CAM] Stream started on socket %d\n", sc->fd);
+    hub_add_reader(sc->task);
+    xTaskNotifyGive(captureTaskHandle);
+
+    uint32_t lastSeq = 0;
+    uint32_t lastSendUs = 0;
+    while (ok && !sc->sessionClosed) {
+      HubFrame* frame = hub_acquire(lastSeq);
+      if (!frame) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        continue;
+      }
+      if (lastSeq != 0 && frame->seq - lastSeq > 1) {
+        sc->dropped += frame->seq - lastSeq - 1;
+      }
+      lastSeq = frame->seq;
+
+      // The send time of this frame is only known afterwards, so each part
+      // reports the previous one (X-Prev-Send-Us)
+      camera_fb_t* fb = frame->fb;
+      int64_t captureUs = frameTimestampUs(fb);
+      int64_t sendStart = esp_timer_get_time();
+      n = snprintf(header, sizeof(header),
+        "--%s\r\n"
+        "Content-Type: image/jpeg\r\n"
+        "Content-Length: %u\r\n"
+        "X-Frame-Seq: %lu\r\n"
+        "X-Timestamp-Us: %lld\r\n"
+        "X-Host-Timestamp-Us: %lld\r\n"
+        "X-Grab-Us: %lu\r\n"
+        "X-Send-Start-Us: %lld\r\n"
+        "X-Prev-Send-Us: %lu\r\n\r\n",
+        STREAM_BOUNDARY, (unsigned)fb->len, (unsigned long)frame->seq,
+        (long long)captureUs, (long long)timesync_to_host(captureUs),
+        (unsigned long)frame->grabUs,
+        (long long)sendStart, (unsigned long)lastSendUs);
+      ok = sendAll(sc->fd, header, n) &&
+           sendAll(sc->fd, fb->buf, fb->len) &&
+           sendAll(sc->fd, "\r\n", 2);
+      hub_release(frame);
+      if (ok) {
+        int64_t sendEnd = esp_timer_get_time();
+        lastSendUs = sendEnd - sendStart;
+        sc->frames++;
+        recordSendTime(lastSendUs);
+        hist_record(sendHist, lastSendUs);
+        hist_record(ageHist, sendEnd - captureUs);
+      }
     }
+
+    hub_remove_reader(sc->task);
+    Serial.printf("[CAM] Stream ended: %lu frames sent, %lu dropped\n",
+      (unsigned long)sc->frames, (unsigned long)sc->dropped);
+    releaseStreamSocket(sc);
   }
+}
 
-  float duration = (millis() - streamStartTime) / 1000.0f;
-  Serial.printf("[CAM] Stream ended: %lu frames in %.1fs (%.1f fps)\n",
-    frameCount, duration, frameCount / duration);
+/**
+ * Give the socket back once streaming stops. If httpd already dropped the
+ * session, its close was deferred to us; otherwise ask httpd to close it.
+ */
+void releaseStreamSocket(StreamClient* sc) {
+  portENTER_CRITICAL(&streamMux);
+  bool closeHere = sc->sessionClosed;
+  sc->active = false;
+  portEXIT_CRITICAL(&streamMux);
+
+  if (closeHere) {
+    close(sc->fd);
+  } else {
+    httpd_sess_trigger_close(camServer, sc->fd);
+  }
+}
+
+/**
+ * httpd close_fn. Sockets still owned by a stream task are closed by that
+ * task instead, so the descriptor cannot be reused while it is sending.
+ */
+void onSocketClose(httpd_handle_t hd, int fd) {
+  bool deferred = false;
+  portENTER_CRITICAL(&streamMux);
+  for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+    StreamClient& sc = streamClients[i];
+    if (sc.active && sc.fd == fd) {
+      sc.sessionClosed = true;
+      deferred = true;
+    }
+  }
+  portEXIT_CRITICAL(&streamMux);
+
+  if (deferred) {
+    // Wake the stream task if it is waiting for a frame
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+      if (streamClients[i].fd == fd) {
+        xTaskNotifyGive(streamClients[i].task);
+      }
+    }
+  } else {
+    close(fd);
+  }
+}
+
+int activeStreamCount() {
+  int count = 0;
+  for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+    if (streamClients[i].active) {
+      count++;
+    }
+  }
+  return count;
 }
 
 // =============================================================================
-// HTTP Status Handler
+// HTTP Handlers
 // =============================================================================
 
-void handleStatus() {
+/**
+ * Hand the connection to a free stream slot and return at once, so httpd
+ * keeps serving other requests while the client streams.
+ */
+esp_err_t handleStream(httpd_req_t* req) {
+  power_note_activity();
+  int fd = httpd_req_to_sockfd(req);
+
+  portENTER_CRITICAL(&streamMux);
+  StreamClient* slot = nullptr;
+  for (int i = 0; i < STREAM_MAX_CLIENTS && !slot; i++) {
+    if (!streamClients[i].active) {
+      slot = &streamClients[i];
+      slot->fd = fd;
+      slot->frames = 0;
+      slot->dropped = 0;
+      slot->sessionClosed = false;
+      slot->active = true;
+    }
+  }
+  portEXIT_CRITICAL(&streamMux);
+
+  if (!slot) {
+    httpd_resp_set_status(req, HTTPD_503);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, "{\"error\":\"too_many_clients\"}", HTTPD_RESP_USE_STRLEN);
+  }
+  xTaskNotifyGive(slot->task);
+  return ESP_OK;
+}
+
+/**
+ * Return one JPEG. While streaming, the newest frame is used if it is
+ * fresher than two frame intervals; otherwise the capture task grabs a
+ * new one (503 if that fails). The frame is sent straight from the camera
+ * buffer.
+ */
+esp_err_t handleCapture(httpd_req_t* req) {
+  PERF_SCOPE(perfSections[PERF_HTTP_CAPTURE]);
+  power_note_activity();
+  HubFrame* frame = nullptr;
+  if (hub_reader_count() > 0) {
+    frame = hub_acquire(0);
+    if (frame && esp_timer_get_time() - frameTimestampUs(frame->fb) > 2000LL * frameIntervalMs()) {
+      hub_release(frame);
+      frame = nullptr;
+    }
+  }
+
+  if (!frame) {
+    // Only a frame published after this point answers the request; if the
+    // grab fails or times out, the hub's older frame must not be served
+    uint32_t requestSeq = hub_seq();
+    ulTaskNotifyTake(pdTRUE, 0);  // Clear any stale notification
+    captureWaiter = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(captureTaskHandle);
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CAPTURE_TIMEOUT_MS));
+    captureWaiter = nullptr;
+    frame = hub_acquire(requestSeq);
+  }
+
+  if (!frame) {
+    httpd_resp_set_status(req, HTTPD_503);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, "{\"error\":\"capture_failed\"}", HTTPD_RESP_USE_STRLEN);
+  }
+
+  char seq[12];
+  char timestamp[24];
+  char hostTimestamp[24];
+  char grab[12];
+  int64_t captureUs = frameTimestampUs(frame->fb);
+  snprintf(seq, sizeof(seq), "%lu", (unsigned long)frame->seq);
+  snprintf(timestamp, sizeof(timestamp), "%lld", (long long)captureUs);
+  snprintf(hostTimestamp, sizeof(hostTimestamp), "%lld", (long long)timesync_to_host(captureUs));
+  snprintf(grab, sizeof(grab), "%lu", (unsigned long)frame->grabUs);
+
+  httpd_resp_set_type(req, "image/jpeg");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  httpd_resp_set_hdr(req, "X-Frame-Seq", seq);
+  httpd_resp_set_hdr(req, "X-Timestamp-Us", timestamp);
+  httpd_resp_set_hdr(req, "X-Host-Timestamp-Us", hostTimestamp);
+  httpd_resp_set_hdr(req, "X-Grab-Us", grab);
+  esp_err_t err = httpd_resp_send(req, (const char*)frame->fb->buf, frame->fb->len);
+  hub_release(frame);
+  return err;
+}
+
+esp_err_t handleStatus(httpd_req_t* req) {
+  PERF_SCOPE(perfSections[PERF_HTTP_STATUS]);
+  power_note_activity();
   float uptime = millis() / 1000.0f;
   float fps = (streamStartTime > 0 && millis() > streamStartTime)
     ? (frameCount * 1000.0f / (millis() - streamStartTime))
     : 0.0f;
+  const FrameSizeInfo* size = findFrameSize(activeFrameSize);
+
+  int n = snprintf(statusBuffer, sizeof(statusBuffer),
+    "{\"ok\":true,"
+    "\"camera_ready\":%s,"
+    "\"resolution\":\"%ux%u\","
+    "\"framesize\":\"%s\","
+    "\"quality\":%d,"
+    "\"target_fps\":%d,"
+    "\"adaptive\":%s,"
+    "\"send_ms\":%.1f,"
+    "\"fps\":%.1f,"
+    "\"frames\":%lu,"
+    "\"clients\":%d,"
+    "\"skipped\":%lu,"
+    "\"capture_errors\":%lu,"
+    "\"fb_count\":%d,"
+    "\"fb_psram\":%s,"
+    "\"captures\":%lu,"
+    "\"trigger_mode\":%s,"
+    "\"sensor_standby\":%s,"
+    "\"time_synced\":%s,"
+    "\"perf_overruns\":%lu,"
+    "\"power_idle\":%s,"
+    "\"uptime\":%.1f,"
+    "\"wifi_rssi\":%d,"
+    "\"free_heap\":%u,",
+    cameraReady ? "true" : "false",
+    size ? size->width : 0, size ? size->height : 0, size ? size->name : "unknown",
+    activeQuality, activeFps, cameraSettings.adaptive ? "true" : "false",
+    sendTimeAvgUs / 1000.0f,
+    fps, (unsigned long)frameCount, activeStreamCount(),
+    (unsigned long)framesSkipped, (unsigned long)captureErrors,
+    activeFbCount, fbInPsram ? "true" : "false",
+    (unsigned long)captureCount, triggerMode ? "true" : "false",
+    sensorStandby ? "true" : "false", timesync_valid() ? "true" : "false",
+    (unsigned long)perf_total_overruns(perfSections, PERF_COUNT),
+    power_is_idle() ? "true" : "false", uptime,
+    WiFi.RSSI(), (unsigned)ESP.getFreeHeap());
+
+  n += snprintf(statusBuffer + n, sizeof(statusBuffer) - n, "\"latency_ms\":{");
+  n += formatHistogram(statusBuffer + n, sizeof(statusBuffer) - n, "grab", grabHist, true);
+  n += formatHistogram(statusBuffer + n, sizeof(statusBuffer) - n, "send", sendHist, true);
+  n += formatHistogram(statusBuffer + n, sizeof(statusBuffer) - n, "age", ageHist, false);
+  n += snprintf(statusBuffer + n, sizeof(statusBuffer) - n, "}}");
 
-  String json = "{";
-  json += "\"ok\":true,";
-  json += "\"camera_ready\":" + String(cameraReady ? "true" : "false") + ",";
-  json += "\"resolution\":\"320x240\",";
-  json += "\"fps\":" + String(fps, 1) + ",";
-  json += "\"frames\":" + String(frameCount) + ",";
-  json += "\"uptime\":" + String(uptime, 1) + ",";
-  json += "\"wifi_rssi\":" + String(WiFi.RSSI()) + ",";
-  json += "\"free_heap\":" + String(ESP.getFreeHeap());
-  json += "}";
-
-  server.send(200, "application/json", json);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  return httpd_resp_send(req, statusBuffer, min(n, (int)sizeof(statusBuffer) - 1));
 }
 
-// =============================================================================
-// HTTP Root Handler
-// =============================================================================
+/**
+ * Append "name":{"p50":..,"p95":..,"p99":..,"max":..,"n":..} (ms).
+ */
+int formatHistogram(char* out, size_t size, const char* name,
+                    const LatencyHistogram& h, bool comma) {
+  int n = snprintf(out, size,
+    "\"%s\":{\"p50\":%.1f,\"p95\":%.1f,\"p99\":%.1f,\"max\":%.1f,\"n\":%lu}%s",
+    name,
+    hist_percentile(h, 50) / 1000.0f, hist_percentile(h, 95) / 1000.0f,
+    hist_percentile(h, 99) / 1000.0f, h.maxUs / 1000.0f,
+    (unsigned long)h.total, comma ? "," : "");
+  return min(n, (int)size - 1);
+}
+
+/**
+ * GET /control?framesize=vga&quality=10&fps=15&adaptive=1&trigger=0&reset_stats=1
+ * Any subset of parameters; the rest keep their values. Changes are
+ * applied by the capture task before its next frame.
+ */
+esp_err_t handleControl(httpd_req_t* req) {
+  power_note_activity();
+  char query[128] = "";
+  char value[16];
+  httpd_req_get_url_query_str(req, query, sizeof(query));
+
+  CameraSettings next = cameraSettings;
+  bool valid = true;
+  bool fits = true;
+
+  if (httpd_query_key_value(query, "framesize", value, sizeof(value)) == ESP_OK) {
+    const FrameSizeInfo* match = nullptr;
+    for (const FrameSizeInfo& info : FRAME_SIZES) {
+      if (strcmp(info.name, value) == 0 && info.size <= MAX_FRAME_SIZE) {
+        match = &info;
+      }
+    }
+    valid = valid && match != nullptr;
+    // DRAM buffers are sized for the boot resolution; a larger JPEG would
+    // overflow them on every frame
+    fits = !match || match->size <= bufferFrameSize;
+    if (match && fits) {
+      next.frameSize = match->size;
+    }
+  }
+  if (httpd_query_key_value(query, "quality", value, sizeof(value)) == ESP_OK) {
+    next.quality = constrain(atoi(value), 4, 63);
+  }
+  if (httpd_query_key_value(query, "fps", value, sizeof(value)) == ESP_OK) {
+    next.fps = constrain(atoi(value), 1, 30);
+  }
+  if (httpd_query_key_value(query, "adaptive", value, sizeof(value)) == ESP_OK) {
+    next.adaptive = atoi(value) != 0;
+  }
+  if (httpd_query_key_value(query, "fb_count", value, sizeof(value)) == ESP_OK) {
+    next.fbCount = constrain(atoi(value), 1, CAMERA_FB_MAX);
+  }
+  if (httpd_query_key_value(query, "trigger", value, sizeof(value)) == ESP_OK) {
+    triggerMode = atoi(value) != 0;
+  }
+  if (httpd_query_key_value(query, "reset_stats", value, sizeof(value)) == ESP_OK &&
+      atoi(value) != 0) {
+    hist_reset(grabHist);
+    hist_reset(sendHist);
+    hist_reset(ageHist);
+  }
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  if (!valid) {
+    httpd_resp_set_status(req, "400 Bad Request");
+    return httpd_resp_send(req, "{\"error\":\"invalid_framesize\"}", HTTPD_RESP_USE_STRLEN);
+  }
+  if (!fits) {
+    int n = snprintf(statusBuffer, sizeof(statusBuffer),
+      "{\"error\":\"framesize_exceeds_buffer\",\"max_framesize\":\"%s\"}",
+      findFrameSize(bufferFrameSize)->name);
+    httpd_resp_set_status(req, "400 Bad Request");
+    return httpd_resp_send(req, statusBuffer, n);
+  }
 
-void handleRoot() {
-  String html = "<html><head><title>LLMos ESP32-CAM</title></head><body>";
-  html += "<h1>LLMos V1 Camera</h1>";
-  html += "<p>Stream: <a href='/stream'>/stream</a></p>";
-  html += "<p>Status: <a href='/status'>/status</a></p>";
-  html += "<img src='/stream' style='max-width:640px'/>";
-  html += "</body></html>";
+  cameraSettings = next;
+  settingsDirty = true;
+  xTaskNotifyGive(captureTaskHandle);
 
-  server.send(200, "text/html", html);
+  const FrameSizeInfo* size = findFrameSize(next.frameSize);
+  int n = snprintf(statusBuffer, sizeof(statusBuffer),
+    "{\"ok\":true,\"framesize\":\"%s\",\"resolution\":\"%ux%u\","
+    "\"quality\":%d,\"fps\":%d,\"adaptive\":%s,\"fb_count\":%d,\"trigger_mode\":%s}",
+    size->name, size->width, size->height, next.quality, next.fps,
+    next.adaptive ? "true" : "false", next.fbCount, triggerMode ? "true" : "false");
+  return httpd_resp_send(req, statusBuffer, n);
+}
+
+static const char ROOT_HTML[] =
+  "<html><head><title>LLMos ESP32-CAM</title></head><body>"
+  "<h1>LLMos V1 Camera</h1>"
+  "<p>Stream: <a href='/stream'>/stream</a></p>"
+  "<p>Status: <a href='/status'>/status</a></p>"
+  "<p>Capture: <a href='/capture'>/capture</a></p>"
+  "<p>Timings: <a href='/perf'>/perf</a></p>"
+  "<p>Power: <a href='/power'>/power</a></p>"
+  "<img src='/stream' style='max-width:640px'/>"
+  "</body></html>";
+
+/**
+ * GET /time — one leg of the host's NTP-style clock sync. Replies with the
+ * local receive (t1) and reply (t2) times; with offset_us, rtt_us and at_us
+ * the host also hands back the offset from its best recent sample.
+ */
+esp_err_t handleTime(httpd_req_t* req) {
+  int64_t t1 = timesync_local_us();
+  power_note_activity();
+
+  char query[128];
+  char offset[24];
+  char rtt[12];
+  char at[24];
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+      httpd_query_key_value(query, "offset_us", offset, sizeof(offset)) == ESP_OK &&
+      httpd_query_key_value(query, "at_us", at, sizeof(at)) == ESP_OK) {
+    uint32_t rttUs = 0;
+    if (httpd_query_key_value(query, "rtt_us", rtt, sizeof(rtt)) == ESP_OK) {
+      rttUs = strtoul(rtt, nullptr, 10);
+    }
+    timesync_update(strtoll(offset, nullptr, 10), rttUs, strtoll(at, nullptr, 10));
+  }
+
+  char body[112];
+  int n = snprintf(body, sizeof(body),
+    "{\"t1\":%lld,\"t2\":%lld,\"synced\":%s,\"skew_ppm\":%.2f}",
+    (long long)t1, (long long)timesync_local_us(),
+    timesync_valid() ? "true" : "false", timeSync.skewPpm);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  return httpd_resp_send(req, body, n);
+}
+
+/**
+ * GET /perf[?reset=1] — per-section timing as
+ * {"sections":{"name":[n,min,mean,p50,p99,max,overruns],...}} (us).
+ * reset=1 starts a new measurement after replying.
+ */
+esp_err_t handlePerf(httpd_req_t* req) {
+  power_note_activity();
+  char query[32] = "";
+  char value[8];
+  httpd_req_get_url_query_str(req, query, sizeof(query));
+  bool reset = httpd_query_key_value(query, "reset", value, sizeof(value)) == ESP_OK &&
+               atoi(value) != 0;
+
+  int n = snprintf(statusBuffer, sizeof(statusBuffer),
+    "{\"ok\":true,\"cpu_mhz\":%lu,\"sections\":{", (unsigned long)perfCpuMhz);
+  n += perf_format(statusBuffer + n, sizeof(statusBuffer) - n - 2, perfSections, PERF_COUNT);
+  n += snprintf(statusBuffer + n, sizeof(statusBuffer) - n, "}}");
+  if (reset) {
+    perf_reset(perfSections, PERF_COUNT);
+  }
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  return httpd_resp_send(req, statusBuffer, n);
+}
+
+/**
+ * GET /power?enabled=1&idle_timeout_ms=10000&idle_cpu_mhz=80 — idle power
+ * state, wake latency and idle residency. Any subset of parameters.
+ */
+esp_err_t handlePower(httpd_req_t* req) {
+  power_note_activity();
+  char query[96] = "";
+  char value[16];
+  httpd_req_get_url_query_str(req, query, sizeof(query));
+
+  bool enabled = power.enabled;
+  uint32_t idleTimeoutMs = power.idleTimeoutMs;
+  uint32_t idleCpuMhz = power.idleCpuMhz;
+  if (httpd_query_key_value(query, "enabled", value, sizeof(value)) == ESP_OK) {
+    enabled = atoi(value) != 0;
+  }
+  if (httpd_query_key_value(query, "idle_timeout_ms", value, sizeof(value)) == ESP_OK) {
+    idleTimeoutMs = strtoul(value, nullptr, 10);
+  }
+  if (httpd_query_key_value(query, "idle_cpu_mhz", value, sizeof(value)) == ESP_OK) {
+    idleCpuMhz = strtoul(value, nullptr, 10);
+  }
+  power_configure(enabled, idleTimeoutMs, idleCpuMhz);
+
+  int n = snprintf(statusBuffer, sizeof(statusBuffer), "{\"ok\":true,");
+  n += power_format(statusBuffer + n, sizeof(statusBuffer) - n - 1);
+  n += snprintf(statusBuffer + n, sizeof(statusBuffer) - n, "}");
+
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+  return httpd_resp_send(req, statusBuffer, n);
+}
+
+esp_err_t handleRoot(httpd_req_t* req) {
+  power_note_activity();
+  httpd_resp_set_type(req, "text/html");
+  return httpd_resp_send(req, ROOT_HTML, sizeof(ROOT_HTML) - 1);
+}
+
+/**
+ * Start esp_http_server and register the routes.
+ */
+bool startHttpServer() {
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.server_port = HTTP_PORT;
+  config.core_id = HTTPD_CORE;
+  config.max_open_sockets = STREAM_MAX_CLIENTS + 3;
+  config.lru_purge_enable = false;  // Never evict a streaming socket
+  config.close_fn = onSocketClose;
+  config.max_uri_handlers = 10;     // 8 routes below, plus headroom
+
+  if (httpd_start(&camServer, &config) != ESP_OK) {
+    return false;
+  }
+
+  static const httpd_uri_t routes[] = {
+    {"/", HTTP_GET, handleRoot, nullptr},
+    {"/stream", HTTP_GET, handleStream, nullptr},
+    {"/status", HTTP_GET, handleStatus, nullptr},
+    {"/capture", HTTP_GET, handleCapture, nullptr},
+    {"/control", HTTP_GET, handleControl, nullptr},
+    {"/time", HTTP_GET, handleTime, nullptr},
+    {"/perf", HTTP_GET, handlePerf, nullptr},
+    {"/power", HTTP_GET, handlePower, nullptr},
+  };
+  for (const httpd_uri_t& route : routes) {
+    httpd_register_uri_handler(camServer, &route);
+  }
+  return true;
 }
 
 // =============================================================================
@@ -221,13 +1110,14 @@ void handleRoot() {
 void setup() {
   Serial.begin(115200);
   Serial.println("[CAM] ESP32-CAM MJPEG Streamer V1");
+  perf_init();
 
   // Flash LED off
   pinMode(FLASH_LED_PIN, OUTPUT);
   digitalWrite(FLASH_LED_PIN, LOW);
 
   // Initialize camera
-  cameraReady = initCamera();
+  cameraReady = initCamera(CAMERA_FB_COUNT);
   if (!cameraReady) {
     Serial.println("[CAM] FATAL: Camera init failed!");
   }
@@ -254,13 +1144,23 @@ void setup() {
     Serial.println("[CAM] WiFi connection failed!");
   }
 
-  // Set up HTTP routes
-  server.on("/", handleRoot);
-  server.on("/stream", HTTP_GET, handleStream);
-  server.on("/status", HTTP_GET, handleStatus);
-  server.begin();
+  // Full power until idle. No light sleep: it would stop the sensor's XCLK
+  power_init(false);
 
-  Serial.println("[CAM] HTTP server started on port 80");
+  // Start capture and streaming tasks
+  xTaskCreatePinnedToCore(captureTask, "capture", 4096, nullptr, 3, &captureTaskHandle, CAPTURE_CORE);
+  for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+    streamClients[i].fd = -1;
+    streamClients[i].active = false;
+    xTaskCreatePinnedToCore(streamTask, "stream", 4096, &streamClients[i], 2,
+                            &streamClients[i].task, STREAM_CORE);
+  }
+
+  if (startHttpServer()) {
+    Serial.printf("[CAM] HTTP server started on port %d\n", HTTP_PORT);
+  } else {
+    Serial.println("[CAM] HTTP server failed to start!");
+  }
 }
 
 // =============================================================================
@@ -268,5 +1168,6 @@ void setup() {
 // =============================================================================
 
 void loop() {
-  server.handleClient();
+  // All work happens in the capture, stream and httpd tasks
+  vTaskDelete(nullptr);
 }
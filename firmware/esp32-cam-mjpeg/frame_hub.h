@@ -0,0 +1,199 @@
+/**
+ * Frame Hub for ESP32-CAM MJPEG Streamer
+ *
+ * Shares each captured camera_fb_t between all streaming clients without
+ * copying the JPEG data. The capture task publishes frames; each client
+ * task borrows the newest one, sends it straight from the frame buffer and
+ * gives it back. The buffer is returned to the camera driver when it is no
+ * longer the newest frame and no client is still sending it.
+ *
+ * Features:
+ * - Zero-copy fan-out to up to HUB_MAX_CLIENTS readers
+ * - Reference-counted frames (hub holds one ref on the newest frame)
+ * - Drop-if-slow: a client that is still sending skips to the newest frame
+ *   instead of queueing, so a slow reader never delays the others
+ * - Task notification to every registered reader on publish
+ */
+
+#ifndef FRAME_HUB_H
+#define FRAME_HUB_H
+
+#include <Arduino.h>
+#include "esp_camera.h"
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define HUB_MAX_CLIENTS  4
+#define HUB_MAX_FRAMES   4    // >= camera fb_count: every driver buffer fits
+
+struct HubFrame {
+  camera_fb_t* fb;        // nullptr = slot free
+  uint32_t refs;          // Readers sending it, +1 while it is the newest
+  uint32_t seq;           // Publish order, starts at 1
+  uint32_t grabUs;        // esp_camera_fb_get() latency for this frame
+};
+
+static HubFrame hubFrames[HUB_MAX_FRAMES];
+static int hubLatest = -1;                   // Slot of the newest frame
+static uint32_t hubSeq = 0;                  // Frames published
+static TaskHandle_t hubReaders[HUB_MAX_CLIENTS];
+static portMUX_TYPE hubMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+/**
+ * Drop one reference; the last one hands the buffer back to the driver.
+ * Must not be called inside hubMux.
+ */
+inline void hub_release(HubFrame* frame) {
+  camera_fb_t* done = nullptr;
+  portENTER_CRITICAL(&hubMux);
+  if (--frame->refs == 0) {
+    done = frame->fb;
+    frame->fb = nullptr;
+  }
+  portEXIT_CRITICAL(&hubMux);
+  if (done) {
+    esp_camera_fb_return(done);
+  }
+}
+
+/**
+ * Make `fb` the newest frame and wake every reader. Called by the capture
+ * task only; the hub takes ownership of `fb`.
+ */
+inline void hub_publish(camera_fb_t* fb, uint32_t grabUs) {
+  HubFrame* previous = nullptr;
+  bool stored = false;
+
+  portENTER_CRITICAL(&hubMux);
+  for (int i = 0; i < HUB_MAX_FRAMES; i++) {
+    if (hubFrames[i].fb == nullptr) {
+      if (hubLatest >= 0) {
+        previous = &hubFrames[hubLatest];
+      }
+      hubFrames[i].fb = fb;
+      hubFrames[i].refs = 1;
+      hubFrames[i].seq = ++hubSeq;
+      hubFrames[i].grabUs = grabUs;
+      hubLatest = i;
+      stored = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&hubMux);
+
+  if (!stored) {
+    esp_camera_fb_return(fb);  // More buffers in flight than slots
+    return;
+  }
+  if (previous) {
+    hub_release(previous);
+  }
+  for (int i = 0; i < HUB_MAX_CLIENTS; i++) {
+    TaskHandle_t reader = hubReaders[i];
+    if (reader) {
+      xTaskNotifyGive(reader);
+    }
+  }
+}
+
+/**
+ * Borrow the newest frame if it is newer than `lastSeq`. Returns nullptr
+ * if there is nothing new. Frames skipped since `lastSeq` are the caller's
+ * drops. Pair with hub_release().
+ */
+inline HubFrame* hub_acquire(uint32_t lastSeq) {
+  HubFrame* frame = nullptr;
+  portENTER_CRITICAL(&hubMux);
+  if (hubLatest >= 0 && hubFrames[hubLatest].seq != lastSeq) {
+    frame = &hubFrames[hubLatest];
+    frame->refs++;
+  }
+  portEXIT_CRITICAL(&hubMux);
+  return frame;
+}
+
+/**
+ * Sequence number of the last frame published (0 = none yet). Passing it
+ * to hub_acquire() later returns only a frame published after this call.
+ */
+inline uint32_t hub_seq() {
+  portENTER_CRITICAL(&hubMux);
+  uint32_t seq = hubSeq;
+  portEXIT_CRITICAL(&hubMux);
+  return seq;
+}
+
+/**
+ * Give up the hub's reference on the newest frame, e.g. before the camera
+ * is re-initialized. Readers still sending keep theirs.
+ */
+inline void hub_drop_latest() {
+  HubFrame* latest = nullptr;
+  portENTER_CRITICAL(&hubMux);
+  if (hubLatest >= 0) {
+    latest = &hubFrames[hubLatest];
+    hubLatest = -1;
+  }
+  portEXIT_CRITICAL(&hubMux);
+  if (latest) {
+    hub_release(latest);
+  }
+}
+
+/**
+ * Number of driver buffers currently held by the hub or its readers.
+ */
+inline int hub_frames_in_use() {
+  int count = 0;
+  for (int i = 0; i < HUB_MAX_FRAMES; i++) {
+    if (hubFrames[i].fb) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * Register the calling task for publish notifications. Returns false if
+ * all reader slots are taken.
+ */
+inline bool hub_add_reader(TaskHandle_t task) {
+  bool added = false;
+  portENTER_CRITICAL(&hubMux);
+  for (int i = 0; i < HUB_MAX_CLIENTS && !added; i++) {
+    if (hubReaders[i] == nullptr) {
+      hubReaders[i] = task;
+      added = true;
+    }
+  }
+  portEXIT_CRITICAL(&hubMux);
+  return added;
+}
+
+inline void hub_remove_reader(TaskHandle_t task) {
+  portENTER_CRITICAL(&hubMux);
+  for (int i = 0; i < HUB_MAX_CLIENTS; i++) {
+    if (hubReaders[i] == task) {
+      hubReaders[i] = nullptr;
+    }
+  }
+  portEXIT_CRITICAL(&hubMux);
+}
+
+inline int hub_reader_count() {
+  int count = 0;
+  for (int i = 0; i < HUB_MAX_CLIENTS; i++) {
+    if (hubReaders[i]) {
+      count++;
+    }
+  }
+  return count;
+}
+
+#endif // FRAME_HUB_H
@@ -0,0 +1,110 @@
+/**
+ * Latency Histogram for the Cube Robot Boards
+ *
+ * Fixed-size log-linear histogram of microsecond durations, cheap enough to
+ * record every frame from several tasks. Each power of two is split into
+ * HIST_SUB_BUCKETS linear buckets, so percentiles are accurate to within
+ * 1 / HIST_SUB_BUCKETS (25%) of the value, from 1 us up to ~71 minutes.
+ * Used directly by the camera and through perf_profiler.h everywhere.
+ *
+ * Identical copies live next to each sketch (Arduino only builds files in
+ * the sketch directory).
+ *
+ * Features:
+ * - O(1) record (count-leading-zeros + shift), no allocation
+ * - p50 / p95 / p99 (any percentile) by bucket scan
+ * - Tracks count and maximum exactly
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define HIST_SUB_BITS      2
+#define HIST_SUB_BUCKETS   (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS       (HIST_SUB_BUCKETS * (32 - HIST_SUB_BITS + 1))
+
+struct LatencyHistogram {
+  uint32_t counts[HIST_BUCKETS];
+  uint32_t total;
+  uint32_t maxUs;
+};
+
+static portMUX_TYPE histMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+/**
+ * Bucket index: values below HIST_SUB_BUCKETS map 1:1, larger values by
+ * their top (HIST_SUB_BITS + 1) significant bits.
+ */
+inline int hist_bucket(uint32_t us) {
+  if (us < HIST_SUB_BUCKETS) {
+    return us;
+  }
+  int msb = 31 - __builtin_clz(us);
+  int sub = (us >> (msb - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1);
+  return HIST_SUB_BUCKETS + (msb - HIST_SUB_BITS) * HIST_SUB_BUCKETS + sub;
+}
+
+/**
+ * Upper bound of a bucket (the value reported for percentiles in it).
+ */
+inline uint32_t hist_bucket_upper(int bucket) {
+  if (bucket < HIST_SUB_BUCKETS) {
+    return bucket;
+  }
+  int msb = (bucket - HIST_SUB_BUCKETS) / HIST_SUB_BUCKETS + HIST_SUB_BITS;
+  int sub = (bucket - HIST_SUB_BUCKETS) % HIST_SUB_BUCKETS;
+  uint32_t width = 1UL << (msb - HIST_SUB_BITS);
+  return ((uint32_t)(HIST_SUB_BUCKETS + sub) << (msb - HIST_SUB_BITS)) + width - 1;
+}
+
+inline void hist_reset(LatencyHistogram& h) {
+  portENTER_CRITICAL(&histMux);
+  memset(&h, 0, sizeof(h));
+  portEXIT_CRITICAL(&histMux);
+}
+
+inline void hist_record(LatencyHistogram& h, uint32_t us) {
+  int bucket = hist_bucket(us);
+  portENTER_CRITICAL(&histMux);
+  h.counts[bucket]++;
+  h.total++;
+  if (us > h.maxUs) {
+    h.maxUs = us;
+  }
+  portEXIT_CRITICAL(&histMux);
+}
+
+/**
+ * Value at percentile `pct` (0-100), in microseconds. 0 if empty; the
+ * exact maximum is returned for the top bucket.
+ */
+inline uint32_t hist_percentile(const LatencyHistogram& h, float pct) {
+  uint32_t total = h.total;
+  if (total == 0) {
+    return 0;
+  }
+  uint32_t rank = (uint32_t)(total * pct / 100.0f);
+  if (rank >= total) {
+    rank = total - 1;
+  }
+  uint32_t seen = 0;
+  for (int b = 0; b < HIST_BUCKETS; b++) {
+    seen += h.counts[b];
+    if (seen > rank) {
+      return min(hist_bucket_upper(b), h.maxUs);
+    }
+  }
+  return h.maxUs;
+}
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,155 @@
+/**
+ * Section Profiler for the Cube Robot Boards
+ *
+ * Times named code sections (a loop pass, JSON parsing, a socket write)
+ * with the CPU cycle counter and keeps per-section count, min / mean / max
+ * and a latency histogram (latency_histogram.h) for p50 / p99. Sections
+ * with a budget also count overruns, so a loop that misses its period
+ * shows up as a number rather than as jitter somewhere else.
+ *
+ * Each sketch declares its sections as a table and reports them from one
+ * command (get_perf, or /perf on the camera):
+ *
+ *   PerfSection perfSections[] = {{"loop", 1000}, {"parse", 0}};
+ *   { PERF_SCOPE(perfSections[PERF_LOOP]); ... }
+ *
+ * The cycle counter is per core: time only code that stays on one core
+ * (pinned tasks, which is every task in these sketches). It also ticks at
+ * the current CPU clock, so each pass is converted to time as it is
+ * recorded; passes timed at 240 and 80 MHz (power_manager.h) then add up
+ * correctly. Only a pass that spans a clock change is off.
+ *
+ * Identical copies live next to each sketch (Arduino only builds files in
+ * the sketch directory).
+ *
+ * Features:
+ * - ~1 us overhead per timed section; no allocation
+ * - Min / max / mean to the nanosecond; percentiles to within 25%
+ * - Compact JSON formatter that fits a 512-byte UDP reply
+ */
+
+#ifndef PERF_PROFILER_H
+#define PERF_PROFILER_H
+
+#include <Arduino.h>
+#include "latency_histogram.h"
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+struct PerfSection {
+  const char* name;
+  uint32_t budgetUs;       // A pass longer than this is an overrun; 0 = none
+  uint32_t count;
+  uint32_t overruns;
+  uint32_t minNs;
+  uint32_t maxNs;          // Saturates at ~4.3 s
+  uint64_t totalNs;
+  LatencyHistogram hist;   // Microseconds
+};
+
+static uint32_t perfCpuMhz = 240;
+static portMUX_TYPE perfMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+inline uint32_t perf_cycles() {
+  return ESP.getCycleCount();
+}
+
+/**
+ * Latch the CPU clock used to convert cycles. Call from setup(), and
+ * again after every CPU frequency change.
+ */
+inline void perf_init() {
+  perfCpuMhz = max((uint32_t)1, (uint32_t)ESP.getCpuFreqMHz());
+}
+
+inline void perf_record_cycles(PerfSection& s, uint32_t cycles) {
+  uint32_t mhz = perfCpuMhz;
+  uint32_t us = cycles / mhz;
+  uint32_t ns = us < 4000000 ? us * 1000 + (cycles % mhz) * 1000 / mhz : UINT32_MAX;
+  portENTER_CRITICAL(&perfMux);
+  if (s.count == 0 || ns < s.minNs) {
+    s.minNs = ns;
+  }
+  if (ns > s.maxNs) {
+    s.maxNs = ns;
+  }
+  s.count++;
+  s.totalNs += ns;
+  if (s.budgetUs > 0 && us > s.budgetUs) {
+    s.overruns++;
+  }
+  portEXIT_CRITICAL(&perfMux);
+  hist_record(s.hist, us);
+}
+
+/**
+ * Times its own lifetime into a section. Use through PERF_SCOPE.
+ */
+class PerfScope {
+ public:
+  explicit PerfScope(PerfSection& section) : section_(section), start_(perf_cycles()) {}
+  ~PerfScope() { perf_record_cycles(section_, perf_cycles() - start_); }
+
+ private:
+  PerfSection& section_;
+  uint32_t start_;
+};
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b)  PERF_CONCAT_(a, b)
+#define PERF_SCOPE(section) PerfScope PERF_CONCAT(perfScope, __LINE__)(section)
+
+inline void perf_reset(PerfSection* sections, int count) {
+  for (int i = 0; i < count; i++) {
+    portENTER_CRITICAL(&perfMux);
+    sections[i].count = 0;
+    sections[i].overruns = 0;
+    sections[i].minNs = 0;
+    sections[i].maxNs = 0;
+    sections[i].totalNs = 0;
+    portEXIT_CRITICAL(&perfMux);
+    hist_reset(sections[i].hist);
+  }
+}
+
+inline uint32_t perf_total_overruns(const PerfSection* sections, int count) {
+  uint32_t total = 0;
+  for (int i = 0; i < count; i++) {
+    total += sections[i].overruns;
+  }
+  return total;
+}
+
+/**
+ * Append "name":[n,min,mean,p50,p99,max,overruns] per section (times in
+ * us), comma separated, without the enclosing braces. Returns the length
+ * written; stops before a section that would not fit.
+ */
+inline int perf_format(char* out, size_t size, const PerfSection* sections, int count) {
+  int n = 0;
+  for (int i = 0; i < count; i++) {
+    portENTER_CRITICAL(&perfMux);
+    PerfSection s = sections[i];
+    portEXIT_CRITICAL(&perfMux);
+
+    float meanUs = s.count > 0 ? (float)(s.totalNs / s.count) / 1000.0f : 0.0f;
+    int len = snprintf(out + n, size - n, "%s\"%s\":[%lu,%.1f,%.1f,%lu,%lu,%.1f,%lu]",
+      n > 0 ? "," : "", s.name, (unsigned long)s.count,
+      s.minNs / 1000.0f, meanUs,
+      (unsigned long)hist_percentile(s.hist, 50), (unsigned long)hist_percentile(s.hist, 99),
+      s.maxNs / 1000.0f, (unsigned long)s.overruns);
+    if (len < 0 || (size_t)len >= size - n) {
+      break;   // Anything past `n` is a partial entry
+    }
+    n += len;
+  }
+  return n;
+}
+
+#endif // PERF_PROFILER_H
@@ -0,0 +1,252 @@
+/**
+ * Activity-Aware Power Manager for the Cube Robot Boards
+ *
+ * Switches a board between two power states:
+ *
+ *   active  full CPU clock, WiFi power save off (lowest command latency)
+ *   idle    reduced CPU clock, WiFi modem sleep woken at every DTIM beacon
+ *           (the AP buffers traffic for us until then), optionally
+ *           automatic light sleep between FreeRTOS ticks
+ *
+ * The sketch reports host traffic with power_note_activity(), which wakes
+ * the board at once, and calls power_update() periodically from one task
+ * with whether anything still needs full power (motors turning, a stream
+ * client, armed ESCs). The board goes idle once nothing has been busy and
+ * no host traffic has arrived for the idle timeout. Gating peripherals
+ * (coils, camera sensor) stays with the sketch, which knows them.
+ *
+ * Wake latency here is the time to restore the active state, measured on
+ * the board from when the sketch first sees the traffic. Polling loops see
+ * it up to power_idle_poll_ms() late (reported as idle_poll_ms). In modem
+ * sleep the first packet can also wait up to one DTIM interval at the AP
+ * (~100-300 ms); the host sees that in its round trip.
+ *
+ * WiFi boards define POWER_USE_WIFI 1 before the include; the flight
+ * controller (USB only) leaves it out and does not link the WiFi driver.
+ *
+ * Light sleep needs a core built with CONFIG_PM_ENABLE and
+ * CONFIG_FREERTOS_USE_TICKLESS_IDLE; the stock Arduino core has neither,
+ * so there idle means frequency scaling plus modem sleep.
+ *
+ * Identical copies live next to each sketch (Arduino only builds files in
+ * the sketch directory).
+ *
+ * Features:
+ * - Instant wake from any task; transitions serialized by a mutex
+ * - Wake count, last / max wake latency, idle residency
+ * - Re-latches perf_profiler.h's cycle conversion after clock changes
+ */
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "perf_profiler.h"
+
+#ifndef POWER_USE_WIFI
+#define POWER_USE_WIFI 0
+#endif
+#if POWER_USE_WIFI
+#include "esp_wifi.h"
+#endif
+
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+#define POWER_LIGHT_SLEEP 1
+#include "esp_pm.h"
+#if CONFIG_IDF_TARGET_ESP32S3
+typedef esp_pm_config_esp32s3_t PowerPmConfig;
+#else
+typedef esp_pm_config_esp32_t PowerPmConfig;
+#endif
+#else
+#define POWER_LIGHT_SLEEP 0
+#endif
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define POWER_IDLE_TIMEOUT_MS  10000   // No host traffic for this long -> idle
+#define POWER_ACTIVE_CPU_MHZ   240
+#define POWER_IDLE_CPU_MHZ     80      // Lowest clock that keeps APB at 80 MHz
+#define POWER_IDLE_POLL_MS     10      // Idle poll gap when light sleep is on
+
+struct PowerManager {
+  volatile bool enabled;
+  volatile bool idle;
+  bool lightSleep;              // Light sleep allowed (no USB CDC link to keep)
+  uint32_t idleTimeoutMs;
+  uint32_t idleCpuMhz;
+  volatile uint32_t lastActivityMs;
+  volatile int64_t wakeRequestUs;   // Activity that triggered the pending wake
+  uint32_t wakes;
+  uint32_t lastWakeUs;
+  uint32_t maxWakeUs;
+  uint32_t idleSinceMs;
+  uint64_t idleTotalMs;         // Completed idle periods
+  uint32_t startMs;
+};
+
+static PowerManager power = {};
+static SemaphoreHandle_t powerMutex = nullptr;
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+/**
+ * Apply one state. Caller holds powerMutex.
+ */
+inline void power_apply(bool idle) {
+  uint32_t mhz = idle ? power.idleCpuMhz : POWER_ACTIVE_CPU_MHZ;
+#if POWER_LIGHT_SLEEP
+  if (power.lightSleep) {
+    PowerPmConfig pm = {};
+    pm.max_freq_mhz = POWER_ACTIVE_CPU_MHZ;
+    pm.min_freq_mhz = mhz;
+    pm.light_sleep_enable = idle;
+    esp_pm_configure(&pm);
+  } else {
+    setCpuFrequencyMhz(mhz);
+  }
+#else
+  setCpuFrequencyMhz(mhz);
+#endif
+#if POWER_USE_WIFI
+  esp_wifi_set_ps(idle ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+#endif
+  perf_init();
+}
+
+/**
+ * Start in the active state. Call from setup() after WiFi is up (if used).
+ * `lightSleep` allows light sleep when idle, where the core supports it.
+ */
+inline void power_init(bool lightSleep) {
+  powerMutex = xSemaphoreCreateMutex();
+  power.enabled = true;
+  power.lightSleep = lightSleep;
+  power.idleTimeoutMs = POWER_IDLE_TIMEOUT_MS;
+  power.idleCpuMhz = POWER_IDLE_CPU_MHZ;
+  power.startMs = millis();
+  power.lastActivityMs = power.startMs;
+  power_apply(false);
+}
+
+/**
+ * Leave idle now. Safe from any task (not from an ISR).
+ */
+inline void power_wake() {
+  if (!powerMutex) {
+    return;
+  }
+  xSemaphoreTake(powerMutex, portMAX_DELAY);
+  if (power.idle) {
+    power_apply(false);
+    power.idle = false;
+    uint32_t now = millis();
+    power.idleTotalMs += now - power.idleSinceMs;
+    power.wakes++;
+    power.lastWakeUs = (uint32_t)(esp_timer_get_time() - power.wakeRequestUs);
+    power.maxWakeUs = max(power.maxWakeUs, power.lastWakeUs);
+  }
+  xSemaphoreGive(powerMutex);
+}
+
+/**
+ * Host traffic arrived: restart the idle timer and wake if idle.
+ */
+inline void power_note_activity() {
+  power.lastActivityMs = millis();
+  if (power.idle) {
+    power.wakeRequestUs = esp_timer_get_time();
+    power_wake();
+  }
+}
+
+/**
+ * Periodic check from one task. `busy` holds the board active; the idle
+ * timeout then counts from when it was last busy.
+ */
+inline void power_update(bool busy) {
+  if (busy) {
+    power.lastActivityMs = millis();
+  }
+  if (power.idle) {
+    if (busy || !power.enabled) {
+      power.wakeRequestUs = esp_timer_get_time();
+      power_wake();
+    }
+    return;
+  }
+  if (!powerMutex || !power.enabled || busy) {
+    return;
+  }
+  if (millis() - power.lastActivityMs < power.idleTimeoutMs) {
+    return;
+  }
+
+  xSemaphoreTake(powerMutex, portMAX_DELAY);
+  if (!power.idle && millis() - power.lastActivityMs >= power.idleTimeoutMs) {
+    power_apply(true);
+    power.idle = true;
+    power.idleSinceMs = millis();
+  }
+  xSemaphoreGive(powerMutex);
+}
+
+inline bool power_is_idle() {
+  return power.idle;
+}
+
+/**
+ * Gap a polling loop should leave between polls while idle. Only light
+ * sleep gains from longer gaps; without it the idle task clock-gates the
+ * core between ticks anyway, so polls stay one tick apart and host
+ * traffic is seen within 1 ms.
+ */
+inline uint32_t power_idle_poll_ms() {
+  return POWER_LIGHT_SLEEP && power.lightSleep ? POWER_IDLE_POLL_MS : 1;
+}
+
+/**
+ * Percentage of the time since power_init() spent idle.
+ */
+inline float power_idle_percent() {
+  uint32_t now = millis();
+  uint64_t idleMs = power.idleTotalMs + (power.idle ? now - power.idleSinceMs : 0);
+  uint32_t elapsed = now - power.startMs;
+  return elapsed > 0 ? 100.0f * idleMs / elapsed : 0.0f;
+}
+
+/**
+ * Change the settings; out-of-range values are clamped. Disabling wakes
+ * the board on the next power_update().
+ */
+inline void power_configure(bool enabled, uint32_t idleTimeoutMs, uint32_t idleCpuMhz) {
+  power.enabled = enabled;
+  power.idleTimeoutMs = constrain(idleTimeoutMs, (uint32_t)1000, (uint32_t)3600000);
+  power.idleCpuMhz = idleCpuMhz >= 160 ? 160 : 80;
+  power.lastActivityMs = millis();
+}
+
+/**
+ * "enabled":...,"idle":...,... (no braces) for status replies.
+ */
+inline int power_format(char* out, size_t size) {
+  return snprintf(out, size,
+    "\"enabled\":%s,\"idle\":%s,\"idle_timeout_ms\":%lu,\"idle_cpu_mhz\":%lu,"
+    "\"cpu_mhz\":%lu,\"wifi_sleep\":%s,\"light_sleep\":%s,\"wakes\":%lu,"
+    "\"wake_us\":%lu,\"wake_us_max\":%lu,\"idle_poll_ms\":%lu,\"idle_pct\":%.1f",
+    power.enabled ? "true" : "false", power.idle ? "true" : "false",
+    (unsigned long)power.idleTimeoutMs, (unsigned long)power.idleCpuMhz,
+    (unsigned long)getCpuFrequencyMhz(),
+    POWER_USE_WIFI && power.idle ? "true" : "false",
+    POWER_LIGHT_SLEEP && power.lightSleep && power.idle ? "true" : "false",
+    (unsigned long)power.wakes, (unsigned long)power.lastWakeUs,
+    (unsigned long)power.maxWakeUs, (unsigned long)power_idle_poll_ms(),
+    power_idle_percent());
+}
+
+#endif // POWER_MANAGER_H
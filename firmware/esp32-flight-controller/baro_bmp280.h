@@ -0,0 +1,153 @@
+/**
+ * BMP280 Barometer Driver for ESP32 Flight Controller
+ *
+ * Runs the sensor in normal mode (continuous conversions, IIR filtered)
+ * and reads pressure and temperature with one 6-byte burst, then applies
+ * the datasheet's integer compensation. Also accepts a BME280 (humidity
+ * is ignored).
+ *
+ * Features:
+ * - Pressure x16 / temperature x2 oversampling, IIR filter x16 (~26 Hz)
+ * - Calibration read once as a single 24-byte burst
+ * - Fixed-point compensation (datasheet section 8.2, 64-bit pressure)
+ */
+
+#ifndef BARO_BMP280_H
+#define BARO_BMP280_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define BARO_ADDR_PRIMARY    0x76
+#define BARO_ADDR_SECONDARY  0x77
+#define BARO_PERIOD_MS       40     // Matches the ~26 Hz output rate
+#define BARO_SEA_LEVEL_HPA   1013.25f
+
+#define BMP_CALIB            0x88
+#define BMP_CHIP_ID          0xD0
+#define BMP_CTRL_MEAS        0xF4
+#define BMP_CONFIG           0xF5
+#define BMP_DATA             0xF7
+
+struct BaroCalibration {
+  uint16_t t1;
+  int16_t t2, t3;
+  uint16_t p1;
+  int16_t p2, p3, p4, p5, p6, p7, p8, p9;
+};
+
+struct BaroReading {
+  float pressureHpa;
+  float temperatureC;
+  float altitudeM;
+};
+
+static TwoWire* baroWire = nullptr;
+static uint8_t baroAddr = BARO_ADDR_PRIMARY;
+static BaroCalibration baroCal;
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+inline bool baro_read(uint8_t reg, uint8_t* out, size_t len) {
+  baroWire->beginTransmission(baroAddr);
+  baroWire->write(reg);
+  if (baroWire->endTransmission(false) != 0 ||
+      baroWire->requestFrom(baroAddr, len) != len) {
+    return false;
+  }
+  baroWire->readBytes(out, len);
+  return true;
+}
+
+inline bool baro_write(uint8_t reg, uint8_t value) {
+  baroWire->beginTransmission(baroAddr);
+  baroWire->write(reg);
+  baroWire->write(value);
+  return baroWire->endTransmission() == 0;
+}
+
+/**
+ * Detect (0x76, then 0x77) and configure the barometer. `wire` must
+ * already be begun. Returns false if no BMP280/BME280 answers.
+ */
+inline bool baro_init(TwoWire& wire) {
+  baroWire = &wire;
+
+  const uint8_t addrs[2] = {BARO_ADDR_PRIMARY, BARO_ADDR_SECONDARY};
+  bool found = false;
+  for (int i = 0; i < 2 && !found; i++) {
+    baroAddr = addrs[i];
+    uint8_t id = 0;
+    found = baro_read(BMP_CHIP_ID, &id, 1) && (id == 0x58 || id == 0x60);
+  }
+  if (!found) {
+    return false;
+  }
+
+  uint8_t c[24];
+  if (!baro_read(BMP_CALIB, c, sizeof(c))) {
+    return false;
+  }
+  baroCal.t1 = c[0] | (c[1] << 8);
+  baroCal.t2 = c[2] | (c[3] << 8);
+  baroCal.t3 = c[4] | (c[5] << 8);
+  baroCal.p1 = c[6] | (c[7] << 8);
+  baroCal.p2 = c[8] | (c[9] << 8);
+  baroCal.p3 = c[10] | (c[11] << 8);
+  baroCal.p4 = c[12] | (c[13] << 8);
+  baroCal.p5 = c[14] | (c[15] << 8);
+  baroCal.p6 = c[16] | (c[17] << 8);
+  baroCal.p7 = c[18] | (c[19] << 8);
+  baroCal.p8 = c[20] | (c[21] << 8);
+  baroCal.p9 = c[22] | (c[23] << 8);
+
+  baro_write(BMP_CONFIG, 0x10);     // Standby 0.5 ms, IIR filter x16
+  baro_write(BMP_CTRL_MEAS, 0x57);  // Temp x2, pressure x16, normal mode
+  return true;
+}
+
+/**
+ * Read and compensate the latest conversion. Returns false on I2C error.
+ */
+inline bool baro_read_sample(BaroReading& out) {
+  uint8_t d[6];
+  if (!baro_read(BMP_DATA, d, sizeof(d))) {
+    return false;
+  }
+  int32_t adcP = ((int32_t)d[0] << 12) | ((int32_t)d[1] << 4) | (d[2] >> 4);
+  int32_t adcT = ((int32_t)d[3] << 12) | ((int32_t)d[4] << 4) | (d[5] >> 4);
+
+  const BaroCalibration& cal = baroCal;
+  int32_t var1 = ((((adcT >> 3) - ((int32_t)cal.t1 << 1))) * cal.t2) >> 11;
+  int32_t var2 = (((((adcT >> 4) - (int32_t)cal.t1) *
+                    ((adcT >> 4) - (int32_t)cal.t1)) >> 12) * cal.t3) >> 14;
+  int32_t tFine = var1 + var2;
+  out.temperatureC = ((tFine * 5 + 128) >> 8) / 100.0f;
+
+  int64_t p1 = (int64_t)tFine - 128000;
+  int64_t p2 = p1 * p1 * cal.p6;
+  p2 = p2 + ((p1 * cal.p5) << 17);
+  p2 = p2 + ((int64_t)cal.p4 << 35);
+  p1 = ((p1 * p1 * cal.p3) >> 8) + ((p1 * cal.p2) << 12);
+  p1 = ((((int64_t)1) << 47) + p1) * cal.p1 >> 33;
+  if (p1 == 0) {
+    return false;  // Avoid division by zero (sensor not ready)
+  }
+  int64_t p = 1048576 - adcP;
+  p = (((p << 31) - p2) * 3125) / p1;
+  p1 = ((int64_t)cal.p9 * (p >> 13) * (p >> 13)) >> 25;
+  p2 = ((int64_t)cal.p8 * p) >> 19;
+  p = ((p + p1 + p2) >> 8) + ((int64_t)cal.p7 << 4);
+
+  out.pressureHpa = (uint32_t)p / 25600.0f;   // Q24.8 Pa -> hPa
+  out.altitudeM = 44330.0f * (1.0f - powf(out.pressureHpa / BARO_SEA_LEVEL_HPA, 1.0f / 5.255f));
+  return true;
+}
+
+#endif // BARO_BMP280_H
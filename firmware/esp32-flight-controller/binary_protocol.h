@@ -0,0 +1,251 @@
+/**
+ * Binary Command Protocol for ESP32 Flight Controller
+ *
+ * Compact alternative to JSON for the high-rate HIL commands, on the same
+ * USB CDC link. Enabled with {"action":"set_binary","enabled":true}; JSON
+ * stays available at all times for get_info, configuration and debugging.
+ *
+ * Frame layout before framing (little-endian, no padding):
+ *
+ *   [magic:u8 = 0xB5][opcode:u8][seq:u16][payload ...][crc16:u16]
+ *
+ * The frame is COBS-encoded and sent between 0x00 delimiters:
+ *
+ *   0x00 [COBS(frame)] 0x00
+ *
+ * Consecutive frames may share one delimiter. crc16 is CRC-16/CCITT-FALSE
+ * (poly 0x1021, init 0xFFFF) over magic..payload. Replies reuse the request
+ * seq and set bit 7 of the opcode; failures reply with BIN_OP_ERROR.
+ * Streamed sensor frames carry the low 16 bits of their sample number;
+ * recorder download chunks (dump_recorder) carry their chunk number.
+ */
+
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <Arduino.h>
+
+// ---------------------------------------------------------------------------
+// Opcodes & Error Codes
+// ---------------------------------------------------------------------------
+
+#define BIN_MAGIC          0xB5
+#define BIN_REPLY_FLAG     0x80
+
+enum BinOpcode : uint8_t {
+  BIN_OP_ARM            = 0x01,  // BinArm        -> BinMotors
+  BIN_OP_SET_MOTORS     = 0x02,  // BinSetMotors  -> BinMotors
+  BIN_OP_GET_MOTORS     = 0x03,  // (none)        -> BinMotors
+  BIN_OP_READ_IMU       = 0x04,  // (none)        -> BinImu
+  BIN_OP_READ_SENSORS   = 0x05,  // (none)        -> BinSensors
+  BIN_OP_STREAM_SENSORS = 0x06,  // BinStream     -> BinStream (applied rate)
+  BIN_OP_SET_THROTTLE   = 0x07,  // BinSetThrottle -> BinThrottle
+  BIN_OP_RECORD_CHUNK   = 0x7C,  // push only     -> BinRecordChunk + records
+  BIN_OP_SENSOR_FRAME   = 0x7D,  // push only     -> BinSensors
+  BIN_OP_ERROR          = 0x7F   // reply only    -> BinError
+};
+
+enum BinErrorCode : uint8_t {
+  BIN_ERR_CRC        = 1,
+  BIN_ERR_LENGTH     = 2,
+  BIN_ERR_OPCODE     = 3,
+  BIN_ERR_DISABLED   = 4,
+  BIN_ERR_NOT_ARMED  = 5,
+  BIN_ERR_RANGE      = 6,
+  BIN_ERR_FRAMING    = 7
+};
+
+// ---------------------------------------------------------------------------
+// Frame Structures
+// ---------------------------------------------------------------------------
+
+struct __attribute__((packed)) BinHeader {
+  uint8_t magic;
+  uint8_t opcode;
+  uint16_t seq;
+};
+
+struct __attribute__((packed)) BinArm {
+  uint8_t arm;           // 1 = arm, 0 = disarm (motors to 0)
+};
+
+struct __attribute__((packed)) BinSetMotors {
+  uint8_t duty[4];       // 0-255
+};
+
+#define BIN_FLAG_ARMED  0x01
+#define BIN_FLAG_ESTOP  0x02   // Safety layer e-stop latched (re-arm to clear)
+
+struct __attribute__((packed)) BinMotors {
+  uint8_t duty[4];       // After safety clamping
+  uint8_t flags;         // BIN_FLAG_*
+};
+
+struct __attribute__((packed)) BinSetThrottle {
+  uint16_t throttle[4];  // 0-2000 (ESC_THROTTLE_MAX)
+};
+
+struct __attribute__((packed)) BinThrottle {
+  uint16_t throttle[4];  // After safety clamping
+  uint8_t flags;         // BIN_FLAG_*
+};
+
+struct __attribute__((packed)) BinImu {
+  uint32_t micros;       // Sample time
+  float accel[3];        // m/s^2
+  float gyro[3];         // deg/s
+  float orientation[3];  // roll, pitch, yaw (deg)
+};
+
+struct __attribute__((packed)) BinSensors {
+  uint32_t sample;       // Stream sample number (0 for read_sensors)
+  uint32_t micros;       // Sample time
+  float accel[3];
+  float gyro[3];
+  float altitudeM;
+  float pressureHpa;
+  uint8_t duty[4];
+  uint8_t flags;         // BIN_FLAG_*
+  uint16_t dropped;      // Stream samples skipped so far (saturating)
+};
+
+struct __attribute__((packed)) BinStream {
+  uint16_t rateHz;       // 0 stops, else 100-1000
+};
+
+#define BIN_RECORD_CHUNK_MAX  7   // 32-byte records per chunk
+
+struct __attribute__((packed)) BinRecordChunk {
+  uint32_t first;        // Record number of the first record (end of range if count is 0)
+  uint8_t count;         // Records that follow; 0 marks the end of the download
+  uint8_t recordSize;    // sizeof(RecordEntry), recorder.h
+};
+
+struct __attribute__((packed)) BinError {
+  uint8_t code;          // BinErrorCode
+};
+
+#define BIN_OVERHEAD      (sizeof(BinHeader) + sizeof(uint16_t))
+#define BIN_FRAME_MAX     (BIN_OVERHEAD + 232)   // Largest payload: a record chunk
+// COBS adds one byte per 254 plus the leading code byte; +2 delimiters
+#define BIN_WIRE_MAX      (BIN_FRAME_MAX + BIN_FRAME_MAX / 254 + 1 + 2)
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+/**
+ * CRC-16/CCITT-FALSE. Bitwise — frames are a few hundred bytes at most.
+ */
+inline uint16_t bin_crc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**
+ * COBS-encode `len` bytes into `out` (at least len + len / 254 + 1 bytes).
+ * Returns the encoded length; the output contains no 0x00.
+ */
+inline size_t cobs_encode(const uint8_t* in, size_t len, uint8_t* out) {
+  size_t codeAt = 0;
+  size_t o = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < len; i++) {
+    if (in[i] == 0) {
+      out[codeAt] = code;
+      codeAt = o++;
+      code = 1;
+    } else {
+      out[o++] = in[i];
+      if (++code == 0xFF) {
+        out[codeAt] = code;
+        codeAt = o++;
+        code = 1;
+      }
+    }
+  }
+  out[codeAt] = code;
+  return o;
+}
+
+/**
+ * COBS-decode `len` bytes (without delimiters). Works in place
+ * (out == in). Returns the decoded length, or 0 if the input is malformed.
+ */
+inline size_t cobs_decode(const uint8_t* in, size_t len, uint8_t* out) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < len) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > len) {
+      return 0;
+    }
+    for (uint8_t j = 1; j < code; j++) {
+      out[o++] = in[i++];
+    }
+    if (code != 0xFF && i < len) {
+      out[o++] = 0;
+    }
+  }
+  return o;
+}
+
+/**
+ * Validate a decoded frame. On success returns true and points `payload`
+ * at the payload bytes and sets `payloadLen`; on failure sets `err`.
+ */
+inline bool bin_parse_frame(const uint8_t* frame, size_t len, BinHeader& header,
+                            const uint8_t*& payload, size_t& payloadLen,
+                            BinErrorCode& err) {
+  if (len < BIN_OVERHEAD) {
+    err = BIN_ERR_LENGTH;
+    return false;
+  }
+  memcpy(&header, frame, sizeof(header));
+  if (header.magic != BIN_MAGIC) {
+    err = BIN_ERR_FRAMING;
+    return false;
+  }
+
+  uint16_t rxCrc;
+  memcpy(&rxCrc, frame + len - sizeof(rxCrc), sizeof(rxCrc));
+  if (bin_crc16(frame, len - sizeof(rxCrc)) != rxCrc) {
+    err = BIN_ERR_CRC;
+    return false;
+  }
+
+  payload = frame + sizeof(header);
+  payloadLen = len - BIN_OVERHEAD;
+  return true;
+}
+
+/**
+ * Build a frame and its wire form into `wire` (BIN_WIRE_MAX bytes):
+ * delimiter, COBS-encoded frame, delimiter. Returns the wire length.
+ */
+inline size_t bin_build_wire(uint8_t* wire, uint8_t opcode, uint16_t seq,
+                             const void* payload, size_t payloadLen) {
+  uint8_t frame[BIN_FRAME_MAX];
+  BinHeader header = {BIN_MAGIC, opcode, seq};
+  memcpy(frame, &header, sizeof(header));
+  if (payloadLen > 0) {
+    memcpy(frame + sizeof(header), payload, payloadLen);
+  }
+  size_t len = sizeof(header) + payloadLen;
+  uint16_t crc = bin_crc16(frame, len);
+  memcpy(frame + len, &crc, sizeof(crc));
+  len += sizeof(crc);
+
+  wire[0] = 0x00;
+  size_t n = 1 + cobs_encode(frame, len, wire + 1);
+  wire[n++] = 0x00;
+  return n;
+}
+
+#endif // BINARY_PROTOCOL_H
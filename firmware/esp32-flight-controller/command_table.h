@@ -0,0 +1,143 @@
+/**
+ * Command Dispatch Table for the Cube Robot Firmwares
+ *
+ * Maps JSON command names to handlers with a binary search over a table
+ * sorted at compile time, instead of a strcmp chain per packet. Entries
+ * can also carry their binary opcode, so both protocols share one place
+ * to attach per-command flags and latency counters.
+ *
+ * Identical copies live next to each sketch (Arduino only builds files in
+ * the sketch directory).
+ *
+ * Features:
+ * - O(log n) name lookup; static_assert(command_table_sorted(...)) keeps
+ *   the table sorted
+ * - O(1) opcode lookup through an index built once at startup
+ * - Per-command count / total / max handler time (CommandStats), formatted
+ *   for get_perf by command_format_stats()
+ * - Table lives in flash (constexpr); only the stats are in RAM
+ */
+
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <Arduino.h>
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define CMD_OPCODE_NONE   0      // JSON only
+#define CMD_OPCODE_SLOTS  128    // Request opcodes are 0x01-0x7F
+
+#define CMD_FLAG_QUERY    0x01   // Read-only: no side effects, reply is data
+
+typedef void (*CommandHandler)();
+
+struct CommandEntry {
+  const char* name;        // JSON command name; the table is sorted by this
+  uint8_t opcode;          // Binary opcode, CMD_OPCODE_NONE if JSON only
+  uint8_t flags;           // CMD_FLAG_*
+  CommandHandler handler;  // JSON handler (binary handlers stay in their switch)
+};
+
+struct CommandStats {
+  uint32_t count;
+  uint32_t totalUs;
+  uint32_t maxUs;
+};
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+/**
+ * strcmp usable in constant expressions (C++11 single-return form).
+ */
+constexpr int command_strcmp(const char* a, const char* b) {
+  return (*a != *b || *a == '\0')
+    ? (int)(unsigned char)*a - (int)(unsigned char)*b
+    : command_strcmp(a + 1, b + 1);
+}
+
+/**
+ * True if names are strictly ascending; use in a static_assert.
+ */
+constexpr bool command_table_sorted(const CommandEntry* table, size_t count) {
+  return count < 2 ||
+    (command_strcmp(table[0].name, table[1].name) < 0 &&
+     command_table_sorted(table + 1, count - 1));
+}
+
+/**
+ * Index of `name` in the table, or -1.
+ */
+inline int command_find(const CommandEntry* table, size_t count, const char* name) {
+  int lo = 0;
+  int hi = (int)count - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    int cmp = strcmp(name, table[mid].name);
+    if (cmp == 0) {
+      return mid;
+    }
+    if (cmp < 0) {
+      hi = mid - 1;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Fill `index` (CMD_OPCODE_SLOTS entries) with opcode -> table index, -1
+ * where no entry has that opcode. Call once from setup().
+ */
+inline void command_index_opcodes(const CommandEntry* table, size_t count, int8_t* index) {
+  for (int op = 0; op < CMD_OPCODE_SLOTS; op++) {
+    index[op] = -1;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (table[i].opcode != CMD_OPCODE_NONE && table[i].opcode < CMD_OPCODE_SLOTS) {
+      index[table[i].opcode] = (int8_t)i;
+    }
+  }
+}
+
+inline int command_find_opcode(const int8_t* index, uint8_t opcode) {
+  return opcode < CMD_OPCODE_SLOTS ? index[opcode] : -1;
+}
+
+inline void command_record(CommandStats& stats, uint32_t us) {
+  stats.count++;
+  stats.totalUs += us;
+  if (us > stats.maxUs) {
+    stats.maxUs = us;
+  }
+}
+
+/**
+ * Append "name":[count,mean_us,max_us] for every command that has run,
+ * comma separated, without the enclosing braces. Returns the length
+ * written; stops before an entry that would not fit.
+ */
+inline int command_format_stats(char* out, size_t size, const CommandEntry* table,
+                                const CommandStats* stats, size_t count) {
+  int n = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (stats[i].count == 0) {
+      continue;
+    }
+    int len = snprintf(out + n, size - n, "%s\"%s\":[%lu,%lu,%lu]",
+      n > 0 ? "," : "", table[i].name, (unsigned long)stats[i].count,
+      (unsigned long)(stats[i].totalUs / stats[i].count), (unsigned long)stats[i].maxUs);
+    if (len < 0 || (size_t)len >= size - n) {
+      break;   // Anything past `n` is a partial entry
+    }
+    n += len;
+  }
+  return n;
+}
+
+#endif // COMMAND_TABLE_H
@@ -0,0 +1,280 @@
+/**
+ * ESC Output Stage for ESP32 Flight Controller
+ *
+ * Drives the four motor outputs in one of several ESC protocols. Commands
+ * are throttle values 0-ESC_THROTTLE_MAX for every mode; the driver maps
+ * them to the protocol's range. esc_write() updates all four channels
+ * together.
+ *
+ * Modes:
+ * - ESC_MODE_LEDC: 50 Hz LEDC PWM, 8-bit duty (original output stage)
+ * - ESC_MODE_PWM400: 400 Hz MCPWM, 1000-2000 us pulses
+ * - ESC_MODE_ONESHOT125: 2 kHz MCPWM, 125-250 us pulses
+ * - ESC_MODE_DSHOT600: digital 11-bit frames on the RMT (ESP32-S3 TX
+ *   channels 0-3), sent on every esc_write()
+ *
+ * Features:
+ * - MCPWM timers synchronized to timer 0; new pulse widths latch at the
+ *   period start, so all four motors change on the same edge
+ * - DShot channels in one RMT sync group: the four frames start together
+ * - 10 MHz MCPWM timer clock (0.1 us steps, ~1250 levels for OneShot125)
+ */
+
+#ifndef ESC_OUTPUT_H
+#define ESC_OUTPUT_H
+
+#include <Arduino.h>
+#include "driver/mcpwm.h"
+#include "driver/rmt.h"
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define ESC_MOTORS            4
+#define ESC_THROTTLE_MAX      2000     // 11-bit DShot range 48-2047
+
+#define ESC_LEDC_FREQ         50
+#define ESC_LEDC_RESOLUTION   8
+#define ESC_MCPWM_RESOLUTION  10000000 // Timer clock, Hz
+
+#define DSHOT_RMT_CLK_DIV     2        // 80 MHz / 2 = 25 ns ticks
+#define DSHOT600_BIT_TICKS    67       // 1.67 us
+#define DSHOT600_ONE_TICKS    50       // 1.25 us high
+#define DSHOT600_ZERO_TICKS   25       // 0.625 us high
+#define DSHOT_THROTTLE_MIN    48       // 0-47 are special commands
+#define DSHOT_FRAME_BITS      16
+
+enum EscMode {
+  ESC_MODE_LEDC = 0,
+  ESC_MODE_PWM400,
+  ESC_MODE_ONESHOT125,
+  ESC_MODE_DSHOT600,
+  ESC_MODE_COUNT
+};
+
+struct EscModeInfo {
+  const char* name;
+  uint32_t frequencyHz;   // Pulse rate for PWM modes, 0 for DShot (per esc_write)
+  float minPulseUs;
+  float maxPulseUs;
+};
+
+static const EscModeInfo ESC_MODES[ESC_MODE_COUNT] = {
+  {"pwm50",      ESC_LEDC_FREQ, 0.0f,    0.0f},
+  {"pwm400",     400,           1000.0f, 2000.0f},
+  {"oneshot125", 2000,          125.0f,  250.0f},
+  {"dshot600",   0,             0.0f,    0.0f},
+};
+
+static EscMode escMode = ESC_MODE_LEDC;
+static bool escActive = false;
+static int escPins[ESC_MOTORS];
+static uint16_t escLast[ESC_MOTORS];
+static rmt_item32_t escFrames[ESC_MOTORS][DSHOT_FRAME_BITS + 1];
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+inline const char* esc_mode_name(EscMode mode) {
+  return mode < ESC_MODE_COUNT ? ESC_MODES[mode].name : "unknown";
+}
+
+/**
+ * Look up a mode by name. Returns false if `name` is not a mode.
+ */
+inline bool esc_mode_from_name(const char* name, EscMode& mode) {
+  for (int i = 0; i < ESC_MODE_COUNT; i++) {
+    if (strcmp(name, ESC_MODES[i].name) == 0) {
+      mode = (EscMode)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * 16-bit DShot frame: 11-bit value, telemetry bit, 4-bit checksum.
+ */
+inline uint16_t dshot_frame(uint16_t value, bool telemetry) {
+  uint16_t packet = (value << 1) | (telemetry ? 1 : 0);
+  uint16_t crc = (packet ^ (packet >> 4) ^ (packet >> 8)) & 0x0F;
+  return (packet << 4) | crc;
+}
+
+inline void dshot_encode(rmt_item32_t* items, uint16_t frame) {
+  for (int bit = 0; bit < DSHOT_FRAME_BITS; bit++) {
+    bool one = frame & (0x8000 >> bit);
+    uint16_t high = one ? DSHOT600_ONE_TICKS : DSHOT600_ZERO_TICKS;
+    items[bit].level0 = 1;
+    items[bit].duration0 = high;
+    items[bit].level1 = 0;
+    items[bit].duration1 = DSHOT600_BIT_TICKS - high;
+  }
+  items[DSHOT_FRAME_BITS].val = 0;   // End marker
+}
+
+inline bool esc_init_mcpwm(EscMode mode) {
+  const EscModeInfo& info = ESC_MODES[mode];
+  const mcpwm_io_signals_t signals[ESC_MOTORS] = {MCPWM0A, MCPWM0B, MCPWM1A, MCPWM1B};
+  for (int i = 0; i < ESC_MOTORS; i++) {
+    if (mcpwm_gpio_init(MCPWM_UNIT_0, signals[i], escPins[i]) != ESP_OK) {
+      return false;
+    }
+  }
+
+  mcpwm_config_t config = {};
+  config.frequency = info.frequencyHz;
+  config.cmpr_a = 0.0f;
+  config.cmpr_b = 0.0f;
+  config.counter_mode = MCPWM_UP_COUNTER;
+  config.duty_mode = MCPWM_DUTY_MODE_0;
+
+  const mcpwm_timer_t timers[2] = {MCPWM_TIMER_0, MCPWM_TIMER_1};
+  for (int t = 0; t < 2; t++) {
+    mcpwm_timer_set_resolution(MCPWM_UNIT_0, timers[t], ESC_MCPWM_RESOLUTION);
+    if (mcpwm_init(MCPWM_UNIT_0, timers[t], &config) != ESP_OK) {
+      return false;
+    }
+  }
+
+  // Timer 1 restarts with timer 0, so both motor pairs share period edges
+  mcpwm_set_timer_sync_output(MCPWM_UNIT_0, MCPWM_TIMER_0, MCPWM_SWSYNC_SOURCE_TEZ);
+  mcpwm_sync_config_t sync = {};
+  sync.sync_sig = MCPWM_SELECT_TIMER0_SYNC;
+  sync.timer_val = 0;
+  sync.count_direction = MCPWM_TIMER_DIRECTION_UP;
+  mcpwm_sync_configure(MCPWM_UNIT_0, MCPWM_TIMER_1, &sync);
+  return true;
+}
+
+inline bool esc_init_dshot() {
+  for (int i = 0; i < ESC_MOTORS; i++) {
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)escPins[i], (rmt_channel_t)i);
+    config.clk_div = DSHOT_RMT_CLK_DIV;
+    config.tx_config.idle_output_en = true;
+    config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+    if (rmt_config(&config) != ESP_OK ||
+        rmt_driver_install((rmt_channel_t)i, 0, 0) != ESP_OK) {
+      return false;
+    }
+    rmt_add_channel_to_group((rmt_channel_t)i);
+  }
+  return true;
+}
+
+/**
+ * Update all four motors (throttle 0-ESC_THROTTLE_MAX, 0 = stop). PWM
+ * modes only touch changed channels; DShot sends a frame to every motor
+ * on each call, since ESCs disarm when frames stop.
+ */
+inline void esc_write(const uint16_t throttle[ESC_MOTORS]) {
+  if (!escActive) {
+    return;
+  }
+
+  if (escMode == ESC_MODE_DSHOT600) {
+    for (int i = 0; i < ESC_MOTORS; i++) {
+      uint16_t t = min(throttle[i], (uint16_t)ESC_THROTTLE_MAX);
+      uint16_t value = t == 0 ? 0 : t + DSHOT_THROTTLE_MIN - 1;
+      dshot_encode(escFrames[i], dshot_frame(value, false));
+    }
+    // Grouped channels start together once all four are loaded
+    for (int i = 0; i < ESC_MOTORS; i++) {
+      rmt_write_items((rmt_channel_t)i, escFrames[i], DSHOT_FRAME_BITS + 1, false);
+    }
+    return;
+  }
+
+  const EscModeInfo& info = ESC_MODES[escMode];
+  for (int i = 0; i < ESC_MOTORS; i++) {
+    uint16_t t = min(throttle[i], (uint16_t)ESC_THROTTLE_MAX);
+    if (t == escLast[i]) {
+      continue;
+    }
+    escLast[i] = t;
+
+    if (escMode == ESC_MODE_LEDC) {
+      ledcWrite(i, ((uint32_t)t * 255 + ESC_THROTTLE_MAX / 2) / ESC_THROTTLE_MAX);
+    } else {
+      // Shadowed compare registers latch at the next period start
+      float pulseUs = info.minPulseUs + (info.maxPulseUs - info.minPulseUs) * t / ESC_THROTTLE_MAX;
+      float dutyPct = pulseUs * info.frequencyHz / 10000.0f;
+      mcpwm_set_duty(MCPWM_UNIT_0, (mcpwm_timer_t)(i / 2),
+                     (i % 2) ? MCPWM_GEN_B : MCPWM_GEN_A, dutyPct);
+    }
+  }
+}
+
+/**
+ * Release the current mode's peripheral and drive the pins low.
+ */
+inline void esc_deinit() {
+  if (!escActive) {
+    return;
+  }
+  if (escMode == ESC_MODE_LEDC) {
+    for (int i = 0; i < ESC_MOTORS; i++) {
+      ledcWrite(i, 0);
+      ledcDetachPin(escPins[i]);
+    }
+  } else if (escMode == ESC_MODE_DSHOT600) {
+    for (int i = 0; i < ESC_MOTORS; i++) {
+      rmt_remove_channel_from_group((rmt_channel_t)i);
+      rmt_driver_uninstall((rmt_channel_t)i);
+    }
+  } else {
+    mcpwm_stop(MCPWM_UNIT_0, MCPWM_TIMER_0);
+    mcpwm_stop(MCPWM_UNIT_0, MCPWM_TIMER_1);
+  }
+  for (int i = 0; i < ESC_MOTORS; i++) {
+    pinMode(escPins[i], OUTPUT);
+    digitalWrite(escPins[i], LOW);
+  }
+  escActive = false;
+}
+
+/**
+ * Configure `pins` (four motors) for `mode` and output zero throttle.
+ * Returns false if the peripheral could not be set up.
+ */
+inline bool esc_init(EscMode mode, const int pins[ESC_MOTORS]) {
+  escMode = mode;
+  for (int i = 0; i < ESC_MOTORS; i++) {
+    escPins[i] = pins[i];
+    escLast[i] = UINT16_MAX;   // Force the first write
+  }
+
+  bool ok = true;
+  if (mode == ESC_MODE_LEDC) {
+    for (int i = 0; i < ESC_MOTORS; i++) {
+      ledcSetup(i, ESC_LEDC_FREQ, ESC_LEDC_RESOLUTION);
+      ledcAttachPin(pins[i], i);
+    }
+  } else if (mode == ESC_MODE_DSHOT600) {
+    ok = esc_init_dshot();
+  } else {
+    ok = esc_init_mcpwm(mode);
+  }
+  escActive = true;
+
+  if (!ok) {
+    esc_deinit();   // Release whatever was set up before the failure
+    return false;
+  }
+  const uint16_t zero[ESC_MOTORS] = {0, 0, 0, 0};
+  esc_write(zero);
+  return true;
+}
+
+/**
+ * Command updates per second the ESC can act on at `callHz` esc_write()
+ * calls per second.
+ */
+inline uint32_t esc_update_hz(EscMode mode, uint32_t callHz) {
+  uint32_t pulseHz = ESC_MODES[mode].frequencyHz;
+  return pulseHz == 0 ? callHz : min(pulseHz, callHz);
+}
+
+#endif // ESC_OUTPUT_H
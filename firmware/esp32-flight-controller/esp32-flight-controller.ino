@@ -5,13 +5,21 @@
  * This firmware enables real ESP32-S3 hardware to communicate with the
  * LLMos Flight Simulator applet.
  *
- * Protocol: Newline-delimited JSON over USB CDC
+ * Protocol: Newline-delimited JSON over USB CDC, plus optional
+ *           COBS-framed binary commands (binary_protocol.h) enabled via
+ *           set_binary
  * Baud Rate: 115200
  *
  * Commands:
  * - get_info: Get device information
  * - arm/disarm: Enable/disable motor output
  * - set_motors: Set all 4 motor PWM values [0-255]
+ * - set_throttle: Set all 4 motors at full resolution [0-2000]
+ * - set_setpoint: Fly on the on-board attitude/rate PID (roll, pitch,
+ *   yaw rate, throttle); set_motors/set_throttle return to raw passthrough
+ * - set_pid: Tune the on-board PID gains
+ * - set_esc_mode: Select the ESC protocol (pwm50, pwm400, oneshot125,
+ *   dshot600; esc_output.h)
  * - get_motors: Read current motor states
  * - read_imu: Read IMU sensor data
  * - read_barometer: Read altitude/pressure data
@@ -19,12 +27,37 @@
  * - read_adc: Analog input reading
  * - set_pwm: PWM output control
  * - read_sensors: Read all sensor data at once
+ * - stream_sensors: Push sensor frames at a fixed rate (100-1000 Hz)
+ * - set_binary: Enable/disable binary frames
+ * - batch: Run up to 8 actions from one line, one combined reply
+ * - get_safety: Safety layer state and reaction-time statistics
+ * - get_recorder/set_recorder: On-board data recorder status and control
+ * - dump_recorder: Download recorded samples as binary chunk frames
+ * - get_perf: Section timings (loop, parsing, serial writes, sensor,
+ *   control and safety tasks) and per-action handler times
+ * - get_power/set_power: Idle power state and settings
+ *
+ * Safety: motor outputs are written only by a 1 kHz safety task
+ * (safety_layer.h) that applies the PWM ceiling, the host heartbeat
+ * timeout and the e-stop latch, independently of the command loop.
+ *
+ * Recorder: IMU samples, attitude, motor outputs, safety events and
+ * command arrivals are recorded at loop rate into a PSRAM ring
+ * (recorder.h) for download after a flight.
+ *
+ * Power: disarmed, not streaming and without host traffic for the idle
+ * timeout, the CPU drops to 80 MHz and the command loop polls once per
+ * tick instead of spinning (power_manager.h); the first byte of the next
+ * command wakes it.
  *
  * Hardware Requirements:
  * - ESP32-S3 DevKit or compatible board
- * - Optional: MPU6050/ICM20948 IMU on I2C
- * - Optional: BMP280/BME280 barometer on I2C
- * - 4x ESC/Motor connections on GPIO 12-15
+ * - Optional: MPU6050/MPU6500/MPU9250 IMU on I2C, INT on GPIO 4
+ *   (imu_mpu6050.h; attitude from mahony_filter.h at 1 kHz)
+ * - Optional: BMP280/BME280 barometer on I2C (baro_bmp280.h)
+ * - Sensors that are not detected are simulated, for HIL without hardware
+ * - 4x ESC/Motor connections on GPIO 12-15 (50 Hz PWM by default;
+ *   MCPWM OneShot125/PWM400 or RMT DShot600 via set_esc_mode)
  *
  * @version 1.0.0
  * @date 2026-01-06
@@ -32,30 +65,90 @@
 
 #include <ArduinoJson.h>
 #include <Wire.h>
+#include "esp_timer.h"
+#include "line_reader.h"
+#include "binary_protocol.h"
+#include "command_table.h"
+#include "imu_mpu6050.h"
+#include "baro_bmp280.h"
+#include "mahony_filter.h"
+#include "safety_layer.h"
+#include "esc_output.h"
+#include "flight_pid.h"
+#include "tx_buffer.h"
+#include "recorder.h"
+#include "perf_profiler.h"
+#include "power_manager.h"
 
 // ===================== CONFIGURATION =====================
 
 // Motor PWM pins (adjust for your hardware)
 const int MOTOR_PINS[4] = {12, 13, 14, 15};
 
-// PWM configuration
-const int PWM_FREQ = 50;        // 50Hz for standard servo/ESC
+// ESC protocol at boot (set_esc_mode switches while disarmed)
+const EscMode ESC_DEFAULT_MODE = ESC_MODE_LEDC;
+
+// Generic PWM configuration (set_pwm)
 const int PWM_RESOLUTION = 8;   // 8-bit (0-255)
 
 // I2C pins for sensors
 const int I2C_SDA = 21;
 const int I2C_SCL = 22;
+const uint32_t I2C_CLOCK_HZ = 400000;  // MPU6050 / BMP280 fast mode
+const int IMU_INT_PIN = 4;             // MPU6050 INT (data ready)
+
+// Sensor task: drains the IMU FIFO and runs attitude fusion (core 0)
+const int SENSOR_CORE = 0;
+const int SENSOR_TASK_PRIORITY = 3;
+
+// Safety task: sole writer of the motor PWM outputs (core 0, above sensors)
+const int SAFETY_CORE = 0;
+const int SAFETY_TASK_PRIORITY = 5;
+const uint32_t SAFETY_PERIOD_MS = 1;   // 1 kHz with the default 1000 Hz tick
+// ESC protocol switches (MCPWM / RMT driver install and their ESP_LOG
+// output) run on this stack too; get_safety reports the headroom left
+const uint32_t SAFETY_STACK_BYTES = 4096;
 
 // Built-in LED for status
 const int STATUS_LED = 2;
 
+// Actions per batch envelope
+const int BATCH_MAX_CMDS = 8;
+
+// Request documents hold a full batch line: the envelope, BATCH_MAX_CMDS
+// entries of the largest command (set_pid: 7 members; set_motors: a
+// 4-element array), plus the line's strings, which batchDoc.set() copies
+const size_t COMMAND_ENTRY_SIZE = JSON_OBJECT_SIZE(7) + JSON_ARRAY_SIZE(4);
+const size_t COMMAND_DOC_SIZE = JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(BATCH_MAX_CMDS) +
+                                BATCH_MAX_CMDS * COMMAND_ENTRY_SIZE + LINE_READER_MAX;
+
+// Sensor streaming rate limits (stream_sensors)
+const int STREAM_MIN_HZ = 100;
+const int STREAM_MAX_HZ = 1000;
+
+// Recorder download chunks sent per loop() pass (dump_recorder)
+const int RECORDER_DUMP_BURST = 4;
+
+// A loop() pass longer than this delays the next command (get_perf overruns)
+const uint32_t LOOP_BUDGET_US = 1000;
+
 // ===================== STATE =====================
 
-bool armed = false;
-int motorValues[4] = {0, 0, 0, 0};
+enum ControlMode {
+  CONTROL_RAW,       // Host sends motor commands (set_motors / set_throttle)
+  CONTROL_SETPOINT   // Host sends setpoints, sensorTask runs the PID
+};
+
+// Written by loop(), sensorTask (setpoint mode) and safetyTask; setArmed()
+// and writeMotorThrottle() order their stores so a late throttle write
+// cannot outlive a disarm
+std::atomic<bool> armed{false};
+volatile ControlMode controlMode = CONTROL_RAW;
+std::atomic<int> motorValues[4];     // Commanded throttle 0-ESC_THROTTLE_MAX, safety-clamped
 unsigned long startTime = 0;
 
-// Simulated sensor values (replace with real sensor reads)
+// Sensor values as seen by command handlers: copied from the sensor task
+// by readIMUSensor()/readBaroSensor(), or simulated if a sensor is absent
 float imuAccel[3] = {0.0, 0.0, 9.81};
 float imuGyro[3] = {0.0, 0.0, 0.0};
 float imuOrientation[3] = {0.0, 0.0, 0.0};
@@ -63,9 +156,92 @@ float baroAltitude = 0.0;
 float baroPressure = 1013.25;
 float baroTemperature = 25.0;
 
-// JSON buffer
-StaticJsonDocument<512> doc;
-String inputBuffer = "";
+// Published by sensorTask under sensorMux
+bool imuPresent = false;
+bool baroPresent = false;
+ImuSample imuLatest = {{0.0f, 0.0f, 9.81f}, {0.0f, 0.0f, 0.0f}};
+float attitudeDeg[3] = {0.0f, 0.0f, 0.0f};  // roll, pitch, yaw
+BaroReading baroLatest = {1013.25f, 25.0f, 0.0f};
+portMUX_TYPE sensorMux = portMUX_INITIALIZER_UNLOCKED;
+MahonyFilter attitudeFilter;
+
+// On-board flight control (set_setpoint / set_pid); setpoint and gains
+// are written by loop() and read by sensorTask under sensorMux
+FlightSetpoint flightSetpoint = {0.0f, 0.0f, 0.0f, 0.0f};
+FlightGains flightGains = FLIGHT_DEFAULT_GAINS;
+FlightControlState flightState;
+volatile uint32_t controlRuns = 0;
+
+// Safety layer state (safety_layer.h) is lock-free; safetyTask never
+// waits on loop(). Timing counters are written by safetyTask only.
+int motorOutputs[4] = {0, 0, 0, 0};   // Last throttle written by safetyTask
+TaskHandle_t safetyTaskHandle = nullptr;
+
+// ESC protocol switch, performed by safetyTask (it owns the output stage)
+std::atomic<int> escModeRequest{-1};  // EscMode to switch to, -1 = none
+std::atomic<bool> escModeOk{true};    // Result of the last switch
+
+struct SafetyTiming {
+  std::atomic<uint32_t> runs;
+  std::atomic<uint32_t> trips;         // Transitions into e-stop
+  std::atomic<uint32_t> periodMaxUs;   // Longest gap between two safety checks
+  std::atomic<uint32_t> execMaxUs;     // Longest check + output write
+};
+SafetyTiming safetyTiming;
+
+// Request document and serial line buffer (parsed in place, no heap).
+// Replies are built in their own document (or written directly for
+// fixed telemetry shapes) and sent from txBuffer in one write.
+StaticJsonDocument<COMMAND_DOC_SIZE> doc;
+StaticJsonDocument<768> reply;
+LineReader lineReader;
+TxBuffer txBuffer;
+
+// Batch envelope: the envelope is kept in batchDoc while each entry is
+// copied into `doc` and run; their replies collect in batchTx
+StaticJsonDocument<COMMAND_DOC_SIZE> batchDoc;
+TxBuffer batchTx;
+bool batchActive = false;
+
+// Sensor streaming: streamTimer counts sample slots, loop() emits them
+esp_timer_handle_t streamTimer = nullptr;
+volatile uint32_t streamTicks = 0;
+uint32_t streamTicksHandled = 0;
+uint32_t streamDropped = 0;     // Slots skipped (late loop or full TX buffer)
+int streamRateHz = 0;           // 0 = not streaming
+bool streamBinary = false;      // Push BIN_OP_SENSOR_FRAME instead of JSON
+
+// Binary protocol (set_binary)
+bool binaryEnabled = false;
+uint8_t wireBuffer[BIN_WIRE_MAX];
+
+// Recorder download in progress (dump_recorder), serviced by loop()
+bool dumpActive = false;
+uint32_t dumpNext = 0;          // Next record number to send
+uint32_t dumpEnd = 0;           // One past the last record of the range
+uint16_t dumpChunk = 0;         // Chunk frame seq
+
+// Profiled sections (perf_profiler.h), reported by get_perf
+enum PerfId {
+  PERF_LOOP,       // One loop() pass
+  PERF_PARSE,      // deserializeJson
+  PERF_COMMAND,    // One command: parse, handler and reply
+  PERF_TX_WRITE,   // Serial.write of one reply
+  PERF_SENSOR,     // One sensorTask pass: FIFO read, fusion, control
+  PERF_CONTROL,    // One cascade step and mix
+  PERF_SAFETY,     // One safetyTask run
+  PERF_COUNT
+};
+
+PerfSection perfSections[PERF_COUNT] = {
+  {"loop",     LOOP_BUDGET_US},
+  {"parse",    0},
+  {"command",  0},
+  {"tx_write", 0},
+  {"sensor",   1000000 / IMU_SAMPLE_HZ},
+  {"control",  0},
+  {"safety",   SAFETY_PERIOD_MS * 1000},
+};
 
 // ===================== SETUP =====================
 
@@ -80,24 +256,39 @@ void setup() {
 
   // Record start time
   startTime = millis();
+  perf_init();
+
+  // No light sleep: it would drop the USB CDC link
+  power_init(false);
 
   // Initialize status LED
   pinMode(STATUS_LED, OUTPUT);
   digitalWrite(STATUS_LED, LOW);
 
-  // Initialize motor PWM channels
-  for (int i = 0; i < 4; i++) {
-    ledcSetup(i, PWM_FREQ, PWM_RESOLUTION);
-    ledcAttachPin(MOTOR_PINS[i], i);
-    ledcWrite(i, 0);  // Motors off
-  }
+  // Initialize motor outputs (motors off)
+  esc_init(ESC_DEFAULT_MODE, MOTOR_PINS);
+
+  // Recorder first, so the tasks below can record from their first run
+  recorder_init();
+
+  // Start enforcing limits before any command can reach the motors
+  initSafety();
 
   // Initialize I2C for sensors
-  Wire.begin(I2C_SDA, I2C_SCL);
+  Wire.begin(I2C_SDA, I2C_SCL, I2C_CLOCK_HZ);
 
   // Initialize sensors (if present)
   initSensors();
 
+  line_reader_init(lineReader);
+  initCommandTable();
+
+  // Sample clock for stream_sensors
+  const esp_timer_create_args_t streamTimerArgs = {
+    onStreamTimer, nullptr, ESP_TIMER_TASK, "stream", true
+  };
+  esp_timer_create(&streamTimerArgs, &streamTimer);
+
   // Send ready message
   Serial.println("{\"status\":\"ok\",\"msg\":\"ESP32-S3 Flight Controller ready\"}");
 }
@@ -105,35 +296,108 @@ void setup() {
 // ===================== MAIN LOOP =====================
 
 void loop() {
-  // Read serial input
-  while (Serial.available()) {
-    char c = Serial.read();
-
-    if (c == '\n') {
-      // Process complete command
-      processCommand(inputBuffer);
-      inputBuffer = "";
-    } else if (c != '\r') {
-      inputBuffer += c;
+  uint32_t loopStart = perf_cycles();
+
+  // Idle: wake on the first byte, before the line is complete, so wake_us
+  // counts from when the command arrived rather than when it was parsed
+  if (power_is_idle() && Serial.available() > 0) {
+    power_note_activity();
+  }
+
+  // Handle every complete command already buffered by the serial driver
+  LineStatus line;
+  while ((line = line_reader_poll(lineReader, Serial)) != LINE_NONE) {
+    power_note_activity();
+    if (line == LINE_READY) {
+      processCommand(lineReader.buf, lineReader.len);
+    } else if (line == LINE_FRAME) {
+      processBinaryFrame((uint8_t*)lineReader.buf, lineReader.len);
+    } else {
+      sendError("Line too long");
     }
   }
 
+  // Emit a sensor frame if a stream sample slot has elapsed
+  serviceSensorStream();
+
+  // Send the next recorder chunks while a download is running
+  serviceRecorderDump();
+
   // Update status LED (blink when armed)
   if (armed) {
     digitalWrite(STATUS_LED, (millis() / 200) % 2);
   } else {
     digitalWrite(STATUS_LED, LOW);
   }
+  perf_record_cycles(perfSections[PERF_LOOP], perf_cycles() - loopStart);
+
+  // Armed, streaming or downloading keeps full power
+  power_update(armed || streamRateHz > 0 || dumpActive);
 
-  // Small delay to prevent watchdog issues
-  delay(1);
+  // Let other ready tasks run without adding a tick of latency per command;
+  // idle, sleep one tick between polls so the core can clock-gate
+  if (power_is_idle()) {
+    delay(power_idle_poll_ms());
+  } else {
+    yield();
+  }
 }
 
 // ===================== COMMAND PROCESSING =====================
 
-void processCommand(String json) {
+// Actions sorted by name (binary search); opcode 0 = JSON only
+constexpr CommandEntry COMMANDS[] = {
+  {"arm",            BIN_OP_ARM,            0,              handleArmAction},
+  {"disarm",         CMD_OPCODE_NONE,       0,              handleDisarmAction},
+  {"dump_recorder",  CMD_OPCODE_NONE,       0,              handleDumpRecorder},
+  {"get_info",       CMD_OPCODE_NONE,       CMD_FLAG_QUERY, handleGetInfo},
+  {"get_motors",     BIN_OP_GET_MOTORS,     CMD_FLAG_QUERY, handleGetMotors},
+  {"get_perf",       CMD_OPCODE_NONE,       CMD_FLAG_QUERY, handleGetPerf},
+  {"get_power",      CMD_OPCODE_NONE,       CMD_FLAG_QUERY, handleGetPower},
+  {"get_recorder",   CMD_OPCODE_NONE,       CMD_FLAG_QUERY, handleGetRecorder},
+  {"get_safety",     CMD_OPCODE_NONE,       CMD_FLAG_QUERY, handleGetSafety},
+  {"read_adc",       CMD_OPCODE_NONE,       CMD_FLAG_QUERY, handleReadADC},
+  {"read_barometer", CMD_OPCODE_NONE,       CMD_FLAG_QUERY, handleReadBarometer},
+  {"read_gpio",      CMD_OPCODE_NONE,       CMD_FLAG_QUERY, handleReadGPIO},
+  {"read_imu",       BIN_OP_READ_IMU,       CMD_FLAG_QUERY, handleReadIMU},
+  {"read_sensors",   BIN_OP_READ_SENSORS,   CMD_FLAG_QUERY, handleReadSensors},
+  {"set_altitude",   CMD_OPCODE_NONE,       0,              handleSetAltitude},
+  {"set_binary",     CMD_OPCODE_NONE,       0,              handleSetBinary},
+  {"set_esc_mode",   CMD_OPCODE_NONE,       0,              handleSetEscMode},
+  {"set_gpio",       CMD_OPCODE_NONE,       0,              handleSetGPIO},
+  {"set_motors",     BIN_OP_SET_MOTORS,     0,              handleSetMotors},
+  {"set_pid",        CMD_OPCODE_NONE,       0,              handleSetPid},
+  {"set_power",      CMD_OPCODE_NONE,       0,              handleSetPower},
+  {"set_pwm",        CMD_OPCODE_NONE,       0,              handleSetPWM},
+  {"set_recorder",   CMD_OPCODE_NONE,       0,              handleSetRecorder},
+  {"set_setpoint",   CMD_OPCODE_NONE,       0,              handleSetSetpoint},
+  {"set_throttle",   BIN_OP_SET_THROTTLE,   0,              handleSetThrottle},
+  {"stream_sensors", BIN_OP_STREAM_SENSORS, 0,              handleStreamSensors},
+};
+constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+static_assert(command_table_sorted(COMMANDS, COMMAND_COUNT), "COMMANDS must be sorted by name");
+
+// Handler time per action, JSON and binary alike
+CommandStats commandStats[COMMAND_COUNT] = {};
+int8_t commandOpcodes[CMD_OPCODE_SLOTS];
+
+void initCommandTable() {
+  command_index_opcodes(COMMANDS, COMMAND_COUNT, commandOpcodes);
+}
+
+/**
+ * Parse and dispatch one command. `json` is modified in place
+ * (zero-copy parse); it must stay untouched until the reply is sent.
+ */
+void processCommand(char* json, size_t len) {
+  PERF_SCOPE(perfSections[PERF_COMMAND]);
+
   // Parse JSON
-  DeserializationError error = deserializeJson(doc, json);
+  DeserializationError error;
+  {
+    PERF_SCOPE(perfSections[PERF_PARSE]);
+    error = deserializeJson(doc, json, len);
+  }
 
   if (error) {
     sendError("JSON parse error");
@@ -147,88 +411,115 @@ void processCommand(String json) {
     return;
   }
 
-  // Route to handler
-  if (strcmp(action, "get_info") == 0) {
-    handleGetInfo();
-  }
-  else if (strcmp(action, "arm") == 0) {
-    handleArm(true);
-  }
-  else if (strcmp(action, "disarm") == 0) {
-    handleArm(false);
-  }
-  else if (strcmp(action, "set_motors") == 0) {
-    handleSetMotors();
-  }
-  else if (strcmp(action, "get_motors") == 0) {
-    handleGetMotors();
-  }
-  else if (strcmp(action, "read_imu") == 0) {
-    handleReadIMU();
-  }
-  else if (strcmp(action, "read_barometer") == 0) {
-    handleReadBarometer();
-  }
-  else if (strcmp(action, "set_gpio") == 0) {
-    handleSetGPIO();
-  }
-  else if (strcmp(action, "read_gpio") == 0) {
-    handleReadGPIO();
-  }
-  else if (strcmp(action, "read_adc") == 0) {
-    handleReadADC();
+  if (strcmp(action, "batch") == 0) {
+    hostHeartbeat();
+    processBatch();
+    return;
   }
-  else if (strcmp(action, "set_pwm") == 0) {
-    handleSetPWM();
+
+  // Route to handler
+  int index = command_find(COMMANDS, COMMAND_COUNT, action);
+  if (index < 0) {
+    sendError("Unknown action");
+    return;
   }
-  else if (strcmp(action, "read_sensors") == 0) {
-    handleReadSensors();
+  hostHeartbeat();
+  runAction(index);
+}
+
+void runAction(int index) {
+  unsigned long start = micros();
+  COMMANDS[index].handler();
+  unsigned long elapsed = micros() - start;
+  command_record(commandStats[index], elapsed);
+
+  float handlerUs = elapsed;
+  recorder_write_at(start, REC_COMMAND, 0, index, &handlerUs, 1);
+}
+
+/**
+ * {"action":"batch","cmds":[{...},{...}]}: validate every entry, then run
+ * them back to back (nothing else is handled in between) and send one
+ * reply, {"status":"ok","action":"batch","results":[...]}. If any entry
+ * is invalid, none is run.
+ */
+void processBatch() {
+  batchDoc.set(doc);
+  JsonArray cmds = batchDoc["cmds"];
+  if (cmds.isNull() || cmds.size() == 0 || cmds.size() > (size_t)BATCH_MAX_CMDS) {
+    sendError("cmds must be an array of 1-8 actions");
+    return;
   }
-  else if (strcmp(action, "set_altitude") == 0) {
-    handleSetAltitude();
+
+  int indices[BATCH_MAX_CMDS];
+  int count = 0;
+  for (JsonObject cmd : cmds) {
+    const char* action = cmd["action"] | "";
+    int index = command_find(COMMANDS, COMMAND_COUNT, action);
+    if (index < 0) {
+      sendError("Unknown action in batch");
+      return;
+    }
+    indices[count++] = index;
   }
-  else {
-    sendError("Unknown action");
+
+  tx_begin(batchTx);
+  tx_raw(batchTx, "{\"status\":\"ok\",\"action\":\"batch\",\"results\":[");
+  batchActive = true;
+  for (int i = 0; i < count; i++) {
+    doc.set(cmds[i]);
+    runAction(indices[i]);
   }
+  batchActive = false;
+  tx_raw(batchTx, "]}");
+
+  tx_flush_line(batchTx, Serial, false);   // Too large: one error line instead
 }
 
 // ===================== COMMAND HANDLERS =====================
 
 void handleGetInfo() {
-  doc.clear();
-  doc["status"] = "ok";
-  doc["device"] = "ESP32-S3-FlightController";
-  doc["firmware"] = "1.0.0";
-  doc["chip"] = "ESP32-S3";
-  doc["uptime_ms"] = millis() - startTime;
-  doc["uptime_s"] = (millis() - startTime) / 1000;
-  doc["cpu_freq_mhz"] = ESP.getCpuFreqMHz();
-  doc["flash_size_mb"] = ESP.getFlashChipSize() / (1024 * 1024);
-  doc["free_heap_kb"] = ESP.getFreeHeap() / 1024;
-  doc["armed"] = armed;
-
-  serializeJson(doc, Serial);
-  Serial.println();
+  reply.clear();
+  reply["status"] = "ok";
+  reply["device"] = "ESP32-S3-FlightController";
+  reply["firmware"] = "1.0.0";
+  reply["chip"] = "ESP32-S3";
+  reply["uptime_ms"] = millis() - startTime;
+  reply["uptime_s"] = (millis() - startTime) / 1000;
+  reply["cpu_freq_mhz"] = ESP.getCpuFreqMHz();
+  reply["flash_size_mb"] = ESP.getFlashChipSize() / (1024 * 1024);
+  reply["free_heap_kb"] = ESP.getFreeHeap() / 1024;
+  reply["armed"] = armed.load();
+  reply["estop"] = safety_is_stopped();
+  reply["binary"] = binaryEnabled;
+  reply["tx_dropped"] = txBuffer.dropped;
+  reply["perf_overruns"] = perf_total_overruns(perfSections, PERF_COUNT);
+  reply["esc_mode"] = esc_mode_name(escMode);
+  reply["control"] = controlMode == CONTROL_SETPOINT ? "setpoint" : "raw";
+  reply["imu"] = imuPresent ? "mpu6050" : "simulated";
+  reply["barometer"] = baroPresent ? "bmp280" : "simulated";
+
+  sendReply();
 }
 
-void handleArm(bool arm) {
-  armed = arm;
+void handleArmAction() {
+  handleArm(true);
+}
 
-  if (!armed) {
-    // Disarm - stop all motors
-    for (int i = 0; i < 4; i++) {
-      motorValues[i] = 0;
-      ledcWrite(i, 0);
-    }
-  }
+void handleDisarmAction() {
+  handleArm(false);
+}
 
-  doc.clear();
-  doc["status"] = "ok";
-  doc["msg"] = armed ? "Armed" : "Disarmed";
-  doc["armed"] = armed;
+void handleArm(bool arm) {
+  setArmed(arm);
+
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = armed ? "Armed" : "Disarmed";
+  reply["armed"] = armed.load();
+  reply["max_pwm"] = safety_config().maxMotorPWM;
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
 
 void handleSetMotors() {
@@ -244,95 +535,200 @@ void handleSetMotors() {
   }
 
   // Set motor values
+  int throttle[4];
   for (int i = 0; i < 4; i++) {
-    int duty = constrain(motors[i].as<int>(), 0, 255);
-    motorValues[i] = duty;
-    ledcWrite(i, duty);
+    throttle[i] = dutyToThrottle(motors[i].as<int>());
+  }
+  setMotorThrottle(throttle);
+  sendMotorsSet();
+}
+
+void handleSetThrottle() {
+  if (!armed) {
+    sendError("Flight controller not armed");
+    return;
   }
 
-  // Send response
-  doc.clear();
-  doc["status"] = "ok";
-  doc["msg"] = "Motors set";
-  JsonArray motorsArr = doc.createNestedArray("motors");
+  JsonArray values = doc["throttle"];
+  if (values.size() != 4) {
+    sendError("Throttle must be array of 4 values (0-2000)");
+    return;
+  }
+
+  int throttle[4];
   for (int i = 0; i < 4; i++) {
-    JsonObject motor = motorsArr.createNestedObject();
-    motor["motor"] = i + 1;
-    motor["duty"] = motorValues[i];
-    motor["throttle_pct"] = (motorValues[i] * 100) / 255;
+    throttle[i] = values[i].as<int>();
   }
+  setMotorThrottle(throttle);
+  sendMotorsSet();
+}
 
-  serializeJson(doc, Serial);
-  Serial.println();
+void handleSetSetpoint() {
+  if (!imuPresent) {
+    sendError("On-board control needs the IMU");
+    return;
+  }
+
+  FlightSetpoint sp;
+  sp.rollDeg = constrain(doc["roll"] | 0.0f, -PID_MAX_ANGLE_DEG, PID_MAX_ANGLE_DEG);
+  sp.pitchDeg = constrain(doc["pitch"] | 0.0f, -PID_MAX_ANGLE_DEG, PID_MAX_ANGLE_DEG);
+  sp.yawRateDps = constrain(doc["yaw_rate"] | 0.0f, -PID_MAX_RATE_DPS, PID_MAX_RATE_DPS);
+  sp.throttle = constrain(doc["throttle"] | 0.0f, 0.0f, 1.0f);
+
+  portENTER_CRITICAL(&sensorMux);
+  flightSetpoint = sp;
+  portEXIT_CRITICAL(&sensorMux);
+  controlMode = CONTROL_SETPOINT;
+
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = "Setpoint set";
+  reply["armed"] = armed.load();
+  JsonObject setpoint = reply.createNestedObject("setpoint");
+  setpoint["roll"] = sp.rollDeg;
+  setpoint["pitch"] = sp.pitchDeg;
+  setpoint["yaw_rate"] = sp.yawRateDps;
+  setpoint["throttle"] = sp.throttle;
+  reply["control_runs"] = controlRuns;
+
+  sendReply();
 }
 
-void handleGetMotors() {
-  doc.clear();
-  doc["status"] = "ok";
-  doc["armed"] = armed;
+void handleSetPid() {
+  const char* axisName = doc["axis"] | "";
+  int axis = strcmp(axisName, "roll") == 0 ? 0 :
+             strcmp(axisName, "pitch") == 0 ? 1 :
+             strcmp(axisName, "yaw") == 0 ? 2 : -1;
+  if (axis < 0 && !doc.containsKey("angle_kp")) {
+    sendError("axis must be roll, pitch or yaw (or give angle_kp)");
+    return;
+  }
 
-  JsonArray motors = doc.createNestedArray("motors");
-  for (int i = 0; i < 4; i++) {
-    JsonObject motor = motors.createNestedObject();
-    motor["motor"] = i + 1;
-    motor["duty"] = motorValues[i];
-    motor["frequency"] = PWM_FREQ;
-    motor["throttle_pct"] = (motorValues[i] * 100) / 255;
+  portENTER_CRITICAL(&sensorMux);
+  flightGains.angleKp = doc["angle_kp"] | flightGains.angleKp;
+  if (axis >= 0) {
+    PidGains& gains = flightGains.rate[axis];
+    gains.kp = doc["kp"] | gains.kp;
+    gains.ki = doc["ki"] | gains.ki;
+    gains.kd = doc["kd"] | gains.kd;
+    gains.iLimit = doc["i_limit"] | gains.iLimit;
+  }
+  FlightGains current = flightGains;
+  portEXIT_CRITICAL(&sensorMux);
+
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = "PID gains set";
+  reply["angle_kp"] = current.angleKp;
+  const char* names[PID_AXES] = {"roll", "pitch", "yaw"};
+  for (int i = 0; i < PID_AXES; i++) {
+    JsonObject g = reply.createNestedObject(names[i]);
+    g["kp"] = current.rate[i].kp;
+    g["ki"] = current.rate[i].ki;
+    g["kd"] = current.rate[i].kd;
+    g["i_limit"] = current.rate[i].iLimit;
   }
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
 
-void handleReadIMU() {
-  // Read from real IMU sensor here
-  // For now, return simulated/placeholder values
-  readIMUSensor();
+void sendMotorsSet() {
+  tx_begin(txBuffer);
+  tx_raw(txBuffer, "{\"status\":\"ok\",\"msg\":\"Motors set\",");
+  writeMotorsArray(txBuffer);
+  tx_raw(txBuffer, "}");
+  flushReply();
+}
 
-  doc.clear();
-  doc["status"] = "ok";
-  doc["sensor"] = "imu";
+/**
+ * `"motors":[{"motor":1,"duty":..,"throttle":..,"throttle_pct":..},...]`
+ */
+void writeMotorsArray(TxBuffer& tx) {
+  tx_raw(tx, "\"motors\":[");
+  for (int i = 0; i < 4; i++) {
+    tx_printf(tx, "%s{\"motor\":%d,\"duty\":%d,\"throttle\":%d,\"throttle_pct\":%d}",
+              i > 0 ? "," : "", i + 1, motorDuty(i), motorValues[i].load(),
+              (motorValues[i].load() * 100) / ESC_THROTTLE_MAX);
+  }
+  tx_raw(tx, "]");
+}
 
-  JsonObject data = doc.createNestedObject("data");
+void handleSetEscMode() {
+  const char* name = doc["mode"] | "";
+  EscMode mode;
+  if (!esc_mode_from_name(name, mode)) {
+    sendError("mode must be pwm50, pwm400, oneshot125 or dshot600");
+    return;
+  }
+  if (armed) {
+    sendError("Disarm before changing ESC mode");
+    return;
+  }
 
-  JsonObject accel = data.createNestedObject("accel");
-  accel["x"] = imuAccel[0];
-  accel["y"] = imuAccel[1];
-  accel["z"] = imuAccel[2];
+  // safetyTask switches between two output writes; wait for it
+  escModeRequest.store(mode);
+  unsigned long start = millis();
+  while (escModeRequest.load() >= 0 && millis() - start < 100) {
+    delay(1);
+  }
+  if (escModeRequest.load() >= 0 || !escModeOk.load()) {
+    sendError("ESC mode init failed");
+    return;
+  }
 
-  JsonObject gyro = data.createNestedObject("gyro");
-  gyro["x"] = imuGyro[0];
-  gyro["y"] = imuGyro[1];
-  gyro["z"] = imuGyro[2];
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = "ESC mode set";
+  reply["esc_mode"] = esc_mode_name(escMode);
+  reply["update_hz"] = esc_update_hz(escMode, 1000 / SAFETY_PERIOD_MS);
 
-  JsonObject orientation = data.createNestedObject("orientation");
-  orientation["roll"] = imuOrientation[0];
-  orientation["pitch"] = imuOrientation[1];
-  orientation["yaw"] = imuOrientation[2];
+  sendReply();
+}
 
-  doc["timestamp_ms"] = millis();
+void handleGetMotors() {
+  tx_begin(txBuffer);
+  tx_printf(txBuffer, "{\"status\":\"ok\",\"armed\":%s,", armed ? "true" : "false");
+  writeMotorsArray(txBuffer);
+  tx_printf(txBuffer, ",\"esc_mode\":\"%s\",\"update_hz\":%lu}",
+            esc_mode_name(escMode),
+            (unsigned long)esc_update_hz(escMode, 1000 / SAFETY_PERIOD_MS));
+  flushReply();
+}
 
-  serializeJson(doc, Serial);
-  Serial.println();
+void handleReadIMU() {
+  // Latest MPU6050 sample and Mahony attitude; simulated if no IMU detected
+  readIMUSensor();
+
+  tx_begin(txBuffer);
+  tx_printf(txBuffer,
+    "{\"status\":\"ok\",\"sensor\":\"imu\",\"data\":{"
+    "\"accel\":{\"x\":%.4f,\"y\":%.4f,\"z\":%.4f},"
+    "\"gyro\":{\"x\":%.4f,\"y\":%.4f,\"z\":%.4f},"
+    "\"orientation\":{\"roll\":%.3f,\"pitch\":%.3f,\"yaw\":%.3f}},"
+    "\"timestamp_ms\":%lu}",
+    imuAccel[0], imuAccel[1], imuAccel[2],
+    imuGyro[0], imuGyro[1], imuGyro[2],
+    imuOrientation[0], imuOrientation[1], imuOrientation[2],
+    millis());
+  flushReply();
 }
 
 void handleReadBarometer() {
-  // Read from real barometer sensor here
+  // Latest BMP280 reading; simulated if no barometer detected
   readBaroSensor();
 
-  doc.clear();
-  doc["status"] = "ok";
-  doc["sensor"] = "barometer";
+  reply.clear();
+  reply["status"] = "ok";
+  reply["sensor"] = "barometer";
 
-  JsonObject data = doc.createNestedObject("data");
+  JsonObject data = reply.createNestedObject("data");
   data["pressure_hpa"] = baroPressure;
   data["temperature_c"] = baroTemperature;
   data["altitude_m"] = baroAltitude;
 
-  doc["timestamp_ms"] = millis();
+  reply["timestamp_ms"] = millis();
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
 
 void handleSetGPIO() {
@@ -352,14 +748,13 @@ void handleSetGPIO() {
   pinMode(pin, OUTPUT);
   digitalWrite(pin, state);
 
-  doc.clear();
-  doc["status"] = "ok";
-  doc["msg"] = "GPIO set";
-  doc["pin"] = pin;
-  doc["state"] = state;
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = "GPIO set";
+  reply["pin"] = pin;
+  reply["state"] = state;
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
 
 void handleReadGPIO() {
@@ -372,13 +767,12 @@ void handleReadGPIO() {
 
   int state = digitalRead(pin);
 
-  doc.clear();
-  doc["status"] = "ok";
-  doc["pin"] = pin;
-  doc["state"] = state;
+  reply.clear();
+  reply["status"] = "ok";
+  reply["pin"] = pin;
+  reply["state"] = state;
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
 
 void handleReadADC() {
@@ -392,14 +786,13 @@ void handleReadADC() {
   int value = analogRead(pin);
   float voltage = value * (3.3 / 4095.0);
 
-  doc.clear();
-  doc["status"] = "ok";
-  doc["pin"] = pin;
-  doc["value"] = value;
-  doc["voltage"] = voltage;
+  reply.clear();
+  reply["status"] = "ok";
+  reply["pin"] = pin;
+  reply["value"] = value;
+  reply["voltage"] = voltage;
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
 
 void handleSetPWM() {
@@ -423,15 +816,14 @@ void handleSetPWM() {
   ledcAttachPin(pin, channel);
   ledcWrite(channel, dutyCycle);
 
-  doc.clear();
-  doc["status"] = "ok";
-  doc["msg"] = "PWM set";
-  doc["pin"] = pin;
-  doc["duty_cycle"] = dutyCycle;
-  doc["frequency"] = frequency;
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = "PWM set";
+  reply["pin"] = pin;
+  reply["duty_cycle"] = dutyCycle;
+  reply["frequency"] = frequency;
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
 
 void handleReadSensors() {
@@ -439,10 +831,10 @@ void handleReadSensors() {
   readIMUSensor();
   readBaroSensor();
 
-  doc.clear();
-  doc["status"] = "ok";
+  reply.clear();
+  reply["status"] = "ok";
 
-  JsonObject sensors = doc.createNestedObject("sensors");
+  JsonObject sensors = reply.createNestedObject("sensors");
 
   // IMU data
   JsonObject imu = sensors.createNestedObject("imu");
@@ -466,8 +858,9 @@ void handleReadSensors() {
   for (int i = 0; i < 4; i++) {
     JsonObject motor = motors.createNestedObject();
     motor["motor"] = i + 1;
-    motor["duty"] = motorValues[i];
-    motor["throttle_pct"] = (motorValues[i] * 100) / 255;
+    motor["duty"] = motorDuty(i);
+    motor["throttle"] = motorValues[i].load();
+    motor["throttle_pct"] = (motorValues[i].load() * 100) / ESC_THROTTLE_MAX;
   }
 
   // System info
@@ -475,10 +868,9 @@ void handleReadSensors() {
   sys["uptime_s"] = (millis() - startTime) / 1000;
   sys["free_heap_kb"] = ESP.getFreeHeap() / 1024;
   sys["cpu_temp_c"] = temperatureRead();  // ESP32-S3 internal temp
-  sys["armed"] = armed;
+  sys["armed"] = armed.load();
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
 
 void handleSetAltitude() {
@@ -497,31 +889,711 @@ void handleSetAltitude() {
   float seaLevelPressure = 1013.25;
   baroPressure = seaLevelPressure * pow(1.0 - (altitude / 44330.0), 5.255);
 
-  doc.clear();
-  doc["status"] = "ok";
-  doc["msg"] = "Altitude updated";
-  doc["altitude_m"] = baroAltitude;
-  doc["pressure_hpa"] = baroPressure;
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = "Altitude updated";
+  reply["altitude_m"] = baroAltitude;
+  reply["pressure_hpa"] = baroPressure;
+
+  sendReply();
+}
+
+void handleStreamSensors() {
+  int rateHz = doc["rate_hz"] | 0;
+
+  if (rateHz != 0 && (rateHz < STREAM_MIN_HZ || rateHz > STREAM_MAX_HZ)) {
+    sendError("rate_hz must be 0 (stop) or 100-1000");
+    return;
+  }
+
+  startSensorStream(rateHz, false);
+
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = rateHz > 0 ? "Streaming sensors" : "Sensor stream stopped";
+  reply["rate_hz"] = rateHz;
+
+  sendReply();
+}
+
+void handleSetBinary() {
+  binaryEnabled = doc["enabled"] | false;
+  lineReader.binaryFrames = binaryEnabled;
+
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = binaryEnabled ? "Binary frames enabled" : "Binary frames disabled";
+  reply["binary"] = binaryEnabled;
+
+  sendReply();
+}
+
+void handleGetSafety() {
+  SafetyConfig config = safety_config();
+  uint32_t periodMaxUs = safetyTiming.periodMaxUs.load(std::memory_order_relaxed);
+  uint32_t execMaxUs = safetyTiming.execMaxUs.load(std::memory_order_relaxed);
+
+  reply.clear();
+  reply["status"] = "ok";
+  reply["estop"] = safety_is_stopped();
+  reply["armed"] = armed.load();
+  reply["violations"] = safetyState.violations.load(std::memory_order_relaxed);
+  reply["trips"] = safetyTiming.trips.load(std::memory_order_relaxed);
+  reply["max_pwm"] = config.maxMotorPWM;
+  reply["current_max_pwm"] = safetyState.currentMaxPWM.load(std::memory_order_relaxed);
+  reply["host_timeout_ms"] = config.hostTimeoutMs;
+  reply["since_host_ms"] = millis() - safetyState.lastHostCommandTime.load(std::memory_order_relaxed);
+  reply["max_continuous_ms"] = config.maxContinuousMs;
+  reply["rate_hz"] = 1000 / SAFETY_PERIOD_MS;
+  reply["runs"] = safetyTiming.runs.load(std::memory_order_relaxed);
+  reply["period_max_us"] = periodMaxUs;
+  reply["exec_max_us"] = execMaxUs;
+  // A condition that appears just after a check is acted on by the next one
+  reply["reaction_max_us"] = periodMaxUs + execMaxUs;
+  // Lowest free stack seen, in bytes (ESP-IDF counts stack in bytes)
+  reply["stack_free_min"] = safetyTaskHandle ? uxTaskGetStackHighWaterMark(safetyTaskHandle) : 0;
+  JsonArray outputs = reply.createNestedArray("outputs");
+  for (int i = 0; i < 4; i++) {
+    outputs.add(motorOutputs[i]);
+  }
+
+  sendReply();
+}
+
+/**
+ * {"action":"get_perf","commands":bool,"reset":bool}: per-section timing
+ * as [n,min,mean,p50,p99,max,overruns] (us), optionally per-action
+ * handler times as [n,mean,max]; "reset" starts a new measurement.
+ * Written directly, like the telemetry replies.
+ */
+void handleGetPerf() {
+  bool commands = doc["commands"] | false;
+
+  tx_begin(txBuffer);
+  tx_printf(txBuffer, "{\"status\":\"ok\",\"cpu_mhz\":%lu,\"sections\":{",
+            (unsigned long)perfCpuMhz);
+  tx_commit(txBuffer, perf_format(txBuffer.data + txBuffer.len, tx_available(txBuffer),
+                                  perfSections, PERF_COUNT));
+  tx_raw(txBuffer, "}");
+  if (commands) {
+    tx_raw(txBuffer, ",\"commands\":{");
+    int n = command_format_stats(txBuffer.data + txBuffer.len, tx_available(txBuffer),
+                                 COMMANDS, commandStats, COMMAND_COUNT);
+    if (n > 0) {   // Nothing has run yet on the first call after a reset
+      tx_commit(txBuffer, n);
+    }
+    tx_raw(txBuffer, "}");
+  }
+  tx_raw(txBuffer, "}");
+  flushReply();
+
+  if (doc["reset"] | false) {
+    perf_reset(perfSections, PERF_COUNT);
+    memset(commandStats, 0, sizeof(commandStats));
+  }
+}
+
+void handleGetPower() {
+  sendPowerStatus();
+}
+
+/**
+ * {"action":"set_power","enabled":bool,"idle_timeout_ms":N,"idle_cpu_mhz":80|160}:
+ * configure the idle state. Omitted fields keep their value.
+ */
+void handleSetPower() {
+  power_configure(doc["enabled"] | power.enabled,
+                  doc["idle_timeout_ms"] | power.idleTimeoutMs,
+                  doc["idle_cpu_mhz"] | power.idleCpuMhz);
+  sendPowerStatus();
+}
+
+void sendPowerStatus() {
+  tx_begin(txBuffer);
+  tx_raw(txBuffer, "{\"status\":\"ok\",");
+  tx_commit(txBuffer, power_format(txBuffer.data + txBuffer.len, tx_available(txBuffer)));
+  tx_raw(txBuffer, "}");
+  flushReply();
+}
+
+void handleGetRecorder() {
+  sendRecorderStatus();
+}
+
+/**
+ * {"action":"set_recorder","enabled":bool,"clear":bool}: start/stop
+ * recording and/or drop everything recorded so far (stops a download).
+ */
+void handleSetRecorder() {
+  if (doc["clear"] | false) {
+    dumpActive = false;
+    recorder_clear();
+  }
+  if (doc.containsKey("enabled")) {
+    recorder_set_enabled(doc["enabled"] | false);
+  }
+  sendRecorderStatus();
+}
+
+/**
+ * {"action":"dump_recorder","from":N,"count":N}: reply with the range,
+ * then stream it as BIN_OP_RECORD_CHUNK frames from loop(); a chunk with
+ * count 0 ends the download. Defaults to everything still recorded.
+ * Records overwritten before their chunk goes out are skipped (a gap in
+ * `first`); re-request a range to fill in records lost on the link.
+ */
+void handleDumpRecorder() {
+  if (!binaryEnabled) {
+    sendError("dump_recorder needs binary frames (set_binary)");
+    return;
+  }
+
+  uint32_t head = recorder_head();
+  uint32_t from = max((uint32_t)(doc["from"] | 0), recorder_oldest(head));
+  uint32_t count = doc["count"] | (head - min(from, head));
+  dumpNext = min(from, head);
+  dumpEnd = dumpNext + min(count, head - dumpNext);
+  dumpChunk = 0;
+  dumpActive = true;
+
+  reply.clear();
+  reply["status"] = "ok";
+  reply["from"] = dumpNext;
+  reply["to"] = dumpEnd;
+  reply["records"] = dumpEnd - dumpNext;
+  reply["record_size"] = sizeof(RecordEntry);
+  reply["chunk_records"] = BIN_RECORD_CHUNK_MAX;
+
+  sendReply();
+}
+
+void sendRecorderStatus() {
+  uint32_t head = recorder_head();
+  uint32_t oldest = recorder_oldest(head);
+
+  reply.clear();
+  reply["status"] = "ok";
+  reply["enabled"] = (bool)recorder.enabled;
+  reply["psram"] = recorder.psram;
+  reply["capacity"] = recorder.capacity;
+  reply["record_size"] = sizeof(RecordEntry);
+  reply["head"] = head;
+  reply["oldest"] = oldest;
+  reply["available"] = head - oldest;
+  reply["dumping"] = dumpActive;
+
+  sendReply();
+}
+
+// ===================== BINARY COMMAND PROCESSING =====================
+
+/**
+ * Decode (in place) and dispatch one COBS frame from the line reader.
+ */
+void processBinaryFrame(uint8_t* frame, size_t len) {
+  BinHeader header = {};
+  const uint8_t* payload;
+  size_t payloadLen;
+  BinErrorCode err;
+
+  size_t decoded = cobs_decode(frame, len, frame);
+  if (decoded == 0) {
+    sendBinaryError(0, BIN_ERR_FRAMING);
+    return;
+  }
+  if (!bin_parse_frame(frame, decoded, header, payload, payloadLen, err)) {
+    sendBinaryError(header.seq, err);
+    return;
+  }
+
+  int index = command_find_opcode(commandOpcodes, header.opcode);
+  if (index < 0) {
+    sendBinaryError(header.seq, BIN_ERR_OPCODE);
+    return;
+  }
+  hostHeartbeat();
+
+  PERF_SCOPE(perfSections[PERF_COMMAND]);
+  unsigned long start = micros();
+  execBinaryCommand(header, payload, payloadLen);
+  unsigned long elapsed = micros() - start;
+  command_record(commandStats[index], elapsed);
+
+  float values[2] = {(float)elapsed, (float)header.seq};
+  recorder_write_at(start, REC_COMMAND, RECORD_FLAG_BINARY, index, values, 2);
+}
+
+/**
+ * Execute one validated binary command and send its reply.
+ */
+void execBinaryCommand(const BinHeader& header, const uint8_t* payload, size_t payloadLen) {
+  switch (header.opcode) {
+    case BIN_OP_ARM: {
+      BinArm req;
+      if (payloadLen != sizeof(req)) break;
+      memcpy(&req, payload, sizeof(req));
+      setArmed(req.arm != 0);
+      sendBinaryMotors(header);
+      return;
+    }
+    case BIN_OP_SET_MOTORS: {
+      BinSetMotors req;
+      if (payloadLen != sizeof(req)) break;
+      if (!armed) {
+        sendBinaryError(header.seq, BIN_ERR_NOT_ARMED);
+        return;
+      }
+      memcpy(&req, payload, sizeof(req));
+      int throttle[4];
+      for (int i = 0; i < 4; i++) {
+        throttle[i] = dutyToThrottle(req.duty[i]);
+      }
+      setMotorThrottle(throttle);
+      sendBinaryMotors(header);
+      return;
+    }
+    case BIN_OP_SET_THROTTLE: {
+      BinSetThrottle req;
+      if (payloadLen != sizeof(req)) break;
+      if (!armed) {
+        sendBinaryError(header.seq, BIN_ERR_NOT_ARMED);
+        return;
+      }
+      memcpy(&req, payload, sizeof(req));
+      int throttle[4] = {req.throttle[0], req.throttle[1], req.throttle[2], req.throttle[3]};
+      setMotorThrottle(throttle);
+      BinThrottle reply;
+      for (int i = 0; i < 4; i++) {
+        reply.throttle[i] = motorValues[i].load();
+      }
+      reply.flags = statusFlags();
+      sendBinaryReply(header, &reply, sizeof(reply));
+      return;
+    }
+    case BIN_OP_GET_MOTORS:
+      sendBinaryMotors(header);
+      return;
+
+    case BIN_OP_READ_IMU: {
+      readIMUSensor();
+      BinImu imu;
+      imu.micros = micros();
+      memcpy(imu.accel, imuAccel, sizeof(imu.accel));
+      memcpy(imu.gyro, imuGyro, sizeof(imu.gyro));
+      memcpy(imu.orientation, imuOrientation, sizeof(imu.orientation));
+      sendBinaryReply(header, &imu, sizeof(imu));
+      return;
+    }
+    case BIN_OP_READ_SENSORS: {
+      readIMUSensor();
+      readBaroSensor();
+      BinSensors sensors;
+      fillBinarySensors(sensors, 0, micros());
+      sendBinaryReply(header, &sensors, sizeof(sensors));
+      return;
+    }
+    case BIN_OP_STREAM_SENSORS: {
+      BinStream req;
+      if (payloadLen != sizeof(req)) break;
+      memcpy(&req, payload, sizeof(req));
+      if (req.rateHz != 0 && (req.rateHz < STREAM_MIN_HZ || req.rateHz > STREAM_MAX_HZ)) {
+        sendBinaryError(header.seq, BIN_ERR_RANGE);
+        return;
+      }
+      startSensorStream(req.rateHz, true);
+      sendBinaryReply(header, &req, sizeof(req));
+      return;
+    }
+    default:
+      sendBinaryError(header.seq, BIN_ERR_OPCODE);
+      return;
+  }
+
+  // Known opcode with a payload of the wrong size
+  sendBinaryError(header.seq, BIN_ERR_LENGTH);
+}
+
+void fillBinarySensors(BinSensors& out, uint32_t sample, uint32_t sampleUs) {
+  out.sample = sample;
+  out.micros = sampleUs;
+  memcpy(out.accel, imuAccel, sizeof(out.accel));
+  memcpy(out.gyro, imuGyro, sizeof(out.gyro));
+  out.altitudeM = baroAltitude;
+  out.pressureHpa = baroPressure;
+  for (int i = 0; i < 4; i++) {
+    out.duty[i] = motorDuty(i);
+  }
+  out.flags = statusFlags();
+  out.dropped = min(streamDropped, (uint32_t)UINT16_MAX);
+}
+
+void sendBinaryMotors(const BinHeader& request) {
+  BinMotors reply;
+  for (int i = 0; i < 4; i++) {
+    reply.duty[i] = motorDuty(i);
+  }
+  reply.flags = statusFlags();
+  sendBinaryReply(request, &reply, sizeof(reply));
+}
+
+void sendBinaryReply(const BinHeader& request, const void* payload, size_t payloadLen) {
+  size_t n = bin_build_wire(wireBuffer, request.opcode | BIN_REPLY_FLAG, request.seq,
+                            payload, payloadLen);
+  PERF_SCOPE(perfSections[PERF_TX_WRITE]);
+  Serial.write(wireBuffer, n);
+}
+
+void sendBinaryError(uint16_t seq, BinErrorCode code) {
+  BinError error = {code};
+  size_t n = bin_build_wire(wireBuffer, BIN_OP_ERROR, seq, &error, sizeof(error));
+  Serial.write(wireBuffer, n);
+}
+
+// ===================== SENSOR STREAMING =====================
+
+/**
+ * (Re)start the sample clock at `rateHz`, or stop it with 0. `binary`
+ * selects BIN_OP_SENSOR_FRAME pushes instead of JSON lines.
+ */
+void startSensorStream(int rateHz, bool binary) {
+  esp_timer_stop(streamTimer);
+  streamRateHz = rateHz;
+  streamBinary = binary;
+  if (rateHz > 0) {
+    streamTicks = 0;
+    streamTicksHandled = 0;
+    streamDropped = 0;
+    esp_timer_start_periodic(streamTimer, 1000000ULL / rateHz);
+  }
+}
+
+/**
+ * esp_timer callback (esp_timer task): mark one more sample slot due.
+ * The frame itself is built and written from loop().
+ */
+void onStreamTimer(void* arg) {
+  streamTicks = streamTicks + 1;
+}
+
+/**
+ * Emit one sensor frame per elapsed sample slot. `seq` is the slot number,
+ * so gaps tell the host how many samples were skipped; running late or a
+ * full TX buffer skips to the newest slot instead of queueing backlog.
+ * Frames are formatted directly rather than through `doc`.
+ */
+void serviceSensorStream() {
+  uint32_t ticks = streamTicks;
+  if (streamRateHz == 0 || ticks == streamTicksHandled) {
+    return;
+  }
+  streamDropped += ticks - streamTicksHandled - 1;
+  streamTicksHandled = ticks;
+
+  unsigned long sampleUs = micros();
+  readIMUSensor();
+  readBaroSensor();
+
+  if (streamBinary) {
+    BinSensors frame;
+    fillBinarySensors(frame, ticks, sampleUs);
+    size_t n = bin_build_wire(wireBuffer, BIN_OP_SENSOR_FRAME, (uint16_t)ticks,
+                              &frame, sizeof(frame));
+    if (Serial.availableForWrite() < n) {
+      streamDropped++;
+      return;
+    }
+    Serial.write(wireBuffer, n);
+    return;
+  }
+
+  int duty[4] = {motorDuty(0), motorDuty(1), motorDuty(2), motorDuty(3)};
+
+  tx_begin(txBuffer);
+  tx_printf(txBuffer, "{\"stream\":%lu,\"us\":%lu,\"accel\":",
+            (unsigned long)ticks, sampleUs);
+  tx_array(txBuffer, imuAccel, 3, "%.3f");
+  tx_raw(txBuffer, ",\"gyro\":");
+  tx_array(txBuffer, imuGyro, 3, "%.3f");
+  tx_printf(txBuffer, ",\"alt\":%.2f,\"pressure\":%.2f,\"motors\":",
+            baroAltitude, baroPressure);
+  tx_array(txBuffer, duty, 4, "%d");
+  tx_printf(txBuffer, ",\"dropped\":%lu}", (unsigned long)streamDropped);
+
+  if (!tx_flush_line(txBuffer, Serial, true)) {
+    streamDropped++;
+  }
+}
+
+// ===================== RECORDER DOWNLOAD =====================
+
+/**
+ * Send up to RECORDER_DUMP_BURST chunk frames of the running download,
+ * only while the serial TX buffer has room, so commands keep flowing.
+ */
+void serviceRecorderDump() {
+  for (int burst = 0; dumpActive && burst < RECORDER_DUMP_BURST; burst++) {
+    if ((size_t)Serial.availableForWrite() < BIN_WIRE_MAX) {
+      return;
+    }
+
+    RecordEntry records[BIN_RECORD_CHUNK_MAX];
+    uint32_t first = dumpEnd;
+    int count = 0;
+    if (dumpNext < dumpEnd) {
+      count = recorder_read(dumpNext, records,
+                            min((uint32_t)BIN_RECORD_CHUNK_MAX, dumpEnd - dumpNext), first);
+      // The ring may have moved past the range while it was being sent
+      count = first < dumpEnd ? min((uint32_t)count, dumpEnd - first) : 0;
+    }
 
-  serializeJson(doc, Serial);
-  Serial.println();
+    uint8_t payload[sizeof(BinRecordChunk) + sizeof(records)];
+    BinRecordChunk chunk = {count > 0 ? first : dumpEnd, (uint8_t)count, sizeof(RecordEntry)};
+    memcpy(payload, &chunk, sizeof(chunk));
+    memcpy(payload + sizeof(chunk), records, count * sizeof(RecordEntry));
+    size_t n = bin_build_wire(wireBuffer, BIN_OP_RECORD_CHUNK, dumpChunk++,
+                              payload, sizeof(chunk) + count * sizeof(RecordEntry));
+    Serial.write(wireBuffer, n);
+
+    if (count == 0) {
+      dumpActive = false;
+    } else {
+      dumpNext = first + count;
+    }
+  }
 }
 
 // ===================== SENSOR FUNCTIONS =====================
 
 void initSensors() {
-  // Initialize IMU (MPU6050, ICM20948, etc.)
-  // TODO: Add your specific sensor initialization here
+  // Probe and configure; sensorTask owns the I2C bus from here on
+  imuPresent = imu_init(Wire);
+  baroPresent = baro_init(Wire);
+  mahony_reset(attitudeFilter);
+
+  if (imuPresent || baroPresent) {
+    TaskHandle_t task = nullptr;
+    xTaskCreatePinnedToCore(sensorTask, "sensors", 4096, nullptr,
+                            SENSOR_TASK_PRIORITY, &task, SENSOR_CORE);
+    if (imuPresent) {
+      imu_attach_interrupt(IMU_INT_PIN, task);
+    }
+  }
+
+  Serial.printf("{\"status\":\"ok\",\"msg\":\"Sensors initialized\","
+                "\"imu\":%s,\"barometer\":%s}\n",
+                imuPresent ? "true" : "false", baroPresent ? "true" : "false");
+}
+
+/**
+ * Sensor task (core 0). Woken by the IMU data-ready interrupt, drains the
+ * FIFO and runs one Mahony step per sample at the sensor's fixed 1 kHz
+ * rate; reads the barometer every BARO_PERIOD_MS. Only this task touches
+ * the I2C bus after setup().
+ */
+void sensorTask(void* param) {
+  const float dt = 1.0f / IMU_SAMPLE_HZ;
+  ImuSample samples[IMU_BURST_SAMPLES * 2];
+  unsigned long lastBaro = 0;
+
+  for (;;) {
+    if (imuPresent) {
+      // Timeout only covers a missed interrupt edge
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5));
+      PERF_SCOPE(perfSections[PERF_SENSOR]);
+      int count = imu_read_fifo(samples, IMU_BURST_SAMPLES * 2);
+      uint32_t readUs = micros();
+      for (int i = 0; i < count; i++) {
+        const ImuSample& s = samples[i];
+        mahony_update(attitudeFilter,
+                      s.gyro[0] * DEG_TO_RAD, s.gyro[1] * DEG_TO_RAD, s.gyro[2] * DEG_TO_RAD,
+                      s.accel[0], s.accel[1], s.accel[2], 9.80665f, dt);
+
+        // FIFO samples are 1 / IMU_SAMPLE_HZ apart, the last one just read
+        float values[6] = {s.accel[0], s.accel[1], s.accel[2], s.gyro[0], s.gyro[1], s.gyro[2]};
+        recorder_write_at(readUs - (count - 1 - i) * (1000000 / IMU_SAMPLE_HZ),
+                          REC_IMU, 0, 0, values, 6);
+      }
+      if (count > 0) {
+        float roll, pitch, yaw;
+        mahony_euler(attitudeFilter, roll, pitch, yaw);
+        portENTER_CRITICAL(&sensorMux);
+        imuLatest = samples[count - 1];
+        attitudeDeg[0] = roll;
+        attitudeDeg[1] = pitch;
+        attitudeDeg[2] = yaw;
+        FlightSetpoint sp = flightSetpoint;
+        FlightGains gains = flightGains;
+        portEXIT_CRITICAL(&sensorMux);
+
+        runFlightControl(sp, gains, attitudeDeg, samples[count - 1].gyro, count * dt);
+
+        float values[6] = {roll, pitch, yaw, flightState.rateSetpoint[0],
+                           flightState.rateSetpoint[1], flightState.rateSetpoint[2]};
+        recorder_write_at(readUs, REC_ATTITUDE, controlMode, 0, values, 6);
+      }
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(BARO_PERIOD_MS));
+    }
+
+    if (baroPresent && millis() - lastBaro >= BARO_PERIOD_MS) {
+      lastBaro = millis();
+      BaroReading reading;
+      if (baro_read_sample(reading)) {
+        portENTER_CRITICAL(&sensorMux);
+        baroLatest = reading;
+        portEXIT_CRITICAL(&sensorMux);
+      }
+    }
+  }
+}
+
+/**
+ * One step of the on-board cascade (sensor task, once per IMU batch).
+ * Only drives the motors in CONTROL_SETPOINT mode while armed.
+ */
+void runFlightControl(const FlightSetpoint& sp, const FlightGains& gains,
+                      const float attitude[3], const float gyro[3], float dt) {
+  if (controlMode != CONTROL_SETPOINT || !armed) {
+    flight_control_reset(flightState);
+    return;
+  }
+  PERF_SCOPE(perfSections[PERF_CONTROL]);
+
+  float mix[4];
+  flight_control_update(gains, flightState, sp, attitude, gyro, dt, mix);
+
+  int throttle[4];
+  for (int i = 0; i < 4; i++) {
+    throttle[i] = (int)(mix[i] * ESC_THROTTLE_MAX + 0.5f);
+  }
+  if (controlMode == CONTROL_SETPOINT) {
+    writeMotorThrottle(throttle);
+  }
+  controlRuns++;
+}
+
+// ===================== SAFETY =====================
+
+void initSafety() {
+  safety_init();
+
+  xTaskCreatePinnedToCore(safetyTask, "safety", SAFETY_STACK_BYTES, nullptr,
+                          SAFETY_TASK_PRIORITY, &safetyTaskHandle, SAFETY_CORE);
+}
+
+/**
+ * Safety task (core 0). Runs safety_check() every SAFETY_PERIOD_MS and is
+ * the only writer of the motor PWM channels: each run re-clamps the
+ * commanded duties, so a stalled or flooded command loop cannot hold the
+ * motors on past the host timeout. An e-stop disarms; re-arming clears it.
+ */
+void safetyTask(void* param) {
+  const TickType_t period = max((TickType_t)1, (TickType_t)pdMS_TO_TICKS(SAFETY_PERIOD_MS));
+  TickType_t lastWake = xTaskGetTickCount();
+  int64_t lastRunUs = esp_timer_get_time();
+
+  for (;;) {
+    vTaskDelayUntil(&lastWake, period);
+    PERF_SCOPE(perfSections[PERF_SAFETY]);
+    int64_t startUs = esp_timer_get_time();
+
+    uint16_t throttle[4];
+    bool running = false;
+    bool wasStopped = safety_is_stopped();
+    bool safe = safety_check();
+    if (!safe) {
+      armed = false;
+      for (int i = 0; i < 4; i++) {
+        motorValues[i] = 0;
+      }
+      clearSetpoint();
+    }
+    for (int i = 0; i < 4; i++) {
+      throttle[i] = armed ? clampThrottle(motorValues[i]) : 0;
+      running = running || throttle[i] > 0;
+    }
+    bool wasRunning = safetyState.motorRunning.load(std::memory_order_relaxed);
+    if (running && !wasRunning) {
+      safety_motor_started();
+    } else if (!running && wasRunning) {
+      safety_motor_stopped();
+    }
+
+    // Protocol switches happen here so no write can race the re-init
+    int request = escModeRequest.load();
+    if (request >= 0) {
+      esc_deinit();
+      bool ok = esc_init((EscMode)request, MOTOR_PINS);
+      if (!ok) {
+        esc_init(ESC_MODE_LEDC, MOTOR_PINS);
+      }
+      escModeOk.store(ok);
+      escModeRequest.store(-1);
+    }
+
+    esc_write(throttle);
+    for (int i = 0; i < 4; i++) {
+      motorOutputs[i] = throttle[i];
+    }
+
+    // Outputs every run while a motor turns, plus the run that stops them
+    if (running || wasRunning) {
+      float values[4] = {(float)throttle[0], (float)throttle[1],
+                         (float)throttle[2], (float)throttle[3]};
+      recorder_write_at((uint32_t)startUs, REC_MOTORS, statusFlags(),
+                        safetyState.currentMaxPWM.load(std::memory_order_relaxed), values, 4);
+    }
+    // One record per e-stop latch, not per run it stays latched, so a
+    // lost host link cannot flood the ring
+    if (!safe && !wasStopped) {
+      float values[1] = {(float)safetyState.violations.load(std::memory_order_relaxed)};
+      recorder_write_at((uint32_t)startUs, REC_SAFETY, statusFlags(), 1, values, 1);
+    }
 
-  // Initialize Barometer (BMP280, BME280, etc.)
-  // TODO: Add your specific sensor initialization here
+    int64_t endUs = esp_timer_get_time();
+    uint32_t periodUs = (uint32_t)(startUs - lastRunUs);
+    uint32_t execUs = (uint32_t)(endUs - startUs);
+    lastRunUs = startUs;
 
-  Serial.println("{\"status\":\"ok\",\"msg\":\"Sensors initialized\"}");
+    uint32_t runs = safetyTiming.runs.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (!safe && !wasStopped) {
+      safetyTiming.trips.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (runs > 1 && periodUs > safetyTiming.periodMaxUs.load(std::memory_order_relaxed)) {
+      safetyTiming.periodMaxUs.store(periodUs, std::memory_order_relaxed);
+    }
+    if (execUs > safetyTiming.execMaxUs.load(std::memory_order_relaxed)) {
+      safetyTiming.execMaxUs.store(execUs, std::memory_order_relaxed);
+    }
+  }
+}
+
+/**
+ * Any valid command from the host refreshes the heartbeat.
+ */
+void hostHeartbeat() {
+  safety_host_heartbeat();
+}
+
+uint8_t statusFlags() {
+  uint8_t flags = armed ? BIN_FLAG_ARMED : 0;
+  if (safety_is_stopped()) {
+    flags |= BIN_FLAG_ESTOP;
+  }
+  return flags;
 }
 
 void readIMUSensor() {
-  // TODO: Read from real IMU sensor
-  // For now, add slight noise to simulate sensor
+  if (imuPresent) {
+    portENTER_CRITICAL(&sensorMux);
+    memcpy(imuAccel, imuLatest.accel, sizeof(imuAccel));
+    memcpy(imuGyro, imuLatest.gyro, sizeof(imuGyro));
+    memcpy(imuOrientation, attitudeDeg, sizeof(imuOrientation));
+    portEXIT_CRITICAL(&sensorMux);
+    return;
+  }
+
+  // No IMU: add slight noise to simulate sensor
 
   imuAccel[0] += (random(-100, 100) / 1000.0);
   imuAccel[1] += (random(-100, 100) / 1000.0);
@@ -539,8 +1611,16 @@ void readIMUSensor() {
 }
 
 void readBaroSensor() {
-  // TODO: Read from real barometer sensor
-  // For now, add slight noise
+  if (baroPresent) {
+    portENTER_CRITICAL(&sensorMux);
+    baroPressure = baroLatest.pressureHpa;
+    baroTemperature = baroLatest.temperatureC;
+    baroAltitude = baroLatest.altitudeM;
+    portEXIT_CRITICAL(&sensorMux);
+    return;
+  }
+
+  // No barometer: add slight noise
 
   baroPressure += (random(-50, 50) / 100.0);
   baroTemperature += (random(-20, 20) / 100.0);
@@ -552,20 +1632,122 @@ void readBaroSensor() {
 
 // ===================== UTILITY FUNCTIONS =====================
 
+/**
+ * Arm or disarm; both zero the motor commands. Arming clears a latched
+ * e-stop (the operator acknowledges it). safetyTask applies the outputs.
+ * A disarm clears `armed` before zeroing, so a writer that passed its
+ * `armed` check sees the disarm when it re-checks.
+ */
+void setArmed(bool arm) {
+  if (!arm) {
+    armed = false;
+  }
+  clearSetpoint();
+  for (int i = 0; i < 4; i++) {
+    motorValues[i] = 0;
+  }
+  if (arm && safety_is_stopped()) {
+    safety_reset();
+  }
+  armed = arm;
+}
+
+/**
+ * Leave setpoint mode and forget the last setpoint. Arming, disarming and
+ * e-stop trips call this, so the on-board loop only flies again after the
+ * host sends a fresh set_setpoint.
+ */
+void clearSetpoint() {
+  controlMode = CONTROL_RAW;
+  portENTER_CRITICAL(&sensorMux);
+  flightSetpoint = {0.0f, 0.0f, 0.0f, 0.0f};
+  portEXIT_CRITICAL(&sensorMux);
+}
+
+/**
+ * Raw motor command from the host: leaves setpoint mode, then writes the
+ * throttles. Caller checks `armed`.
+ */
+void setMotorThrottle(const int throttle[4]) {
+  controlMode = CONTROL_RAW;
+  writeMotorThrottle(throttle);
+}
+
+/**
+ * Command four motor throttles (0-ESC_THROTTLE_MAX), clamped by the
+ * safety layer. safetyTask writes the ESC outputs within SAFETY_PERIOD_MS.
+ * Callers check `armed` first; a disarm landing in between is caught by
+ * the re-check after the stores, so no command outlives it.
+ */
+void writeMotorThrottle(const int throttle[4]) {
+  for (int i = 0; i < 4; i++) {
+    motorValues[i] = clampThrottle(throttle[i]);
+  }
+  if (!armed) {
+    for (int i = 0; i < 4; i++) {
+      motorValues[i] = 0;
+    }
+  }
+}
+
+/**
+ * Safety clamp in throttle units. The safety layer's ceiling is on the
+ * 0-255 duty scale, so it is scaled up rather than losing resolution.
+ */
+int clampThrottle(int throttle) {
+  int ceiling = dutyToThrottle(safety_clamp_motors(255));
+  return constrain(throttle, 0, ceiling);
+}
+
+int dutyToThrottle(int duty) {
+  return (constrain(duty, 0, 255) * ESC_THROTTLE_MAX + 127) / 255;
+}
+
+int motorDuty(int motor) {
+  return (motorValues[motor].load() * 255 + ESC_THROTTLE_MAX / 2) / ESC_THROTTLE_MAX;
+}
+
+/**
+ * Send the reply in txBuffer, or append it to the batch reply when a
+ * batch entry is running.
+ */
+void flushReply() {
+  if (!batchActive) {
+    PERF_SCOPE(perfSections[PERF_TX_WRITE]);
+    tx_flush_line(txBuffer, Serial, false);
+    return;
+  }
+  if (batchTx.len > 0 && batchTx.data[batchTx.len - 1] != '[') {
+    tx_raw(batchTx, ",");
+  }
+  if (txBuffer.overflow) {
+    batchTx.overflow = true;
+    return;
+  }
+  tx_printf(batchTx, "%.*s", (int)txBuffer.len, txBuffer.data);
+}
+
+/**
+ * Serialize `reply` into txBuffer and send it as one line, one write.
+ */
+void sendReply() {
+  tx_begin(txBuffer);
+  tx_commit(txBuffer, serializeJson(reply, txBuffer.data, tx_available(txBuffer)));
+  flushReply();
+}
+
 void sendError(const char* message) {
-  doc.clear();
-  doc["status"] = "error";
-  doc["msg"] = message;
+  reply.clear();
+  reply["status"] = "error";
+  reply["msg"] = message;
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
 
 void sendOk(const char* message) {
-  doc.clear();
-  doc["status"] = "ok";
-  doc["msg"] = message;
+  reply.clear();
+  reply["status"] = "ok";
+  reply["msg"] = message;
 
-  serializeJson(doc, Serial);
-  Serial.println();
+  sendReply();
 }
@@ -0,0 +1,157 @@
+/**
+ * Cascaded Attitude / Rate PID and Quad-X Mixer for ESP32 Flight Controller
+ *
+ * Outer loop: roll/pitch angle error -> rate setpoint (P only).
+ * Inner loop: body-rate PID on roll, pitch and yaw -> normalized torques,
+ * mixed with collective throttle into four motor commands (0.0-1.0).
+ * Runs once per IMU batch in the sensor task, so its rate follows the
+ * sensor's 1 kHz clock rather than the command link.
+ *
+ * Motor layout (viewed from above, nose up):
+ *
+ *   M1 front-left (CW)    M2 front-right (CCW)
+ *   M4 rear-left (CCW)    M3 rear-right (CW)
+ *
+ * Sign conventions match mahony_filter.h: +roll = right side down,
+ * +pitch = nose up, +yaw = nose right. Verify on a test stand; mirror the
+ * IMU axes rather than the gains if a direction is wrong.
+ *
+ * Features:
+ * - Derivative on measurement (no kick on setpoint steps)
+ * - Integral clamp and reset below idle throttle (no windup on the ground)
+ * - Mixer output clamped to 0-1 per motor
+ */
+
+#ifndef FLIGHT_PID_H
+#define FLIGHT_PID_H
+
+#include <Arduino.h>
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define PID_AXES             3      // roll, pitch, yaw
+#define PID_IDLE_THROTTLE    0.05f  // Below this the loop is bypassed and reset
+#define PID_MAX_ANGLE_DEG    45.0f
+#define PID_MAX_RATE_DPS     360.0f
+
+struct PidGains {
+  float kp;
+  float ki;
+  float kd;
+  float iLimit;      // |integral term| limit, in output units
+};
+
+struct PidState {
+  float integral;
+  float lastMeasurement;
+  bool primed;       // lastMeasurement valid (D term)
+};
+
+struct FlightGains {
+  float angleKp;             // deg/s of rate setpoint per deg of angle error
+  PidGains rate[PID_AXES];   // deg/s error -> normalized torque
+};
+
+struct FlightSetpoint {
+  float rollDeg;
+  float pitchDeg;
+  float yawRateDps;
+  float throttle;    // Collective, 0.0-1.0
+};
+
+struct FlightControlState {
+  PidState rate[PID_AXES];
+  float rateSetpoint[PID_AXES];   // Last outer-loop output, deg/s
+};
+
+static const FlightGains FLIGHT_DEFAULT_GAINS = {
+  4.0f,
+  {
+    {0.0020f, 0.0015f, 0.00005f, 0.2f},   // roll
+    {0.0020f, 0.0015f, 0.00005f, 0.2f},   // pitch
+    {0.0030f, 0.0010f, 0.0f,     0.2f},   // yaw
+  }
+};
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+inline void pid_reset(PidState& state) {
+  state.integral = 0.0f;
+  state.lastMeasurement = 0.0f;
+  state.primed = false;
+}
+
+/**
+ * One PID step. D acts on the measurement, so setpoint steps do not kick.
+ */
+inline float pid_update(const PidGains& gains, PidState& state,
+                        float setpoint, float measurement, float dt) {
+  float error = setpoint - measurement;
+
+  state.integral += gains.ki * error * dt;
+  state.integral = constrain(state.integral, -gains.iLimit, gains.iLimit);
+
+  float derivative = 0.0f;
+  if (state.primed && dt > 0.0f) {
+    derivative = -(measurement - state.lastMeasurement) / dt;
+  }
+  state.lastMeasurement = measurement;
+  state.primed = true;
+
+  return gains.kp * error + state.integral + gains.kd * derivative;
+}
+
+inline void flight_control_reset(FlightControlState& state) {
+  for (int axis = 0; axis < PID_AXES; axis++) {
+    pid_reset(state.rate[axis]);
+    state.rateSetpoint[axis] = 0.0f;
+  }
+}
+
+/**
+ * Quad-X mixer. Torques and throttle are normalized; outputs are 0-1.
+ */
+inline void flight_mix(float throttle, float roll, float pitch, float yaw, float out[4]) {
+  out[0] = throttle + roll + pitch - yaw;   // M1 front-left, CW
+  out[1] = throttle - roll + pitch + yaw;   // M2 front-right, CCW
+  out[2] = throttle - roll - pitch - yaw;   // M3 rear-right, CW
+  out[3] = throttle + roll - pitch + yaw;   // M4 rear-left, CCW
+  for (int i = 0; i < 4; i++) {
+    out[i] = constrain(out[i], 0.0f, 1.0f);
+  }
+}
+
+/**
+ * Run the cascade once. `attitudeDeg` is roll/pitch/yaw, `gyroDps` the
+ * body rates; writes four motor commands (0-1) to `out`.
+ */
+inline void flight_control_update(const FlightGains& gains, FlightControlState& state,
+                                  const FlightSetpoint& sp, const float attitudeDeg[3],
+                                  const float gyroDps[3], float dt, float out[4]) {
+  if (sp.throttle < PID_IDLE_THROTTLE) {
+    flight_control_reset(state);
+    for (int i = 0; i < 4; i++) {
+      out[i] = max(sp.throttle, 0.0f);
+    }
+    return;
+  }
+
+  state.rateSetpoint[0] = constrain(gains.angleKp * (sp.rollDeg - attitudeDeg[0]),
+                                    -PID_MAX_RATE_DPS, PID_MAX_RATE_DPS);
+  state.rateSetpoint[1] = constrain(gains.angleKp * (sp.pitchDeg - attitudeDeg[1]),
+                                    -PID_MAX_RATE_DPS, PID_MAX_RATE_DPS);
+  state.rateSetpoint[2] = sp.yawRateDps;
+
+  float torque[PID_AXES];
+  for (int axis = 0; axis < PID_AXES; axis++) {
+    torque[axis] = pid_update(gains.rate[axis], state.rate[axis],
+                              state.rateSetpoint[axis], gyroDps[axis], dt);
+  }
+  flight_mix(sp.throttle, torque[0], torque[1], torque[2], out);
+}
+
+#endif // FLIGHT_PID_H
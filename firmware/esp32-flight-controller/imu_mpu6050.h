@@ -0,0 +1,182 @@
+/**
+ * MPU6050 IMU Driver for ESP32 Flight Controller
+ *
+ * Runs the sensor at a fixed 1 kHz output rate into its on-chip FIFO and
+ * drains it with burst I2C reads, woken by the data-ready interrupt. The
+ * reading task never polls individual registers, and sample timing comes
+ * from the sensor clock, not from when the task got scheduled.
+ *
+ * Supports the MPU6050 / MPU6500 / MPU9250 register map (WHO_AM_I 0x68,
+ * 0x70, 0x71, 0x73).
+ *
+ * Features:
+ * - 1 kHz accel + gyro (DLPF 184 Hz), +-8 g and +-2000 deg/s
+ * - FIFO burst reads, up to IMU_BURST_SAMPLES samples per I2C transaction
+ * - Data-ready interrupt wakes one task (vTaskNotifyGiveFromISR)
+ * - FIFO overflow detection and recovery
+ */
+
+#ifndef IMU_MPU6050_H
+#define IMU_MPU6050_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define IMU_ADDR             0x68
+#define IMU_SAMPLE_HZ        1000
+#define IMU_SAMPLE_BYTES     12     // accel XYZ + gyro XYZ, int16 big-endian
+#define IMU_BURST_SAMPLES    10     // 120 bytes, within the 128-byte Wire buffer
+#define IMU_FIFO_SIZE        1024
+
+#define IMU_ACCEL_SCALE      (9.80665f / 4096.0f)   // +-8 g -> m/s^2
+#define IMU_GYRO_SCALE       (1.0f / 16.4f)          // +-2000 deg/s -> deg/s
+
+// Registers
+#define MPU_SMPLRT_DIV       0x19
+#define MPU_CONFIG           0x1A
+#define MPU_GYRO_CONFIG      0x1B
+#define MPU_ACCEL_CONFIG     0x1C
+#define MPU_FIFO_EN          0x23
+#define MPU_INT_PIN_CFG      0x37
+#define MPU_INT_ENABLE       0x38
+#define MPU_USER_CTRL        0x6A
+#define MPU_PWR_MGMT_1       0x6B
+#define MPU_FIFO_COUNTH      0x72
+#define MPU_FIFO_R_W         0x74
+#define MPU_WHO_AM_I         0x75
+
+struct ImuSample {
+  float accel[3];   // m/s^2
+  float gyro[3];    // deg/s
+};
+
+struct ImuStats {
+  uint32_t samples;
+  uint32_t overflows;    // FIFO filled up before it was drained
+  uint32_t i2cErrors;
+};
+
+static TwoWire* imuWire = nullptr;
+static TaskHandle_t imuTask = nullptr;
+static ImuStats imuStats = {0, 0, 0};
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+inline bool imu_write(uint8_t reg, uint8_t value) {
+  imuWire->beginTransmission(IMU_ADDR);
+  imuWire->write(reg);
+  imuWire->write(value);
+  return imuWire->endTransmission() == 0;
+}
+
+/**
+ * Burst-read `len` consecutive bytes starting at `reg` in one transaction.
+ */
+inline bool imu_read(uint8_t reg, uint8_t* out, size_t len) {
+  imuWire->beginTransmission(IMU_ADDR);
+  imuWire->write(reg);
+  if (imuWire->endTransmission(false) != 0 ||
+      imuWire->requestFrom((uint8_t)IMU_ADDR, len) != len) {
+    imuStats.i2cErrors++;
+    return false;
+  }
+  imuWire->readBytes(out, len);
+  return true;
+}
+
+inline void imu_reset_fifo() {
+  imu_write(MPU_USER_CTRL, 0x04);   // FIFO_RESET
+  imu_write(MPU_USER_CTRL, 0x40);   // FIFO_EN
+}
+
+/**
+ * Detect and configure the IMU. `wire` must already be begun (400 kHz).
+ * Returns false if no supported sensor answers.
+ */
+inline bool imu_init(TwoWire& wire) {
+  imuWire = &wire;
+
+  uint8_t id = 0;
+  if (!imu_read(MPU_WHO_AM_I, &id, 1) ||
+      (id != 0x68 && id != 0x70 && id != 0x71 && id != 0x73)) {
+    return false;
+  }
+
+  imu_write(MPU_PWR_MGMT_1, 0x80);  // Device reset
+  delay(100);
+  imu_write(MPU_PWR_MGMT_1, 0x01);  // Clock from gyro X PLL
+  imu_write(MPU_CONFIG, 0x01);      // DLPF 184 Hz -> 1 kHz internal rate
+  imu_write(MPU_SMPLRT_DIV, 1000 / IMU_SAMPLE_HZ - 1);
+  imu_write(MPU_GYRO_CONFIG, 0x18); // +-2000 deg/s
+  imu_write(MPU_ACCEL_CONFIG, 0x10);// +-8 g
+  imu_write(MPU_INT_PIN_CFG, 0x00); // Active high, push-pull, 50 us pulse
+  imu_reset_fifo();
+  imu_write(MPU_FIFO_EN, 0x78);     // Accel + gyro XYZ into the FIFO
+  imu_write(MPU_INT_ENABLE, 0x01);  // Data ready
+  return true;
+}
+
+static void IRAM_ATTR imu_isr() {
+  BaseType_t woken = pdFALSE;
+  if (imuTask != nullptr) {
+    vTaskNotifyGiveFromISR(imuTask, &woken);
+  }
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+/**
+ * Route the data-ready interrupt on `intPin` to `task`, which then waits
+ * with ulTaskNotifyTake() and calls imu_read_fifo().
+ */
+inline void imu_attach_interrupt(int intPin, TaskHandle_t task) {
+  imuTask = task;
+  pinMode(intPin, INPUT);
+  attachInterrupt(digitalPinToInterrupt(intPin), imu_isr, RISING);
+}
+
+/**
+ * Drain up to `maxSamples` samples from the FIFO, oldest first, in burst
+ * reads. Returns the number of samples written to `out`.
+ */
+inline int imu_read_fifo(ImuSample* out, int maxSamples) {
+  uint8_t countBytes[2];
+  if (!imu_read(MPU_FIFO_COUNTH, countBytes, 2)) {
+    return 0;
+  }
+  int available = ((countBytes[0] << 8) | countBytes[1]) / IMU_SAMPLE_BYTES;
+  if (available * IMU_SAMPLE_BYTES >= IMU_FIFO_SIZE - IMU_SAMPLE_BYTES) {
+    // Overflowed: the FIFO may be misaligned, start over
+    imuStats.overflows++;
+    imu_reset_fifo();
+    return 0;
+  }
+
+  int count = 0;
+  uint8_t raw[IMU_BURST_SAMPLES * IMU_SAMPLE_BYTES];
+  while (count < maxSamples && count < available) {
+    int burst = min(min(available - count, maxSamples - count), IMU_BURST_SAMPLES);
+    if (!imu_read(MPU_FIFO_R_W, raw, burst * IMU_SAMPLE_BYTES)) {
+      break;
+    }
+    for (int s = 0; s < burst; s++) {
+      const uint8_t* p = raw + s * IMU_SAMPLE_BYTES;
+      ImuSample& sample = out[count++];
+      for (int axis = 0; axis < 3; axis++) {
+        sample.accel[axis] = (int16_t)((p[axis * 2] << 8) | p[axis * 2 + 1]) * IMU_ACCEL_SCALE;
+        sample.gyro[axis] = (int16_t)((p[6 + axis * 2] << 8) | p[6 + axis * 2 + 1]) * IMU_GYRO_SCALE;
+      }
+    }
+  }
+  imuStats.samples += count;
+  return count;
+}
+
+#endif // IMU_MPU6050_H
@@ -0,0 +1,121 @@
+/**
+ * Line Reader for ESP32 Flight Controller
+ *
+ * Collects newline-delimited commands from a Stream into a fixed buffer,
+ * with no heap allocation. A completed line is NUL-terminated in place so
+ * it can be handed straight to deserializeJson(doc, line, len), which
+ * parses it zero-copy; the line stays valid until the next poll.
+ *
+ * Features:
+ * - Bounded memory (LINE_READER_MAX bytes, allocated once)
+ * - Overflow detection: an over-long line is discarded up to its newline
+ *   and reported once, so the next command parses cleanly
+ * - '\r' stripped, so CRLF hosts work unchanged
+ * - Non-blocking: reads only what the UART/CDC driver already buffered
+ * - Optional binary frames (binary_protocol.h): with `binaryFrames` set,
+ *   a 0x00 delimiter starts a COBS frame that runs to the next 0x00. COBS
+ *   output never contains 0x00, and a frame under 122 bytes never starts
+ *   with '{' (0x7B), so a JSON line may still follow any delimiter.
+ */
+
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <Arduino.h>
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define LINE_READER_MAX  512   // Longest accepted line, excluding '\n'
+
+enum LineStatus {
+  LINE_NONE,       // No complete line yet
+  LINE_READY,      // reader.buf holds a NUL-terminated line of reader.len bytes
+  LINE_FRAME,      // reader.buf holds a COBS frame of reader.len bytes (no delimiter)
+  LINE_OVERFLOW    // A line longer than LINE_READER_MAX was dropped
+};
+
+struct LineReader {
+  char buf[LINE_READER_MAX + 1];
+  size_t len;
+  bool ready;            // buf holds a line the caller has not released
+  bool overflowed;       // Discarding until the next delimiter
+  bool binaryFrames;     // Accept 0x00-delimited binary frames
+  bool afterDelimiter;   // Last byte was 0x00: a binary frame may start
+  bool binary;           // The frame being collected is binary
+  uint32_t overflows;    // Lines dropped since boot
+};
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+inline void line_reader_init(LineReader& reader) {
+  reader.len = 0;
+  reader.ready = false;
+  reader.overflowed = false;
+  reader.binaryFrames = false;
+  reader.afterDelimiter = false;
+  reader.binary = false;
+  reader.overflows = 0;
+}
+
+/**
+ * Consume buffered input until a line completes or the input runs dry.
+ * Returns LINE_READY / LINE_FRAME at most once per frame; call again to
+ * continue reading after the caller is done with reader.buf.
+ */
+inline LineStatus line_reader_poll(LineReader& reader, Stream& in) {
+  // The previous line has been consumed (deserializeJson may have
+  // rewritten it in place)
+  if (reader.ready) {
+    reader.ready = false;
+    reader.len = 0;
+  }
+
+  while (in.available() > 0) {
+    int c = in.read();
+    if (c < 0) {
+      break;
+    }
+
+    // The first byte after a 0x00 decides whether this is a binary frame
+    if (reader.len == 0 && !reader.overflowed) {
+      if (c == 0x00 && reader.binaryFrames) {
+        reader.afterDelimiter = true;  // Leading or repeated delimiter
+        continue;
+      }
+      reader.binary = reader.afterDelimiter && c != '{';
+      reader.afterDelimiter = false;
+    }
+
+    if (c == (reader.binary ? 0x00 : '\n')) {
+      // A binary frame's closing 0x00 also opens the next one
+      reader.afterDelimiter = reader.binary;
+      if (reader.overflowed) {
+        reader.overflowed = false;
+        reader.len = 0;
+        reader.overflows++;
+        return LINE_OVERFLOW;
+      }
+      if (reader.len == 0) {
+        continue;  // Blank line
+      }
+      reader.buf[reader.len] = '\0';
+      reader.ready = true;
+      return reader.binary ? LINE_FRAME : LINE_READY;
+    }
+    if ((c == '\r' && !reader.binary) || reader.overflowed) {
+      continue;
+    }
+    if (reader.len >= LINE_READER_MAX) {
+      reader.overflowed = true;
+      continue;
+    }
+    reader.buf[reader.len++] = (char)c;
+  }
+  return LINE_NONE;
+}
+
+#endif // LINE_READER_H
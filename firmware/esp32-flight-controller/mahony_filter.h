@@ -0,0 +1,131 @@
+/**
+ * Mahony Attitude Filter for ESP32 Flight Controller
+ *
+ * Complementary filter on the rotation quaternion: integrates the gyro and
+ * pulls the estimate toward the gravity direction measured by the
+ * accelerometer with a PI correction (Mahony et al., 2008). Without a
+ * magnetometer yaw is gyro-integrated only and drifts slowly.
+ *
+ * Features:
+ * - Fixed-step update (dt from the IMU sample rate, not wall-clock jitter)
+ * - Integral term removes gyro bias
+ * - Accelerometer correction skipped when |a| is far from 1 g (thrust,
+ *   vibration spikes)
+ * - Initial attitude taken from the first accelerometer sample
+ */
+
+#ifndef MAHONY_FILTER_H
+#define MAHONY_FILTER_H
+
+#include <Arduino.h>
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define MAHONY_KP            2.0f    // Proportional gain (accel trust)
+#define MAHONY_KI            0.005f  // Integral gain (gyro bias)
+#define MAHONY_ACCEL_GATE    0.25f   // Ignore accel if | |a|/g - 1 | exceeds this
+
+struct MahonyFilter {
+  float q0, q1, q2, q3;   // Body -> earth rotation
+  float biasX, biasY, biasZ;  // Integral feedback, rad/s
+  bool initialized;
+};
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+inline void mahony_reset(MahonyFilter& f) {
+  f.q0 = 1.0f;
+  f.q1 = f.q2 = f.q3 = 0.0f;
+  f.biasX = f.biasY = f.biasZ = 0.0f;
+  f.initialized = false;
+}
+
+/**
+ * Level the estimate to the measured gravity vector (yaw = 0).
+ */
+inline void mahony_align(MahonyFilter& f, float ax, float ay, float az) {
+  float roll = atan2f(ay, az);
+  float pitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+  float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+  float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+  f.q0 = cr * cp;
+  f.q1 = sr * cp;
+  f.q2 = cr * sp;
+  f.q3 = -sr * sp;
+  f.initialized = true;
+}
+
+/**
+ * One filter step. Gyro in rad/s, accel in any consistent unit (only its
+ * direction is used, `g` is its 1 g magnitude), dt in seconds.
+ */
+inline void mahony_update(MahonyFilter& f, float gx, float gy, float gz,
+                          float ax, float ay, float az, float g, float dt) {
+  float norm = sqrtf(ax * ax + ay * ay + az * az);
+  if (!f.initialized) {
+    if (norm > 0.0f) {
+      mahony_align(f, ax, ay, az);
+    }
+    return;
+  }
+
+  if (norm > 0.0f && fabsf(norm / g - 1.0f) < MAHONY_ACCEL_GATE) {
+    float inv = 1.0f / norm;
+    ax *= inv;
+    ay *= inv;
+    az *= inv;
+
+    // Gravity direction predicted by the current estimate
+    float vx = 2.0f * (f.q1 * f.q3 - f.q0 * f.q2);
+    float vy = 2.0f * (f.q0 * f.q1 + f.q2 * f.q3);
+    float vz = f.q0 * f.q0 - f.q1 * f.q1 - f.q2 * f.q2 + f.q3 * f.q3;
+
+    // Error is the cross product of measured and predicted gravity
+    float ex = ay * vz - az * vy;
+    float ey = az * vx - ax * vz;
+    float ez = ax * vy - ay * vx;
+
+    f.biasX += MAHONY_KI * ex * dt;
+    f.biasY += MAHONY_KI * ey * dt;
+    f.biasZ += MAHONY_KI * ez * dt;
+    gx += MAHONY_KP * ex + f.biasX;
+    gy += MAHONY_KP * ey + f.biasY;
+    gz += MAHONY_KP * ez + f.biasZ;
+  } else {
+    gx += f.biasX;
+    gy += f.biasY;
+    gz += f.biasZ;
+  }
+
+  // Integrate q' = 0.5 * q * (0, g)
+  float h = 0.5f * dt;
+  float q0 = f.q0, q1 = f.q1, q2 = f.q2, q3 = f.q3;
+  f.q0 += (-q1 * gx - q2 * gy - q3 * gz) * h;
+  f.q1 += (q0 * gx + q2 * gz - q3 * gy) * h;
+  f.q2 += (q0 * gy - q1 * gz + q3 * gx) * h;
+  f.q3 += (q0 * gz + q1 * gy - q2 * gx) * h;
+
+  float qn = 1.0f / sqrtf(f.q0 * f.q0 + f.q1 * f.q1 + f.q2 * f.q2 + f.q3 * f.q3);
+  f.q0 *= qn;
+  f.q1 *= qn;
+  f.q2 *= qn;
+  f.q3 *= qn;
+}
+
+/**
+ * Roll, pitch, yaw in degrees.
+ */
+inline void mahony_euler(const MahonyFilter& f, float& roll, float& pitch, float& yaw) {
+  roll = atan2f(2.0f * (f.q0 * f.q1 + f.q2 * f.q3),
+                1.0f - 2.0f * (f.q1 * f.q1 + f.q2 * f.q2)) * RAD_TO_DEG;
+  float s = constrain(2.0f * (f.q0 * f.q2 - f.q3 * f.q1), -1.0f, 1.0f);
+  pitch = asinf(s) * RAD_TO_DEG;
+  yaw = atan2f(2.0f * (f.q0 * f.q3 + f.q1 * f.q2),
+               1.0f - 2.0f * (f.q2 * f.q2 + f.q3 * f.q3)) * RAD_TO_DEG;
+}
+
+#endif // MAHONY_FILTER_H
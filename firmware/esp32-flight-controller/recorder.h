@@ -0,0 +1,179 @@
+/**
+ * On-Device Data Recorder for the Cube Robot Boards
+ *
+ * Records high-rate samples (IMU, motor outputs, pose, safety events,
+ * command arrivals) into a RAM ring buffer at the control loop rate, for a
+ * bulk download after the fact. Streaming the same data at 1 kHz over the
+ * command link is not possible; recording locally costs a few hundred
+ * nanoseconds per record.
+ *
+ * Records are fixed 32-byte entries numbered from boot (or the last
+ * clear). Once the ring is full the oldest records are overwritten; a
+ * reader asks for a range by record number and gets only the records that
+ * still exist, so a gap in the numbers tells the host what was lost.
+ *
+ * Identical copies live next to each sketch (Arduino only builds files in
+ * the sketch directory).
+ *
+ * Features:
+ * - PSRAM-backed when available, smaller internal-RAM ring otherwise
+ * - Any task on either core may record; short critical section, no heap
+ * - Chunked reads for the download path, consistent against writers
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <Arduino.h>
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define RECORDER_PSRAM_BYTES  (2 * 1024 * 1024)  // ~30 s of 1 kHz IMU + motors
+#define RECORDER_DRAM_BYTES   (32 * 1024)        // Fallback without PSRAM
+#define RECORDER_VALUES       6
+
+enum RecordType : uint8_t {
+  REC_IMU      = 1,   // v: accel xyz (m/s^2), gyro xyz (deg/s)
+  REC_ATTITUDE = 2,   // v: roll, pitch, yaw (deg), rate setpoints (deg/s)
+  REC_MOTORS   = 3,   // v: per-motor output; aux/flags sketch-defined
+  REC_POSE     = 4,   // v: x, y (cm), heading (rad), left/right steps
+  REC_SAFETY   = 5,   // aux: event code; v: event details (sketch-defined)
+  REC_COMMAND  = 6,   // aux: command table index; flags: RECORD_FLAG_*
+  REC_MARK     = 7    // Recording started / host marker
+};
+
+#define RECORD_FLAG_BINARY  0x01   // REC_COMMAND: arrived as a binary frame
+
+struct RecordEntry {
+  uint32_t timeUs;    // esp_timer, low 32 bits (wraps after ~71 min)
+  uint8_t type;       // RecordType
+  uint8_t flags;
+  uint16_t aux;
+  float v[RECORDER_VALUES];
+};
+static_assert(sizeof(RecordEntry) == 32, "RecordEntry is a 32-byte wire record");
+
+struct Recorder {
+  RecordEntry* ring;
+  uint32_t capacity;   // Power of two
+  uint32_t head;       // Records written since the last clear
+  bool psram;
+  volatile bool enabled;
+};
+
+static Recorder recorder = {nullptr, 0, 0, false, false};
+static portMUX_TYPE recorderMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+/**
+ * Allocate the ring (PSRAM first) and start recording. Returns false if
+ * no memory could be found; recording calls are then no-ops.
+ */
+inline bool recorder_init() {
+  uint32_t bytes = RECORDER_PSRAM_BYTES;
+  void* ring = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  recorder.psram = ring != nullptr;
+  if (!ring) {
+    bytes = RECORDER_DRAM_BYTES;
+    ring = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+  if (!ring) {
+    return false;
+  }
+
+  uint32_t capacity = 1;
+  while (capacity * 2 <= bytes / sizeof(RecordEntry)) {
+    capacity *= 2;
+  }
+  recorder.ring = (RecordEntry*)ring;
+  recorder.capacity = capacity;
+  recorder.head = 0;
+  recorder.enabled = true;
+  return true;
+}
+
+/**
+ * Append one record stamped `timeUs`. `values` may be shorter than
+ * RECORDER_VALUES; the rest are zero.
+ */
+inline void recorder_write_at(uint32_t timeUs, RecordType type, uint8_t flags, uint16_t aux,
+                              const float* values, int count) {
+  if (!recorder.enabled) {
+    return;
+  }
+  RecordEntry entry = {timeUs, type, flags, aux, {}};
+  for (int i = 0; i < count && i < RECORDER_VALUES; i++) {
+    entry.v[i] = values[i];
+  }
+
+  portENTER_CRITICAL(&recorderMux);
+  recorder.ring[recorder.head & (recorder.capacity - 1)] = entry;
+  recorder.head++;
+  portEXIT_CRITICAL(&recorderMux);
+}
+
+inline void recorder_write(RecordType type, uint8_t flags, uint16_t aux,
+                           const float* values, int count) {
+  recorder_write_at((uint32_t)esp_timer_get_time(), type, flags, aux, values, count);
+}
+
+/**
+ * Oldest record number still in the ring.
+ */
+inline uint32_t recorder_oldest(uint32_t head) {
+  return head > recorder.capacity ? head - recorder.capacity : 0;
+}
+
+/**
+ * Copy up to `maxCount` records starting at record number `from` into `out`.
+ * If `from` has been overwritten, copying starts at the oldest record
+ * instead; `first` is set to the number of the first record copied.
+ * Returns the number copied (0 once `from` reaches the head).
+ */
+inline int recorder_read(uint32_t from, RecordEntry* out, int maxCount, uint32_t& first) {
+  portENTER_CRITICAL(&recorderMux);
+  uint32_t head = recorder.head;
+  uint32_t start = max(from, recorder_oldest(head));
+  int count = 0;
+  if (recorder.ring && start < head) {
+    count = (int)min((uint32_t)maxCount, head - start);
+    for (int i = 0; i < count; i++) {
+      out[i] = recorder.ring[(start + i) & (recorder.capacity - 1)];
+    }
+  }
+  portEXIT_CRITICAL(&recorderMux);
+  first = start;
+  return count;
+}
+
+/**
+ * Snapshot of the head, for status replies and download ranges.
+ */
+inline uint32_t recorder_head() {
+  portENTER_CRITICAL(&recorderMux);
+  uint32_t head = recorder.head;
+  portEXIT_CRITICAL(&recorderMux);
+  return head;
+}
+
+inline void recorder_clear() {
+  portENTER_CRITICAL(&recorderMux);
+  recorder.head = 0;
+  portEXIT_CRITICAL(&recorderMux);
+}
+
+inline void recorder_set_enabled(bool enabled) {
+  recorder.enabled = enabled && recorder.ring != nullptr;
+  if (recorder.enabled) {
+    recorder_write(REC_MARK, 0, 0, nullptr, 0);
+  }
+}
+
+#endif // RECORDER_H
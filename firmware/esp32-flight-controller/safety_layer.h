@@ -4,6 +4,11 @@
  * Provides firmware-level hard safety limits that cannot be overridden
  * by the host software. This is the last line of defense.
  *
+ * All state can be shared between cores and ISRs without locks: the
+ * e-stop latch, PWM ceiling and timers are std::atomic, and the
+ * configuration is double-buffered behind a sequence counter so readers
+ * always get a consistent snapshot and never wait on a writer.
+ *
  * Features:
  * - Motor PWM clamping
  * - Emergency stop on obstacle proximity
@@ -11,12 +16,14 @@
  * - Continuous motor timeout
  * - Host heartbeat timeout
  * - Battery voltage cutoff
+ * - Lock-free: safe to call from a timer ISR or any task on either core
  */
 
 #ifndef SAFETY_LAYER_H
 #define SAFETY_LAYER_H
 
 #include <Arduino.h>
+#include <atomic>
 
 // ---------------------------------------------------------------------------
 // Configuration & State
@@ -32,18 +39,31 @@ struct SafetyConfig {
   float minBatteryVoltage;        // Minimum battery voltage (default: 3.0)
 };
 
+// Every field is word-sized and atomic; read individually, never torn
 struct SafetyState {
-  bool emergencyStopped;
-  unsigned long motorStartTime;
-  unsigned long lastHostCommandTime;
-  int currentMaxPWM;
-  int violations;
-  bool motorRunning;
-  float lastBatteryVoltage;
+  std::atomic<bool> emergencyStopped{false};
+  std::atomic<unsigned long> motorStartTime{0};
+  std::atomic<unsigned long> lastHostCommandTime{0};
+  std::atomic<int> currentMaxPWM{200};
+  std::atomic<int> violations{0};
+  std::atomic<bool> motorRunning{false};
+  std::atomic<float> lastBatteryVoltage{4.2f};  // Assume full
+};
+
+/**
+ * Double-buffered value with a sequence counter (single writer, any
+ * number of readers). The writer fills the slot readers are not using and
+ * then publishes it; a reader only retries if a whole update landed
+ * while it was copying.
+ */
+template <typename T>
+struct SafetySnapshot {
+  T slots[2];
+  std::atomic<uint32_t> seq;      // slots[seq & 1] is current (zero-initialized)
 };
 
 // Default configuration
-static SafetyConfig safetyConfig = {
+static const SafetyConfig SAFETY_DEFAULT_CONFIG = {
   200,    // maxMotorPWM
   8,      // emergencyStopCm
   20,     // speedReduceCm
@@ -52,31 +72,60 @@ static SafetyConfig safetyConfig = {
   3.0f    // minBatteryVoltage
 };
 
-static SafetyState safetyState = {
-  false,  // emergencyStopped
-  0,      // motorStartTime
-  0,      // lastHostCommandTime
-  200,    // currentMaxPWM
-  0,      // violations
-  false,  // motorRunning
-  4.2f    // lastBatteryVoltage (assume full)
+static SafetySnapshot<SafetyConfig> safetyConfigBuffer = {
+  {SAFETY_DEFAULT_CONFIG, SAFETY_DEFAULT_CONFIG}
 };
 
+static SafetyState safetyState;
+
 // ---------------------------------------------------------------------------
 // Functions
 // ---------------------------------------------------------------------------
 
+template <typename T>
+inline T safety_snapshot_read(const SafetySnapshot<T>& buffer) {
+  T value;
+  uint32_t seq;
+  do {
+    seq = buffer.seq.load(std::memory_order_acquire);
+    value = buffer.slots[seq & 1];
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while (buffer.seq.load(std::memory_order_relaxed) != seq);
+  return value;
+}
+
+/**
+ * Publish a new value. Only one task may write a given snapshot.
+ */
+template <typename T>
+inline void safety_snapshot_write(SafetySnapshot<T>& buffer, const T& value) {
+  uint32_t next = buffer.seq.load(std::memory_order_relaxed) + 1;
+  buffer.slots[next & 1] = value;
+  buffer.seq.store(next, std::memory_order_release);
+}
+
+/**
+ * Consistent copy of the running configuration.
+ */
+inline SafetyConfig safety_config() {
+  return safety_snapshot_read(safetyConfigBuffer);
+}
+
 /**
  * Initialize safety state. Must be called in setup().
  */
 inline void safety_init() {
-  safetyState.emergencyStopped = false;
-  safetyState.motorStartTime = 0;
-  safetyState.lastHostCommandTime = millis();
-  safetyState.currentMaxPWM = safetyConfig.maxMotorPWM;
-  safetyState.violations = 0;
-  safetyState.motorRunning = false;
-  safetyState.lastBatteryVoltage = 4.2f;
+  safetyState.emergencyStopped.store(false);
+  safetyState.motorStartTime.store(0);
+  safetyState.lastHostCommandTime.store(millis());
+  safetyState.currentMaxPWM.store(safety_config().maxMotorPWM);
+  safetyState.violations.store(0);
+  safetyState.motorRunning.store(false);
+  safetyState.lastBatteryVoltage.store(4.2f);
+}
+
+inline bool safety_is_stopped() {
+  return safetyState.emergencyStopped.load(std::memory_order_acquire);
 }
 
 /**
@@ -84,16 +133,18 @@ inline void safety_init() {
  * Returns 0 if emergency stopped.
  */
 inline int safety_clamp_motors(int requestedPWM) {
-  if (safetyState.emergencyStopped) {
+  if (safety_is_stopped()) {
     return 0;
   }
 
   int clamped = requestedPWM;
-  if (clamped > safetyState.currentMaxPWM) {
-    clamped = safetyState.currentMaxPWM;
+  int currentMax = safetyState.currentMaxPWM.load(std::memory_order_relaxed);
+  if (clamped > currentMax) {
+    clamped = currentMax;
   }
-  if (clamped > safetyConfig.maxMotorPWM) {
-    clamped = safetyConfig.maxMotorPWM;
+  int configMax = safety_config().maxMotorPWM;
+  if (clamped > configMax) {
+    clamped = configMax;
   }
   if (clamped < 0) {
     clamped = 0;
@@ -106,63 +157,80 @@ inline int safety_clamp_motors(int requestedPWM) {
  * is received from the host.
  */
 inline void safety_host_heartbeat() {
-  safetyState.lastHostCommandTime = millis();
+  safetyState.lastHostCommandTime.store(millis(), std::memory_order_relaxed);
 }
 
 /**
  * Notify the safety layer that a motor has started running.
  */
 inline void safety_motor_started() {
-  safetyState.motorStartTime = millis();
-  safetyState.motorRunning = true;
+  safetyState.motorStartTime.store(millis(), std::memory_order_relaxed);
+  safetyState.motorRunning.store(true, std::memory_order_release);
 }
 
 /**
  * Notify the safety layer that motors have stopped.
  */
 inline void safety_motor_stopped() {
-  safetyState.motorRunning = false;
+  safetyState.motorRunning.store(false, std::memory_order_release);
 }
 
 /**
  * Trigger an emergency stop. Sets PWM ceiling to 0 and latches the
- * emergency flag until safety_reset() is called.
+ * emergency flag until safety_reset() is called. Returns true if this
+ * call latched it (false if it was already stopped).
  */
-inline void safety_emergency_stop() {
-  safetyState.emergencyStopped = true;
-  safetyState.currentMaxPWM = 0;
+inline bool safety_emergency_stop() {
+  safetyState.currentMaxPWM.store(0, std::memory_order_relaxed);
+  return !safetyState.emergencyStopped.exchange(true, std::memory_order_acq_rel);
 }
 
 /**
- * Reset the emergency stop latch and restore normal operation.
+ * Reset the emergency stop latch and restore normal operation. The latch
+ * is cleared with a compare-exchange, and the limits are restored only if
+ * that succeeds. An e-stop that lands during the reset re-latches after
+ * it, and wins. Returns true if a latched stop was cleared.
  */
-inline void safety_reset() {
-  safetyState.emergencyStopped = false;
-  safetyState.currentMaxPWM = safetyConfig.maxMotorPWM;
-  safetyState.motorRunning = false;
+inline bool safety_reset() {
+  bool latched = true;
+  if (!safetyState.emergencyStopped.compare_exchange_strong(
+          latched, false, std::memory_order_acq_rel)) {
+    return false;
+  }
+  safetyState.motorRunning.store(false, std::memory_order_relaxed);
+  safetyState.currentMaxPWM.store(safety_config().maxMotorPWM, std::memory_order_relaxed);
+  if (safety_is_stopped()) {
+    // Tripped again meanwhile: keep its zero ceiling
+    safetyState.currentMaxPWM.store(0, std::memory_order_relaxed);
+  }
+  return true;
 }
 
 /**
- * Main safety check — call every loop() iteration.
+ * Main safety check — call periodically (the safety task runs it at 1 kHz).
  * Returns true if the system is safe to continue, false if emergency
- * stopped.
+ * stopped. `violations` counts the trips this check latched, not the calls
+ * that found a limit still exceeded.
  */
 inline bool safety_check() {
+  SafetyConfig config = safety_config();
+  unsigned long now = millis();
+
   // 1. Check host heartbeat timeout
-  if (millis() - safetyState.lastHostCommandTime > safetyConfig.hostTimeoutMs) {
-    safety_emergency_stop();
-    safetyState.violations++;
+  if (now - safetyState.lastHostCommandTime.load(std::memory_order_relaxed) > config.hostTimeoutMs &&
+      safety_emergency_stop()) {
+    safetyState.violations.fetch_add(1, std::memory_order_relaxed);
   }
 
   // 2. Check continuous motor runtime
-  if (safetyState.motorRunning &&
-      (millis() - safetyState.motorStartTime > safetyConfig.maxContinuousMs)) {
-    safety_emergency_stop();
-    safetyState.violations++;
+  if (safetyState.motorRunning.load(std::memory_order_acquire) &&
+      (now - safetyState.motorStartTime.load(std::memory_order_relaxed) > config.maxContinuousMs) &&
+      safety_emergency_stop()) {
+    safetyState.violations.fetch_add(1, std::memory_order_relaxed);
   }
 
   // 3. If emergency stopped, report unsafe
-  if (safetyState.emergencyStopped) {
+  if (safety_is_stopped()) {
     return false;
   }
 
@@ -175,21 +243,22 @@ inline bool safety_check() {
  * proportionally reduces the PWM ceiling if in the speed-reduce zone.
  */
 inline void safety_update_distance(int distanceCm) {
-  if (distanceCm <= safetyConfig.emergencyStopCm) {
+  SafetyConfig config = safety_config();
+  if (distanceCm <= config.emergencyStopCm) {
     safety_emergency_stop();
     return;
   }
 
-  if (distanceCm <= safetyConfig.speedReduceCm) {
-    safetyState.currentMaxPWM = map(
+  if (distanceCm <= config.speedReduceCm) {
+    safetyState.currentMaxPWM.store(map(
       distanceCm,
-      safetyConfig.emergencyStopCm,
-      safetyConfig.speedReduceCm,
+      config.emergencyStopCm,
+      config.speedReduceCm,
       0,
-      safetyConfig.maxMotorPWM
-    );
+      config.maxMotorPWM
+    ), std::memory_order_relaxed);
   } else {
-    safetyState.currentMaxPWM = safetyConfig.maxMotorPWM;
+    safetyState.currentMaxPWM.store(config.maxMotorPWM, std::memory_order_relaxed);
   }
 }
 
@@ -198,20 +267,20 @@ inline void safety_update_distance(int distanceCm) {
  * if voltage drops below the configured minimum.
  */
 inline void safety_update_battery(float voltage) {
-  safetyState.lastBatteryVoltage = voltage;
-  if (voltage < safetyConfig.minBatteryVoltage) {
+  safetyState.lastBatteryVoltage.store(voltage, std::memory_order_relaxed);
+  if (voltage < safety_config().minBatteryVoltage) {
     safety_emergency_stop();
   }
 }
 
 /**
  * Replace the running safety configuration. Recalculates the current
- * PWM ceiling based on the new limits.
+ * PWM ceiling based on the new limits. Call from one task only.
  */
 inline void safety_update_config(SafetyConfig newConfig) {
-  safetyConfig = newConfig;
-  if (!safetyState.emergencyStopped) {
-    safetyState.currentMaxPWM = safetyConfig.maxMotorPWM;
+  safety_snapshot_write(safetyConfigBuffer, newConfig);
+  if (!safety_is_stopped()) {
+    safetyState.currentMaxPWM.store(newConfig.maxMotorPWM, std::memory_order_relaxed);
   }
 }
 
@@ -228,22 +297,34 @@ struct StepperSafetyConfig {
   int maxCoilCurrentMa;              // Max current per coil (default: 300mA)
 };
 
-static StepperSafetyConfig stepperSafetyConfig = {
+static const StepperSafetyConfig STEPPER_SAFETY_DEFAULT_CONFIG = {
   1024,   // maxStepsPerSecond
   40960,  // maxContinuousSteps (10 revolutions)
   2000,   // hostHeartbeatMs
   300     // maxCoilCurrentMa
 };
 
+static SafetySnapshot<StepperSafetyConfig> stepperSafetyConfigBuffer = {
+  {STEPPER_SAFETY_DEFAULT_CONFIG, STEPPER_SAFETY_DEFAULT_CONFIG}
+};
+
+/**
+ * Consistent copy of the running stepper configuration.
+ */
+inline StepperSafetyConfig stepper_safety_config() {
+  return safety_snapshot_read(stepperSafetyConfigBuffer);
+}
+
 /**
  * Clamp a requested step speed to the safe maximum.
  */
 inline int stepper_safety_clamp_speed(int requestedSpeed) {
-  if (safetyState.emergencyStopped) {
+  if (safety_is_stopped()) {
     return 0;
   }
-  if (requestedSpeed > stepperSafetyConfig.maxStepsPerSecond) {
-    return stepperSafetyConfig.maxStepsPerSecond;
+  int maxSpeed = stepper_safety_config().maxStepsPerSecond;
+  if (requestedSpeed > maxSpeed) {
+    return maxSpeed;
   }
   if (requestedSpeed < 0) {
     return 0;
@@ -255,14 +336,15 @@ inline int stepper_safety_clamp_speed(int requestedSpeed) {
  * Clamp a requested step count to the safe maximum.
  */
 inline long stepper_safety_clamp_steps(long requestedSteps) {
-  if (safetyState.emergencyStopped) {
+  if (safety_is_stopped()) {
     return 0;
   }
-  if (requestedSteps > stepperSafetyConfig.maxContinuousSteps) {
-    return stepperSafetyConfig.maxContinuousSteps;
+  long maxSteps = stepper_safety_config().maxContinuousSteps;
+  if (requestedSteps > maxSteps) {
+    return maxSteps;
   }
-  if (requestedSteps < -stepperSafetyConfig.maxContinuousSteps) {
-    return -stepperSafetyConfig.maxContinuousSteps;
+  if (requestedSteps < -maxSteps) {
+    return -maxSteps;
   }
   return requestedSteps;
 }
@@ -273,19 +355,21 @@ inline long stepper_safety_clamp_steps(long requestedSteps) {
  */
 inline bool stepper_safety_check() {
   // Use the shorter stepper heartbeat timeout
-  if (millis() - safetyState.lastHostCommandTime > stepperSafetyConfig.hostHeartbeatMs) {
-    safety_emergency_stop();
-    safetyState.violations++;
+  if (millis() - safetyState.lastHostCommandTime.load(std::memory_order_relaxed) >
+      stepper_safety_config().hostHeartbeatMs) {
+    if (safety_emergency_stop()) {
+      safetyState.violations.fetch_add(1, std::memory_order_relaxed);
+    }
     return false;
   }
   return safety_check();
 }
 
 /**
- * Update stepper safety config at runtime.
+ * Update stepper safety config at runtime. Call from one task only.
  */
 inline void stepper_safety_update_config(StepperSafetyConfig newConfig) {
-  stepperSafetyConfig = newConfig;
+  safety_snapshot_write(stepperSafetyConfigBuffer, newConfig);
 }
 
 #endif // USE_STEPPER_MOTORS
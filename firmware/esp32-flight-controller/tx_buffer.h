@@ -0,0 +1,129 @@
+/**
+ * Preallocated Serial TX Buffer for ESP32 Flight Controller
+ *
+ * Every reply and stream frame is assembled in one static buffer and sent
+ * with a single Serial.write(), instead of many small writes (one per
+ * token from serializeJson, plus println). On USB CDC that means one
+ * transfer per reply rather than several partially filled packets.
+ *
+ * Fixed-shape telemetry (motors, IMU, stream frames) uses the printf-style
+ * writers below directly; everything else is serialized from the reply
+ * document into the same buffer.
+ *
+ * Features:
+ * - No heap; one buffer shared by all replies (loop() only)
+ * - Templated array writer for numeric telemetry fields
+ * - Overflow is sticky: a truncated reply is never sent half-way; the
+ *   host gets TX_TOO_LARGE_LINE in its place, so every command still has
+ *   exactly one reply line
+ */
+
+#ifndef TX_BUFFER_H
+#define TX_BUFFER_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define TX_BUFFER_SIZE  1024  // Largest reply, or a batch of a few, plus headroom
+
+// Sent instead of a command reply that overflowed the buffer
+static const char TX_TOO_LARGE_LINE[] = "{\"status\":\"error\",\"msg\":\"Reply too large\"}\n";
+
+struct TxBuffer {
+  char data[TX_BUFFER_SIZE];
+  size_t len;
+  bool overflow;
+  uint32_t dropped;    // Replies discarded (overflow or TX buffer full)
+};
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+inline void tx_begin(TxBuffer& tx) {
+  tx.len = 0;
+  tx.overflow = false;
+}
+
+inline void tx_printf(TxBuffer& tx, const char* fmt, ...) {
+  if (tx.overflow) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(tx.data + tx.len, TX_BUFFER_SIZE - tx.len, fmt, args);
+  va_end(args);
+  if (n < 0 || (size_t)n >= TX_BUFFER_SIZE - tx.len) {
+    tx.overflow = true;
+    return;
+  }
+  tx.len += n;
+}
+
+inline void tx_raw(TxBuffer& tx, const char* text) {
+  tx_printf(tx, "%s", text);
+}
+
+/**
+ * Write `[v0,v1,...]` formatting each element with `fmt` (e.g. "%d",
+ * "%.3f"). T is promoted as printf expects (int, double).
+ */
+template <typename T>
+inline void tx_array(TxBuffer& tx, const T* values, size_t count, const char* fmt) {
+  tx_raw(tx, "[");
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0) {
+      tx_raw(tx, ",");
+    }
+    tx_printf(tx, fmt, values[i]);
+  }
+  tx_raw(tx, "]");
+}
+
+/**
+ * Room left for a payload written directly into tx.data + tx.len.
+ */
+inline size_t tx_available(const TxBuffer& tx) {
+  return tx.overflow ? 0 : TX_BUFFER_SIZE - tx.len;
+}
+
+/**
+ * Account for `n` bytes written directly at tx.data + tx.len.
+ */
+inline void tx_commit(TxBuffer& tx, size_t n) {
+  if (n == 0 || n + 1 >= tx_available(tx)) {   // Full could mean truncated
+    tx.overflow = true;
+    return;
+  }
+  tx.len += n;
+}
+
+/**
+ * Send the buffer as one line with a single write. With `dropIfFull`
+ * (stream frames), skip instead of blocking when the driver's TX buffer
+ * cannot take it. An overflowed command reply is replaced by
+ * TX_TOO_LARGE_LINE; a stream frame is just skipped. Returns false if the
+ * buffer was not sent.
+ */
+inline bool tx_flush_line(TxBuffer& tx, Stream& out, bool dropIfFull) {
+  if (tx.overflow || tx.len + 1 > TX_BUFFER_SIZE) {
+    tx.dropped++;
+    if (!dropIfFull) {
+      out.write((const uint8_t*)TX_TOO_LARGE_LINE, sizeof(TX_TOO_LARGE_LINE) - 1);
+    }
+    return false;
+  }
+  tx.data[tx.len++] = '\n';
+  if (dropIfFull && (size_t)out.availableForWrite() < tx.len) {
+    tx.dropped++;
+    return false;
+  }
+  out.write((const uint8_t*)tx.data, tx.len);
+  return true;
+}
+
+#endif // TX_BUFFER_H
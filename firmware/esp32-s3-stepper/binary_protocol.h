@@ -0,0 +1,234 @@
+/**
+ * Binary Command Protocol for ESP32-S3 Stepper Controller
+ *
+ * Compact fixed-layout alternative to the JSON protocol on the same UDP
+ * port. Enabled with {"cmd":"set_config","binary":true}; JSON stays
+ * available at all times for debugging and configuration.
+ *
+ * Frame layout (little-endian, no padding):
+ *
+ *   [magic:u8 = 0xB5][opcode:u8][seq:u16][payload ...][crc16:u16]
+ *
+ * The magic byte can never start a JSON document, so the receiver tells
+ * the two protocols apart from the first byte. crc16 is CRC-16/CCITT-FALSE
+ * (poly 0x1021, init 0xFFFF) over magic..payload. Replies reuse the request
+ * seq and set bit 7 of the opcode; failures reply with BIN_OP_ERROR.
+ * Pushed telemetry frames carry their own incrementing seq instead, and
+ * recorder download chunks (dump_recorder) their chunk number.
+ * Duplicate seqs are not re-executed (seq_window.h); coalesced ACKs arrive
+ * as BIN_OP_ACK frames.
+ */
+
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <Arduino.h>
+
+// ---------------------------------------------------------------------------
+// Opcodes & Error Codes
+// ---------------------------------------------------------------------------
+
+#define BIN_MAGIC          0xB5
+#define BIN_REPLY_FLAG     0x80
+
+enum BinOpcode : uint8_t {
+  BIN_OP_MOVE_STEPS   = 0x01,  // BinMoveSteps   -> BinMoveAck
+  BIN_OP_MOVE_CM      = 0x02,  // BinMoveCm      -> BinMoveAck
+  BIN_OP_ROTATE_DEG   = 0x03,  // BinRotateDeg   -> BinMoveAck
+  BIN_OP_STOP         = 0x04,  // (none)         -> (none)
+  BIN_OP_GET_STATUS   = 0x05,  // (none)         -> BinStatus
+  BIN_OP_QUEUE_MOVE   = 0x06,  // BinMoveSteps   -> BinQueueStatus
+  BIN_OP_QUEUE_CLEAR  = 0x07,  // (none)         -> BinQueueStatus
+  BIN_OP_QUEUE_STATUS = 0x08,  // (none)         -> BinQueueStatus
+  BIN_OP_SET_VELOCITY = 0x09,  // BinSetVelocity -> BinVelocityAck
+  BIN_OP_SUBSCRIBE    = 0x0A,  // BinSubscribe   -> BinSubscribe (applied rate)
+  BIN_OP_TIME_SYNC    = 0x0B,  // BinTimeSync    -> BinTimeSyncReply
+  BIN_OP_RECORD_CHUNK = 0x7C,  // push only      -> BinRecordChunk + records
+  BIN_OP_TELEMETRY    = 0x7D,  // push only      -> BinTelemetry
+  BIN_OP_ACK          = 0x7E,  // reply only     -> BinAck
+  BIN_OP_ERROR        = 0x7F   // reply only     -> BinError
+};
+
+enum BinErrorCode : uint8_t {
+  BIN_ERR_CRC        = 1,
+  BIN_ERR_LENGTH     = 2,
+  BIN_ERR_OPCODE     = 3,
+  BIN_ERR_DISABLED   = 4,
+  BIN_ERR_STALE      = 5,
+  BIN_ERR_QUEUE_FULL = 6
+};
+
+// ---------------------------------------------------------------------------
+// Frame Structures
+// ---------------------------------------------------------------------------
+
+struct __attribute__((packed)) BinHeader {
+  uint8_t magic;
+  uint8_t opcode;
+  uint16_t seq;
+};
+
+struct __attribute__((packed)) BinMoveSteps {
+  int32_t left;
+  int32_t right;
+  int32_t speed;      // steps/s
+};
+
+struct __attribute__((packed)) BinMoveCm {
+  float leftCm;
+  float rightCm;
+  float speedCmS;
+};
+
+struct __attribute__((packed)) BinRotateDeg {
+  float degrees;
+  float speedCmS;
+};
+
+struct __attribute__((packed)) BinSetVelocity {
+  float linearCmS;
+  float angularRadS;  // Positive turns left (counter-clockwise)
+};
+
+struct __attribute__((packed)) BinMoveAck {
+  int32_t leftSteps;  // After safety clamping
+  int32_t rightSteps;
+  int32_t speed;      // steps/s
+};
+
+#define BIN_STATUS_RUNNING    0x01
+#define BIN_STATUS_EMERGENCY  0x02
+#define BIN_STATUS_TIME_SYNCED 0x04  // Timestamps are on the host clock
+
+struct __attribute__((packed)) BinVelocityAck {
+  int32_t leftStepsS; // After max_speed scaling
+  int32_t rightStepsS;
+};
+
+struct __attribute__((packed)) BinStatus {
+  float x;            // cm
+  float y;            // cm
+  float heading;      // radians
+  int32_t leftSteps;
+  int32_t rightSteps;
+  uint8_t flags;      // BIN_STATUS_*
+  int8_t rssi;        // dBm
+};
+
+struct __attribute__((packed)) BinSubscribe {
+  uint16_t rateHz;    // 0 unsubscribes
+};
+
+struct __attribute__((packed)) BinTelemetry {
+  int64_t timeUs;     // Sample time, host clock once BIN_STATUS_TIME_SYNCED
+  float x;            // cm
+  float y;            // cm
+  float heading;      // radians
+  int32_t leftSteps;
+  int32_t rightSteps;
+  int32_t leftSpeed;  // steps/s, signed
+  int32_t rightSpeed;
+  uint8_t flags;      // BIN_STATUS_*
+  int8_t rssi;        // dBm
+};
+
+struct __attribute__((packed)) BinTimeSync {
+  int64_t offsetUs;   // Local -> host; applied only if rttUs > 0
+  int64_t atUs;       // Local time the offset was measured (reply t1)
+  uint32_t rttUs;     // 0 = ping only
+};
+
+struct __attribute__((packed)) BinTimeSyncReply {
+  int64_t t1;         // Local time the request was received
+  int64_t t2;         // Local time the reply was built
+  uint8_t synced;
+};
+
+struct __attribute__((packed)) BinQueueStatus {
+  uint8_t pending;    // Segments waiting to start
+  uint8_t capacity;
+  uint8_t active;     // 1 while a queued segment is executing
+  uint32_t completed; // Segments finished since boot
+};
+
+#define BIN_RECORD_CHUNK_MAX  14  // 32-byte records per chunk (one datagram)
+
+struct __attribute__((packed)) BinRecordChunk {
+  uint32_t first;     // Record number of the first record (end of range if count is 0)
+  uint8_t count;      // Records that follow; 0 marks the end of the download
+  uint8_t recordSize; // sizeof(RecordEntry), recorder.h
+};
+
+struct __attribute__((packed)) BinAck {
+  uint16_t highest;   // Newest seq executed
+  uint32_t mask;      // Bit i set: seq (highest - i) executed
+};
+
+struct __attribute__((packed)) BinError {
+  uint8_t code;       // BinErrorCode
+};
+
+#define BIN_OVERHEAD  (sizeof(BinHeader) + sizeof(uint16_t))
+#define BIN_FRAME_MAX (BIN_OVERHEAD + 48)
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+/**
+ * CRC-16/CCITT-FALSE. Bitwise — frames are a few dozen bytes at most.
+ */
+inline uint16_t bin_crc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+/**
+ * Validate a received frame. On success returns true and points `payload`
+ * at the payload bytes and sets `payloadLen`; on failure sets `err`.
+ */
+inline bool bin_parse_frame(const uint8_t* frame, size_t len, BinHeader& header,
+                            const uint8_t*& payload, size_t& payloadLen,
+                            BinErrorCode& err) {
+  if (len < BIN_OVERHEAD) {
+    err = BIN_ERR_LENGTH;
+    return false;
+  }
+  memcpy(&header, frame, sizeof(header));
+
+  uint16_t rxCrc;
+  memcpy(&rxCrc, frame + len - sizeof(rxCrc), sizeof(rxCrc));
+  if (bin_crc16(frame, len - sizeof(rxCrc)) != rxCrc) {
+    err = BIN_ERR_CRC;
+    return false;
+  }
+
+  payload = frame + sizeof(header);
+  payloadLen = len - BIN_OVERHEAD;
+  return true;
+}
+
+/**
+ * Build a frame into `out` (at least BIN_OVERHEAD + payloadLen bytes).
+ * Returns the total frame length.
+ */
+inline size_t bin_build_frame(uint8_t* out, uint8_t opcode, uint16_t seq,
+                              const void* payload, size_t payloadLen) {
+  BinHeader header = {BIN_MAGIC, opcode, seq};
+  memcpy(out, &header, sizeof(header));
+  if (payloadLen > 0) {
+    memcpy(out + sizeof(header), payload, payloadLen);
+  }
+  size_t len = sizeof(header) + payloadLen;
+  uint16_t crc = bin_crc16(out, len);
+  memcpy(out + len, &crc, sizeof(crc));
+  return len + sizeof(crc);
+}
+
+#endif // BINARY_PROTOCOL_H
@@ -11,14 +11,51 @@
  *   - 2x ULN2003 driver boards
  *   - 6cm diameter wheels, 10cm wheel base
  *
- * Protocol: JSON over UDP port 4210
- * Commands: move_steps, move_cm, rotate_deg, stop, get_status, set_config
+ * Protocol: JSON over UDP port 4210, plus optional binary framing
+ *           (binary_protocol.h) enabled via set_config "binary":true.
+ *           Optional per-command "seq" for duplicate suppression and
+ *           coalesced ACKs (seq_window.h).
+ * Commands: move_steps, move_cm, rotate_deg, stop, get_status, set_config,
+ *           queue_move, queue_clear, queue_status, set_velocity,
+ *           subscribe_telemetry, time_sync, batch (several commands in one
+ *           datagram, one combined reply), get_recorder, set_recorder,
+ *           dump_recorder (on-board recorder, recorder.h), get_perf
+ *           (section timings, perf_profiler.h), get_power, set_power
+ *           (idle power state, power_manager.h)
+ *
+ * Odometry and telemetry timestamps are on the host clock once the host
+ * has run a time_sync exchange (time_sync.h).
+ *
+ * Pose, wheel speeds, e-stops and command arrivals are recorded at the
+ * motion loop rate into a PSRAM ring (recorder.h) for later download.
+ *
+ * With no host traffic and nothing moving for the idle timeout, the board
+ * drops to 80 MHz with WiFi modem sleep and the status LED off; the next
+ * datagram wakes it (power_manager.h).
+ *
+ * Step generation runs from a hardware timer ISR (step_engine.h), so UDP
+ * and JSON handling no longer add jitter to the step pulses.
+ *
+ * Tasks (see "Task Layout & Queues"):
+ *   core 0: netTask (UDP RX/TX), cmdTask (JSON commands),
+ *           telemetryTask (LED, pushed telemetry)
+ *   core 1: motionTask (move completion, odometry, host timeout) + step ISR
  */
 
 #include <WiFi.h>
 #include <WiFiUdp.h>
-#include <AccelStepper.h>
+#define ARDUINOJSON_USE_LONG_LONG 1   // 64-bit time_sync offsets
 #include <ArduinoJson.h>
+#include "step_engine.h"
+#include "spsc_queue.h"
+#include "binary_protocol.h"
+#include "seq_window.h"
+#include "time_sync.h"
+#include "command_table.h"
+#include "recorder.h"
+#include "perf_profiler.h"
+#define POWER_USE_WIFI 1
+#include "power_manager.h"
 
 // =============================================================================
 // WiFi Configuration
@@ -67,14 +104,19 @@ const float STEPS_PER_CM = STEPS_PER_REV / WHEEL_CIRCUMFERENCE_CM;
 #define HOST_TIMEOUT_MS     2000   // Emergency stop if no command for 2s
 #define MAX_CONTINUOUS_STEPS 40960 // Max 10 revolutions per command
 #define HEARTBEAT_INTERVAL  500    // Status LED blink interval
+#define VELOCITY_TIMEOUT_MS 500    // Ramp to zero if set_velocity stops arriving
+#define VELOCITY_HORIZON_MS 100    // Coast distance kept ahead in velocity mode
+#define TELEMETRY_MAX_HZ    100    // subscribe_telemetry rate limit
+#define TELEMETRY_IDLE_MS   50     // telemetryTask tick while unsubscribed
+#define RECORDER_DUMP_BURST 2      // Recorder chunks netTask sends per pass
 
 // =============================================================================
 // Global Objects
 // =============================================================================
 
-// AccelStepper in HALF4WIRE mode for smooth operation
-AccelStepper leftMotor(AccelStepper::HALF4WIRE, LEFT_IN1, LEFT_IN3, LEFT_IN2, LEFT_IN4);
-AccelStepper rightMotor(AccelStepper::HALF4WIRE, RIGHT_IN1, RIGHT_IN3, RIGHT_IN2, RIGHT_IN4);
+// Coil pins in IN1..IN4 order for the half-step engine
+const uint8_t LEFT_PINS[4] = {LEFT_IN1, LEFT_IN2, LEFT_IN3, LEFT_IN4};
+const uint8_t RIGHT_PINS[4] = {RIGHT_IN1, RIGHT_IN2, RIGHT_IN3, RIGHT_IN4};
 
 WiFiUDP udp;
 StaticJsonDocument<512> jsonDoc;
@@ -89,27 +131,194 @@ struct RobotPose {
   float heading;   // radians
 };
 
+// Pose with the step counts it was integrated from, as published by motionTask
+struct OdometrySample {
+  RobotPose pose;
+  int32_t leftSteps;
+  int32_t rightSteps;
+  int64_t timeUs;    // When the step counts were latched (host clock once synced)
+};
+
+// Integrator state (motionTask only)
 RobotPose pose = {0.0f, 0.0f, 0.0f};
-long prevLeftSteps = 0;
-long prevRightSteps = 0;
+int32_t prevLeftSteps = 0;
+int32_t prevRightSteps = 0;
+
+// Double buffer: motionTask fills the slot readers are not using, then
+// bumps odomSeq. Read with odometrySnapshot().
+OdometrySample odomBuffers[2] = {};
+std::atomic<uint32_t> odomSeq{0};
+
+// Kinematic constants, recomputed by updateKinematics() on set_config
+volatile float stepsPerCm = STEPS_PER_CM;
+volatile float cmPerStep = 1.0f / STEPS_PER_CM;
+volatile float invWheelBase = 1.0f / WHEEL_BASE_CM;
 
 // =============================================================================
 // Runtime State
 // =============================================================================
 
-unsigned long lastCommandTime = 0;
-unsigned long lastHeartbeat = 0;
-bool motorsRunning = false;
-bool emergencyStopped = false;
+volatile unsigned long lastCommandTime = 0;
+volatile bool motorsRunning = false;
+volatile bool emergencyStopped = false;
+volatile bool segmentActive = false;        // A queued segment is executing
+volatile uint32_t segmentsCompleted = 0;
+volatile bool velocityMode = false;         // Streaming set_velocity setpoints
 
 // Configurable parameters (can be updated via set_config)
 float wheelDiameterCm = WHEEL_DIAMETER_CM;
 float wheelBaseCm = WHEEL_BASE_CM;
 int maxSpeedStepsS = MAX_SPEED_STEPS_S;
+bool binaryEnabled = false;
+int ackCoalesceMs = 0;   // > 0: batch plain ACKs into one reply per interval
 
-// UDP response buffer
-char udpBuffer[512];
+// UDP response buffer and reply address of the command being handled
 char responseBuffer[512];
+IPAddress replyIp;
+uint16_t replyPort = 0;
+int64_t replyRxUs = 0;             // When the command being handled arrived
+
+// Batch envelope ({"cmd":"batch","cmds":[...]}): the envelope is kept in
+// batchDoc while each entry is copied into jsonDoc and run; their replies
+// collect in batchReply (cmdTask only)
+#define BATCH_MAX_CMDS 8
+StaticJsonDocument<512> batchDoc;
+char batchReply[512];
+size_t batchReplyLen = 0;
+bool batchActive = false;
+
+// Sequence tracking for the command being handled (cmdTask only)
+SeqWindow seqWindow;
+bool currentHasSeq = false;
+uint16_t currentSeq = 0;
+bool currentCoalescable = false;   // Reply is a plain ACK that may be batched
+unsigned long lastHandledMs = 0;
+
+// Last reply, resent verbatim when its command is retransmitted
+uint8_t cachedReply[512];
+size_t cachedReplyLen = 0;
+uint16_t cachedReplySeq = 0;
+
+// Coalesced ACK state
+bool ackPending = false;
+bool ackBinary = false;
+unsigned long ackPendingSince = 0;
+
+// Telemetry subscriber (written by cmdTask, read by telemetryTask)
+IPAddress telemetryIp;
+uint16_t telemetryPort = 0;
+volatile bool telemetryBinary = false;
+volatile uint32_t telemetryPeriodMs = 0;    // 0 = not subscribed
+volatile int8_t cachedRssi = 0;             // WiFi.RSSI(), refreshed per heartbeat
+
+// Recorder download request (dump_recorder): cmdTask fills the fields,
+// then bumps dumpRequests; netTask picks up the range and sends it
+IPAddress dumpIp;
+uint16_t dumpPort = 0;
+uint32_t dumpFrom = 0;
+uint32_t dumpEnd = 0;
+std::atomic<uint32_t> dumpRequests{0};
+volatile bool dumpActive = false;
+
+// =============================================================================
+// Task Layout & Queues
+// =============================================================================
+//
+//   netTask  --rxQueue-->      cmdTask      (core 0)
+//   cmdTask  --txQueue-->      netTask      (core 0)
+//   cmdTask  --motionQueue-->  motionTask   (core 0 -> core 1)
+//   cmdTask  --segmentQueue--> motionTask   (queued path segments)
+//   telemetryTask --telemetryQueue--> netTask (pushed telemetry)
+//   cmdTask  --dumpRequests--> netTask      (recorder download range)
+//
+// Each queue has exactly one producer and one consumer, so no locks are
+// needed. motionTask is the only writer of step engine targets and pose.
+
+#define NET_CORE            0
+#define MOTION_CORE         1
+#define MOTION_PERIOD_MS    1
+#define UDP_PACKET_MAX      512
+#define SEGMENT_QUEUE_SIZE  32
+#define SEGMENT_LOOKAHEAD_MS 3    // Chain the next segment this early
+
+struct UdpPacket {
+  IPAddress ip;
+  uint16_t port;
+  uint16_t len;
+  int64_t rxUs;      // Local receive time (time_sync t1)
+  char data[UDP_PACKET_MAX];
+};
+
+enum MotionOp : uint8_t {
+  MOTION_MOVE,      // Relative move of left/right steps at speed
+  MOTION_STOP,      // Halt immediately and release coils
+  MOTION_PROFILE,   // Update max speed / acceleration (<= 0 keeps current)
+  MOTION_RESUME,    // Clear the emergency-stop latch
+  MOTION_QUEUE_CLEAR, // Drop queued segments (the running one finishes)
+  MOTION_VELOCITY   // Continuous left/right wheel speeds (steps/s, signed)
+};
+
+struct MotionCommand {
+  MotionOp op;
+  int32_t left;
+  int32_t right;
+  int32_t speed;
+  int32_t accel;
+  uint32_t segmentMark;   // segmentQueue head when issued (clear up to here)
+};
+
+// One queued path segment; consecutive segments are blended without a stop
+struct MotionSegment {
+  int32_t left;         // Relative steps
+  int32_t right;
+  int32_t speed;        // steps/s of the longer wheel
+};
+
+// Clamped move parameters, echoed in JSON and binary replies
+struct MoveResult {
+  long leftSteps;
+  long rightSteps;
+  int speed;        // steps/s
+};
+
+// Signed wheel speeds in steps/s (set_velocity)
+struct WheelVelocity {
+  long left;
+  long right;
+};
+
+SpscQueue<UdpPacket, 8> rxQueue;
+SpscQueue<UdpPacket, 8> txQueue;
+SpscQueue<UdpPacket, 4> telemetryQueue;
+SpscQueue<MotionCommand, 16> motionQueue;
+SpscQueue<MotionSegment, SEGMENT_QUEUE_SIZE> segmentQueue;
+
+TaskHandle_t cmdTaskHandle = nullptr;
+
+// Profiled sections (perf_profiler.h), reported by get_perf
+enum PerfId {
+  PERF_COMMAND,     // One packet in cmdTask: parse, handler and reply
+  PERF_PARSE,       // deserializeJson
+  PERF_MOTION,      // One motionTask pass
+  PERF_POSE,        // updatePose()
+  PERF_UDP_WRITE,   // One datagram: beginPacket .. endPacket
+  PERF_TELEMETRY,   // Building one pushed telemetry packet
+  PERF_COUNT
+};
+
+PerfSection perfSections[PERF_COUNT] = {
+  {"command",   0},
+  {"parse",     0},
+  {"motion",    MOTION_PERIOD_MS * 1000},
+  {"pose",      0},
+  {"udp_write", 0},
+  {"telemetry", 0},
+};
+
+// Owned by motionTask
+int profileAccel = DEFAULT_ACCEL;           // steps/s^2 of the faster wheel
+WheelVelocity velocitySetpoint = {0, 0};
+unsigned long lastVelocityMs = 0;
 
 // =============================================================================
 // Setup
@@ -118,16 +327,16 @@ char responseBuffer[512];
 void setup() {
   Serial.begin(115200);
   Serial.println("[Stepper] ESP32-S3 Stepper Controller V1");
+  perf_init();
 
   // Configure status LED
   pinMode(STATUS_LED, OUTPUT);
   digitalWrite(STATUS_LED, LOW);
 
-  // Configure motors
-  leftMotor.setMaxSpeed(MAX_SPEED_STEPS_S);
-  leftMotor.setAcceleration(DEFAULT_ACCEL);
-  rightMotor.setMaxSpeed(MAX_SPEED_STEPS_S);
-  rightMotor.setAcceleration(DEFAULT_ACCEL);
+  // Configure motors and start the step timer
+  step_channel_init(stepLeft, LEFT_PINS, MAX_SPEED_STEPS_S, DEFAULT_ACCEL);
+  step_channel_init(stepRight, RIGHT_PINS, MAX_SPEED_STEPS_S, DEFAULT_ACCEL);
+  step_engine_begin();
 
   // Connect to WiFi
   WiFi.mode(WIFI_STA);
@@ -153,11 +362,24 @@ void setup() {
     digitalWrite(STATUS_LED, LOW);
   }
 
+  // Full power until the host goes quiet; light sleep only while idle
+  power_init(true);
+
   // Start UDP listener
   udp.begin(UDP_PORT);
   Serial.printf("[Stepper] UDP listening on port %d\n", UDP_PORT);
 
   lastCommandTime = millis();
+  initCommandTable();
+
+  // Recorder before the tasks, so motionTask records from its first run
+  recorder_init();
+
+  // Start tasks: networking and parsing on core 0, motion on core 1
+  xTaskCreatePinnedToCore(motionTask, "motion", 4096, nullptr, 5, nullptr, MOTION_CORE);
+  xTaskCreatePinnedToCore(cmdTask, "cmd", 6144, nullptr, 2, &cmdTaskHandle, NET_CORE);
+  xTaskCreatePinnedToCore(netTask, "net", 6144, nullptr, 3, nullptr, NET_CORE);
+  xTaskCreatePinnedToCore(telemetryTask, "telemetry", 3072, nullptr, 1, nullptr, NET_CORE);
 }
 
 // =============================================================================
@@ -165,61 +387,337 @@ void setup() {
 // =============================================================================
 
 void loop() {
-  // 1. Check for incoming UDP commands
-  int packetSize = udp.parsePacket();
-  if (packetSize > 0) {
-    int len = udp.read(udpBuffer, sizeof(udpBuffer) - 1);
-    if (len > 0) {
-      udpBuffer[len] = '\0';
-      lastCommandTime = millis();
-      handleCommand(udpBuffer);
+  // All work runs in the pinned tasks started by setup()
+  vTaskDelete(nullptr);
+}
+
+// =============================================================================
+// Tasks
+// =============================================================================
+
+/**
+ * UDP receive and transmit (core 0). Received datagrams go to cmdTask;
+ * replies queued by cmdTask are sent from here so only one task touches
+ * the WiFiUDP object.
+ */
+void netTask(void* param) {
+  UdpPacket pkt;
+  uint32_t dumpSeen = 0;
+  uint32_t dumpNext = 0;
+  uint16_t dumpChunk = 0;
+
+  for (;;) {
+    bool received = false;
+    int packetSize = udp.parsePacket();
+    if (packetSize > 0) {
+      int len = udp.read(pkt.data, sizeof(pkt.data) - 1);
+      if (len > 0) {
+        pkt.data[len] = '\0';
+        pkt.len = len;
+        pkt.ip = udp.remoteIP();
+        pkt.port = udp.remotePort();
+        pkt.rxUs = timesync_local_us();
+        lastCommandTime = millis();
+        power_note_activity();
+        if (rxQueue.push(pkt)) {
+          xTaskNotifyGive(cmdTaskHandle);
+        }
+      }
+      received = true;
+    }
+
+    while (txQueue.pop(pkt) || telemetryQueue.pop(pkt)) {
+      PERF_SCOPE(perfSections[PERF_UDP_WRITE]);
+      udp.beginPacket(pkt.ip, pkt.port);
+      udp.write((const uint8_t*)pkt.data, pkt.len);
+      udp.endPacket();
+    }
+
+    // Recorder download: a new request replaces the running one
+    uint32_t requests = dumpRequests.load(std::memory_order_acquire);
+    if (requests != dumpSeen) {
+      dumpSeen = requests;
+      dumpNext = dumpFrom;
+      dumpChunk = 0;
+      dumpActive = true;
+    }
+    for (int burst = 0; dumpActive && burst < RECORDER_DUMP_BURST; burst++) {
+      if (!sendRecorderChunk(dumpNext, dumpChunk)) {
+        break;   // Stack out of buffers: retry this chunk next pass
+      }
+    }
+
+    // Keep draining bursts; otherwise yield (longer while idle only when
+    // light sleep can use the gap)
+    if (!received) {
+      TickType_t idleTicks = max((TickType_t)1, (TickType_t)pdMS_TO_TICKS(power_idle_poll_ms()));
+      vTaskDelay(power_is_idle() ? idleTicks : 1);
+    }
+  }
+}
+
+/**
+ * Command executor (core 0). Parses JSON or binary commands, turns them into motion
+ * commands for motionTask and formats the replies.
+ */
+void cmdTask(void* param) {
+  UdpPacket pkt;
+
+  for (;;) {
+    // Wake for new packets, or when a coalesced ACK is due
+    TickType_t wait = portMAX_DELAY;
+    if (ackPending) {
+      unsigned long elapsed = millis() - ackPendingSince;
+      wait = elapsed >= (unsigned long)ackCoalesceMs
+        ? 0 : pdMS_TO_TICKS(ackCoalesceMs - elapsed);
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
+
+    while (rxQueue.pop(pkt)) {
+      PERF_SCOPE(perfSections[PERF_COMMAND]);
+
+      // A gap longer than the host timeout means a new host session
+      if (millis() - lastHandledMs > HOST_TIMEOUT_MS) {
+        seq_reset(seqWindow);
+        cachedReplyLen = 0;
+      }
+      lastHandledMs = millis();
+
+      replyIp = pkt.ip;
+      replyPort = pkt.port;
+      replyRxUs = pkt.rxUs;
+      currentHasSeq = false;
+      currentCoalescable = false;
+      if ((uint8_t)pkt.data[0] == BIN_MAGIC) {
+        handleBinaryCommand((const uint8_t*)pkt.data, pkt.len);
+      } else {
+        handleCommand(pkt.data);
+      }
+    }
+
+    if (ackPending && millis() - ackPendingSince >= (unsigned long)ackCoalesceMs) {
+      flushAck();
     }
   }
+}
+
+/**
+ * Motion supervisor (core 1, highest priority). Applies queued motion
+ * commands, detects move completion, integrates odometry and enforces the
+ * host timeout. Step pulses themselves come from the step timer ISR.
+ */
+void motionTask(void* param) {
+  MotionCommand mc;
 
-  // 2. Run stepper motors (non-blocking)
-  if (!emergencyStopped) {
-    leftMotor.run();
-    rightMotor.run();
+  // Paced by the step timer: one latched step sample per period
+  step_engine_sample_every(xTaskGetCurrentTaskHandle(),
+                           STEP_TICK_HZ / 1000 * MOTION_PERIOD_MS);
 
-    // Check if motors have completed their moves
-    if (motorsRunning && leftMotor.distanceToGo() == 0 && rightMotor.distanceToGo() == 0) {
+  for (;;) {
+    uint32_t passStart = perf_cycles();
+
+    // 1. Apply commands from cmdTask, then start or chain queued segments
+    while (motionQueue.pop(mc)) {
+      applyMotionCommand(mc);
+    }
+    serviceSegments();
+    serviceVelocity();
+
+    // 2. Check if motors have completed their moves
+    if (motorsRunning && !segmentActive && !velocityMode &&
+        step_is_idle(stepLeft) && step_is_idle(stepRight)) {
       motorsRunning = false;
       disableMotorCoils();
     }
-  }
 
-  // 3. Update pose from encoder counts
-  updatePose();
+    // 3. Integrate odometry from the latched step counts
+    updatePose();
+    if (motorsRunning) {
+      recordWheels();
+    }
 
-  // 4. Safety: host timeout check
-  if (millis() - lastCommandTime > HOST_TIMEOUT_MS) {
-    if (!emergencyStopped) {
-      emergencyStop();
-      Serial.println("[Stepper] Host timeout — emergency stop!");
+    // 4. Safety: host timeout check
+    if (millis() - lastCommandTime > HOST_TIMEOUT_MS) {
+      if (!emergencyStopped) {
+        emergencyStop();
+        float values[1] = {(float)(millis() - lastCommandTime)};
+        recorder_write(REC_SAFETY, statusFlags(), 1, values, 1);   // 1 = host timeout
+        Serial.println("[Stepper] Host timeout — emergency stop!");
+      }
     }
+
+    perf_record_cycles(perfSections[PERF_MOTION], perf_cycles() - passStart);
+
+    // Timeout only guards against a stalled step timer
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MOTION_PERIOD_MS * 2));
   }
+}
+
+/**
+ * Status LED heartbeat, pushed telemetry and the idle power check (core 0,
+ * lowest priority). While subscribed, runs at the subscribed rate; the
+ * subscription lapses together with the host heartbeat (HOST_TIMEOUT_MS).
+ */
+void telemetryTask(void* param) {
+  TickType_t lastWake = xTaskGetTickCount();
+  unsigned long lastHeartbeat = 0;
+  uint16_t telemetrySeq = 0;
+
+  for (;;) {
+    unsigned long now = millis();
+    if (now - lastHeartbeat >= HEARTBEAT_INTERVAL) {
+      lastHeartbeat = now;
+      updateStatusLed();
+      cachedRssi = WiFi.RSSI();
+    }
 
-  // 5. Status LED heartbeat
-  if (millis() - lastHeartbeat > HEARTBEAT_INTERVAL) {
-    lastHeartbeat = millis();
-    if (emergencyStopped) {
-      // Fast blink when emergency stopped
-      digitalWrite(STATUS_LED, !digitalRead(STATUS_LED));
-    } else if (motorsRunning) {
-      digitalWrite(STATUS_LED, HIGH);
-    } else {
-      // Slow blink when idle
-      digitalWrite(STATUS_LED, (millis() / 1000) % 2 == 0 ? HIGH : LOW);
+    uint32_t period = telemetryPeriodMs;
+    if (period > 0) {
+      if (now - lastCommandTime > HOST_TIMEOUT_MS) {
+        telemetryPeriodMs = 0;
+        Serial.println("[Stepper] Host timeout — telemetry unsubscribed");
+      } else {
+        pushTelemetry(telemetrySeq++);
+      }
     }
+
+    // Anything moving, streaming or downloading keeps full power
+    power_update(motorsRunning || telemetryPeriodMs > 0 || dumpActive);
+
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(period > 0 ? period : TELEMETRY_IDLE_MS));
+  }
+}
+
+void updateStatusLed() {
+  if (emergencyStopped) {
+    // Fast blink when emergency stopped
+    digitalWrite(STATUS_LED, !digitalRead(STATUS_LED));
+  } else if (motorsRunning) {
+    digitalWrite(STATUS_LED, HIGH);
+  } else if (power_is_idle()) {
+    digitalWrite(STATUS_LED, LOW);
+  } else {
+    // Slow blink when idle
+    digitalWrite(STATUS_LED, (millis() / 1000) % 2 == 0 ? HIGH : LOW);
+  }
+}
+
+/**
+ * Build one telemetry packet (JSON, or a BIN_OP_TELEMETRY frame for binary
+ * subscribers) and hand it to netTask. Dropped if netTask falls behind.
+ */
+void pushTelemetry(uint16_t seq) {
+  PERF_SCOPE(perfSections[PERF_TELEMETRY]);
+  UdpPacket pkt;
+  pkt.ip = telemetryIp;
+  pkt.port = telemetryPort;
+
+  OdometrySample odom = odometrySnapshot();
+  uint8_t flags = statusFlags();
+
+  if (telemetryBinary) {
+    BinTelemetry t = {
+      odom.timeUs, odom.pose.x, odom.pose.y, odom.pose.heading,
+      odom.leftSteps, odom.rightSteps,
+      (int32_t)step_speed(stepLeft), (int32_t)step_speed(stepRight),
+      flags, cachedRssi
+    };
+    pkt.len = bin_build_frame((uint8_t*)pkt.data, BIN_OP_TELEMETRY, seq, &t, sizeof(t));
+  } else {
+    int n = snprintf(pkt.data, sizeof(pkt.data),
+      "{\"telemetry\":%u,\"us\":%lld,"
+      "\"pose\":[%.2f,%.2f,%.4f],\"steps\":[%ld,%ld],\"speed\":[%ld,%ld],"
+      "\"flags\":%u,\"rssi\":%d}",
+      seq, (long long)odom.timeUs,
+      odom.pose.x, odom.pose.y, odom.pose.heading,
+      (long)odom.leftSteps, (long)odom.rightSteps,
+      step_speed(stepLeft), step_speed(stepRight),
+      flags, cachedRssi);
+    pkt.len = min((size_t)n, sizeof(pkt.data) - 1);
+  }
+  telemetryQueue.push(pkt);
+}
+
+/**
+ * Send the recorder chunk starting at `next` to the dump requester (netTask
+ * only) and advance `next`; the empty chunk at the end of the range ends
+ * the download. Returns false if the datagram could not be sent.
+ */
+bool sendRecorderChunk(uint32_t& next, uint16_t& chunkSeq) {
+  RecordEntry records[BIN_RECORD_CHUNK_MAX];
+  uint32_t first = dumpEnd;
+  int count = 0;
+  if (next < dumpEnd) {
+    count = recorder_read(next, records, min((uint32_t)BIN_RECORD_CHUNK_MAX, dumpEnd - next), first);
+    // The ring may have moved past the range while it was being sent
+    count = first < dumpEnd ? min((uint32_t)count, dumpEnd - first) : 0;
+  }
+
+  uint8_t payload[sizeof(BinRecordChunk) + sizeof(records)];
+  BinRecordChunk chunk = {count > 0 ? first : dumpEnd, (uint8_t)count, sizeof(RecordEntry)};
+  memcpy(payload, &chunk, sizeof(chunk));
+  memcpy(payload + sizeof(chunk), records, count * sizeof(RecordEntry));
+
+  uint8_t frame[UDP_PACKET_MAX];
+  size_t len = bin_build_frame(frame, BIN_OP_RECORD_CHUNK, chunkSeq, payload,
+                               sizeof(chunk) + count * sizeof(RecordEntry));
+  udp.beginPacket(dumpIp, dumpPort);
+  udp.write(frame, len);
+  if (!udp.endPacket()) {
+    return false;
+  }
+
+  chunkSeq++;
+  if (count == 0) {
+    dumpActive = false;
+  } else {
+    next = first + count;
   }
+  return true;
 }
 
 // =============================================================================
 // Command Handler
 // =============================================================================
 
+// JSON commands, sorted by name (binary search); opcode 0 = JSON only
+constexpr CommandEntry COMMANDS[] = {
+  {"dump_recorder",       CMD_OPCODE_NONE,     CMD_FLAG_QUERY, cmdDumpRecorder},
+  {"get_perf",            CMD_OPCODE_NONE,     CMD_FLAG_QUERY, cmdGetPerf},
+  {"get_power",           CMD_OPCODE_NONE,     CMD_FLAG_QUERY, cmdGetPower},
+  {"get_recorder",        CMD_OPCODE_NONE,     CMD_FLAG_QUERY, cmdGetRecorder},
+  {"get_status",          BIN_OP_GET_STATUS,   CMD_FLAG_QUERY, cmdGetStatus},
+  {"move_cm",             BIN_OP_MOVE_CM,      0,              cmdMoveCm},
+  {"move_steps",          BIN_OP_MOVE_STEPS,   0,              cmdMoveSteps},
+  {"queue_clear",         BIN_OP_QUEUE_CLEAR,  0,              cmdQueueClear},
+  {"queue_move",          BIN_OP_QUEUE_MOVE,   0,              cmdQueueMove},
+  {"queue_status",        BIN_OP_QUEUE_STATUS, CMD_FLAG_QUERY, cmdQueueStatus},
+  {"rotate_deg",          BIN_OP_ROTATE_DEG,   0,              cmdRotateDeg},
+  {"set_config",          CMD_OPCODE_NONE,     0,              cmdSetConfig},
+  {"set_power",           CMD_OPCODE_NONE,     0,              cmdSetPower},
+  {"set_recorder",        CMD_OPCODE_NONE,     0,              cmdSetRecorder},
+  {"set_velocity",        BIN_OP_SET_VELOCITY, 0,              cmdSetVelocity},
+  {"stop",                BIN_OP_STOP,         0,              cmdStop},
+  {"subscribe_telemetry", BIN_OP_SUBSCRIBE,    0,              cmdSubscribeTelemetry},
+  {"time_sync",           BIN_OP_TIME_SYNC,    CMD_FLAG_QUERY, cmdTimeSync},
+};
+constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+static_assert(command_table_sorted(COMMANDS, COMMAND_COUNT), "COMMANDS must be sorted by name");
+
+// Handler time per command, JSON and binary alike (cmdTask only)
+CommandStats commandStats[COMMAND_COUNT] = {};
+int8_t commandOpcodes[CMD_OPCODE_SLOTS];
+
+void initCommandTable() {
+  command_index_opcodes(COMMANDS, COMMAND_COUNT, commandOpcodes);
+}
+
 void handleCommand(const char* json) {
-  DeserializationError error = deserializeJson(jsonDoc, json);
+  DeserializationError error;
+  {
+    PERF_SCOPE(perfSections[PERF_PARSE]);
+    error = deserializeJson(jsonDoc, json);
+  }
   if (error) {
     sendResponse("{\"error\":\"invalid_json\"}");
     return;
@@ -231,51 +729,206 @@ void handleCommand(const char* json) {
     return;
   }
 
-  // Reset emergency stop on any valid command
-  if (emergencyStopped && strcmp(cmd, "stop") != 0 && strcmp(cmd, "get_status") != 0) {
-    emergencyStopped = false;
-  }
-
-  if (strcmp(cmd, "move_steps") == 0) {
-    cmdMoveSteps();
-  } else if (strcmp(cmd, "move_cm") == 0) {
-    cmdMoveCm();
-  } else if (strcmp(cmd, "rotate_deg") == 0) {
-    cmdRotateDeg();
-  } else if (strcmp(cmd, "stop") == 0) {
-    cmdStop();
-  } else if (strcmp(cmd, "get_status") == 0) {
-    cmdGetStatus();
-  } else if (strcmp(cmd, "set_config") == 0) {
-    cmdSetConfig();
-  } else {
+  // Optional sequence number: skip duplicates, reject stale commands
+  if (jsonDoc.containsKey("seq")) {
+    currentHasSeq = true;
+    currentSeq = jsonDoc["seq"];
+    if (!admitSequence(false)) {
+      return;
+    }
+  }
+
+  if (strcmp(cmd, "batch") == 0) {
+    handleBatch();
+    return;
+  }
+
+  int index = command_find(COMMANDS, COMMAND_COUNT, cmd);
+  if (index < 0) {
     sendResponse("{\"error\":\"unknown_cmd\"}");
+    return;
+  }
+  runCommand(index);
+}
+
+void runCommand(int index) {
+  const CommandEntry& entry = COMMANDS[index];
+
+  // Reset emergency stop on any valid command
+  bool isQuery = entry.flags & CMD_FLAG_QUERY;
+  if (emergencyStopped && entry.handler != cmdStop && !isQuery) {
+    queueMotion(MOTION_RESUME, 0, 0, 0, 0);
+  }
+
+  // Everything except queries replies with a plain ACK that may be batched
+  currentCoalescable = !isQuery;
+
+  int64_t start = esp_timer_get_time();
+  entry.handler();
+  int64_t elapsed = esp_timer_get_time() - start;
+  command_record(commandStats[index], elapsed);
+
+  float values[2] = {(float)elapsed, currentHasSeq ? (float)currentSeq : -1.0f};
+  recorder_write_at((uint32_t)replyRxUs, REC_COMMAND, 0, index, values, 2);
+}
+
+/**
+ * {"cmd":"batch","cmds":[{...},{...}]}: validate every entry, then run
+ * them back to back within this packet and answer once with
+ * {"ok":true,"cmd":"batch","results":[...]}. An envelope "seq" covers
+ * the whole batch. If any entry is invalid, none is run.
+ */
+void handleBatch() {
+  batchDoc.set(jsonDoc);
+  JsonArray cmds = batchDoc["cmds"];
+  if (cmds.isNull() || cmds.size() == 0 || cmds.size() > BATCH_MAX_CMDS) {
+    currentCoalescable = false;
+    sendResponse("{\"error\":\"invalid_batch\"}");
+    return;
+  }
+
+  int indices[BATCH_MAX_CMDS];
+  int count = 0;
+  for (JsonObject entry : cmds) {
+    const char* cmd = entry["cmd"] | "";
+    int index = command_find(COMMANDS, COMMAND_COUNT, cmd);
+    if (index < 0) {
+      currentCoalescable = false;
+      snprintf(responseBuffer, sizeof(responseBuffer),
+        "{\"error\":\"unknown_cmd\",\"index\":%d}", count);
+      sendResponse(responseBuffer);
+      return;
+    }
+    indices[count++] = index;
+  }
+
+  batchReplyLen = snprintf(batchReply, sizeof(batchReply),
+    "{\"ok\":true,\"cmd\":\"batch\",\"results\":[");
+  batchActive = true;
+  for (int i = 0; i < count; i++) {
+    jsonDoc.set(cmds[i]);
+    runCommand(indices[i]);
+  }
+  batchActive = false;
+  appendBatchReply("]}", false);
+
+  // The combined reply carries results, never a plain ACK
+  currentCoalescable = false;
+  sendResponse(batchReply);
+}
+
+/**
+ * Add one entry's reply (or the closing bracket) to batchReply. Room is
+ * kept for the closing bracket and the "seq" tag; an entry that does not
+ * fit is replaced by an error.
+ */
+void appendBatchReply(const char* text, bool entry) {
+  const size_t reserve = entry ? 16 : 0;   // "]}" + ,"seq":65535
+  const char* sep = entry && batchReply[batchReplyLen - 1] != '[' ? "," : "";
+  size_t len = strlen(sep) + strlen(text);
+  if (batchReplyLen + len + reserve >= sizeof(batchReply)) {
+    if (!entry) {
+      return;
+    }
+    text = "{\"error\":\"reply_too_large\"}";
+    len = strlen(sep) + strlen(text);
+    if (batchReplyLen + len + reserve >= sizeof(batchReply)) {
+      return;
+    }
   }
+  batchReplyLen += snprintf(batchReply + batchReplyLen, sizeof(batchReply) - batchReplyLen,
+                            "%s%s", sep, text);
 }
 
 // =============================================================================
-// Command Implementations
+// Command Execution (shared by JSON and binary protocols)
 // =============================================================================
 
-void cmdMoveSteps() {
-  long leftSteps = jsonDoc["left"] | 0L;
-  long rightSteps = jsonDoc["right"] | 0L;
-  int speed = jsonDoc["speed"] | MAX_SPEED_STEPS_S;
-
+MoveResult clampMove(long leftSteps, long rightSteps, int speed) {
   // Safety clamp
   leftSteps = constrain(leftSteps, -MAX_CONTINUOUS_STEPS, MAX_CONTINUOUS_STEPS);
   rightSteps = constrain(rightSteps, -MAX_CONTINUOUS_STEPS, MAX_CONTINUOUS_STEPS);
   speed = constrain(speed, 1, maxSpeedStepsS);
+  return {leftSteps, rightSteps, speed};
+}
 
-  leftMotor.setMaxSpeed(speed);
-  rightMotor.setMaxSpeed(speed);
-  leftMotor.move(leftSteps);
-  rightMotor.move(rightSteps);
-  motorsRunning = true;
+MoveResult cmToSteps(float leftCm, float rightCm, float speedCmS) {
+  float k = stepsPerCm;
+  return {(long)(leftCm * k), (long)(rightCm * k), (int)(speedCmS * k)};
+}
+
+MoveResult execMoveSteps(long leftSteps, long rightSteps, int speed) {
+  MoveResult r = clampMove(leftSteps, rightSteps, speed);
+  queueMotion(MOTION_MOVE, r.leftSteps, r.rightSteps, r.speed, 0);
+  return r;
+}
+
+MoveResult execMoveCm(float leftCm, float rightCm, float speedCmS) {
+  MoveResult s = cmToSteps(leftCm, rightCm, speedCmS);
+  return execMoveSteps(s.leftSteps, s.rightSteps, s.speed);
+}
+
+/**
+ * Wheel steps for an in-place rotation, before the safety clamp.
+ */
+long rotateArcSteps(float degrees) {
+  // Arc length for in-place rotation: arc = (degrees/360) * PI * wheelBase
+  float arcCm = (degrees / 360.0f) * PI * wheelBaseCm;
+  return (long)(arcCm * stepsPerCm);
+}
+
+MoveResult execRotateDeg(float degrees, float speedCmS) {
+  long arcSteps = rotateArcSteps(degrees);
+  int speedSteps = (int)(speedCmS * stepsPerCm);
+
+  // Differential: left goes forward, right goes backward (or vice versa)
+  return execMoveSteps(arcSteps, -arcSteps, speedSteps);
+}
+
+/**
+ * Append a segment to the on-device path queue. Returns false if full.
+ */
+bool execQueueMove(const MoveResult& r) {
+  MotionSegment seg = {(int32_t)r.leftSteps, (int32_t)r.rightSteps, r.speed};
+  return segmentQueue.push(seg);
+}
+
+/**
+ * Convert a body velocity (cm/s, rad/s) to wheel speeds and hand it to
+ * motionTask. If either wheel would exceed max_speed, both are scaled
+ * down together so the turn radius is preserved.
+ */
+WheelVelocity execSetVelocity(float linearCmS, float angularRadS) {
+  float k = stepsPerCm;
+  float halfTrack = angularRadS * wheelBaseCm / 2.0f;
+  float left = (linearCmS - halfTrack) * k;
+  float right = (linearCmS + halfTrack) * k;
+
+  float fastest = max(fabsf(left), fabsf(right));
+  if (fastest > maxSpeedStepsS) {
+    left *= maxSpeedStepsS / fastest;
+    right *= maxSpeedStepsS / fastest;
+  }
+
+  WheelVelocity v = {lroundf(left), lroundf(right)};
+  queueMotion(MOTION_VELOCITY, v.left, v.right, 0, 0);
+  return v;
+}
+
+// =============================================================================
+// Command Implementations (JSON)
+// =============================================================================
+
+void cmdMoveSteps() {
+  long leftSteps = jsonDoc["left"] | 0L;
+  long rightSteps = jsonDoc["right"] | 0L;
+  int speed = jsonDoc["speed"] | MAX_SPEED_STEPS_S;
+
+  MoveResult r = execMoveSteps(leftSteps, rightSteps, speed);
 
   snprintf(responseBuffer, sizeof(responseBuffer),
     "{\"ok\":true,\"cmd\":\"move_steps\",\"left\":%ld,\"right\":%ld,\"speed\":%d}",
-    leftSteps, rightSteps, speed);
+    r.leftSteps, r.rightSteps, r.speed);
   sendResponse(responseBuffer);
 }
 
@@ -284,25 +937,11 @@ void cmdMoveCm() {
   float rightCm = jsonDoc["right_cm"] | 0.0f;
   float speedCmS = jsonDoc["speed"] | (WHEEL_CIRCUMFERENCE_CM * 2.0f);
 
-  float currentStepsPerCm = STEPS_PER_REV / (wheelDiameterCm * PI);
-  long leftSteps = (long)(leftCm * currentStepsPerCm);
-  long rightSteps = (long)(rightCm * currentStepsPerCm);
-  int speedSteps = (int)(speedCmS * currentStepsPerCm);
-
-  // Safety clamp
-  leftSteps = constrain(leftSteps, -MAX_CONTINUOUS_STEPS, MAX_CONTINUOUS_STEPS);
-  rightSteps = constrain(rightSteps, -MAX_CONTINUOUS_STEPS, MAX_CONTINUOUS_STEPS);
-  speedSteps = constrain(speedSteps, 1, maxSpeedStepsS);
-
-  leftMotor.setMaxSpeed(speedSteps);
-  rightMotor.setMaxSpeed(speedSteps);
-  leftMotor.move(leftSteps);
-  rightMotor.move(rightSteps);
-  motorsRunning = true;
+  MoveResult r = execMoveCm(leftCm, rightCm, speedCmS);
 
   snprintf(responseBuffer, sizeof(responseBuffer),
     "{\"ok\":true,\"cmd\":\"move_cm\",\"left_steps\":%ld,\"right_steps\":%ld}",
-    leftSteps, rightSteps);
+    r.leftSteps, r.rightSteps);
   sendResponse(responseBuffer);
 }
 
@@ -310,52 +949,138 @@ void cmdRotateDeg() {
   float degrees = jsonDoc["degrees"] | 0.0f;
   float speedCmS = jsonDoc["speed"] | (WHEEL_CIRCUMFERENCE_CM * 2.0f);
 
-  // Arc length for in-place rotation: arc = (degrees/360) * PI * wheelBase
-  float arcCm = (degrees / 360.0f) * PI * wheelBaseCm;
-  float currentStepsPerCm = STEPS_PER_REV / (wheelDiameterCm * PI);
-  long arcSteps = (long)(arcCm * currentStepsPerCm);
-  int speedSteps = (int)(speedCmS * currentStepsPerCm);
-
-  // Differential: left goes forward, right goes backward (or vice versa)
-  long leftSteps = constrain(arcSteps, -MAX_CONTINUOUS_STEPS, MAX_CONTINUOUS_STEPS);
-  long rightSteps = constrain(-arcSteps, -MAX_CONTINUOUS_STEPS, MAX_CONTINUOUS_STEPS);
-  speedSteps = constrain(speedSteps, 1, maxSpeedStepsS);
-
-  leftMotor.setMaxSpeed(speedSteps);
-  rightMotor.setMaxSpeed(speedSteps);
-  leftMotor.move(leftSteps);
-  rightMotor.move(rightSteps);
-  motorsRunning = true;
+  MoveResult r = execRotateDeg(degrees, speedCmS);
 
+  // arc_steps is the requested arc; clamped says MAX_CONTINUOUS_STEPS cut it
+  long arcSteps = rotateArcSteps(degrees);
   snprintf(responseBuffer, sizeof(responseBuffer),
-    "{\"ok\":true,\"cmd\":\"rotate_deg\",\"degrees\":%.1f,\"arc_steps\":%ld}",
-    degrees, arcSteps);
+    "{\"ok\":true,\"cmd\":\"rotate_deg\",\"degrees\":%.1f,\"arc_steps\":%ld,\"clamped\":%s}",
+    degrees, arcSteps, r.leftSteps != arcSteps ? "true" : "false");
   sendResponse(responseBuffer);
 }
 
 void cmdStop() {
-  leftMotor.stop();
-  rightMotor.stop();
-  leftMotor.setCurrentPosition(leftMotor.currentPosition());
-  rightMotor.setCurrentPosition(rightMotor.currentPosition());
-  motorsRunning = false;
-  disableMotorCoils();
+  queueMotion(MOTION_STOP, 0, 0, 0, 0);
 
   sendResponse("{\"ok\":true,\"cmd\":\"stop\"}");
 }
 
+void cmdQueueMove() {
+  MoveResult r;
+  if (jsonDoc.containsKey("left_cm") || jsonDoc.containsKey("right_cm")) {
+    r = cmToSteps(jsonDoc["left_cm"] | 0.0f, jsonDoc["right_cm"] | 0.0f,
+                  jsonDoc["speed"] | (WHEEL_CIRCUMFERENCE_CM * 2.0f));
+  } else {
+    r = {jsonDoc["left"] | 0L, jsonDoc["right"] | 0L, jsonDoc["speed"] | MAX_SPEED_STEPS_S};
+  }
+  r = clampMove(r.leftSteps, r.rightSteps, r.speed);
+
+  if (!execQueueMove(r)) {
+    currentCoalescable = false;
+    sendResponse("{\"error\":\"queue_full\"}");
+    return;
+  }
+
+  snprintf(responseBuffer, sizeof(responseBuffer),
+    "{\"ok\":true,\"cmd\":\"queue_move\",\"left_steps\":%ld,\"right_steps\":%ld,"
+    "\"pending\":%lu,\"free\":%lu}",
+    r.leftSteps, r.rightSteps,
+    (unsigned long)segmentQueue.size(),
+    (unsigned long)(SEGMENT_QUEUE_SIZE - segmentQueue.size()));
+  sendResponse(responseBuffer);
+}
+
+void cmdQueueClear() {
+  queueMotion(MOTION_QUEUE_CLEAR, 0, 0, 0, 0);
+
+  sendResponse("{\"ok\":true,\"cmd\":\"queue_clear\"}");
+}
+
+void cmdQueueStatus() {
+  snprintf(responseBuffer, sizeof(responseBuffer),
+    "{\"ok\":true,\"cmd\":\"queue_status\","
+    "\"pending\":%lu,\"capacity\":%d,\"active\":%s,\"completed\":%lu}",
+    (unsigned long)segmentQueue.size(), SEGMENT_QUEUE_SIZE,
+    segmentActive ? "true" : "false",
+    (unsigned long)segmentsCompleted);
+  sendResponse(responseBuffer);
+}
+
+void cmdSetVelocity() {
+  float linearCmS = jsonDoc["v"] | 0.0f;
+  float angularRadS = jsonDoc["omega"] | 0.0f;
+
+  WheelVelocity v = execSetVelocity(linearCmS, angularRadS);
+
+  snprintf(responseBuffer, sizeof(responseBuffer),
+    "{\"ok\":true,\"cmd\":\"set_velocity\",\"left_steps_s\":%ld,\"right_steps_s\":%ld}",
+    v.left, v.right);
+  sendResponse(responseBuffer);
+}
+
+/**
+ * Start (rate_hz > 0) or stop (rate_hz = 0) pushed telemetry to the sender.
+ * Returns the rate actually applied.
+ */
+int execSubscribeTelemetry(int rateHz, bool binary) {
+  rateHz = constrain(rateHz, 0, TELEMETRY_MAX_HZ);
+  telemetryPeriodMs = 0;
+  if (rateHz > 0) {
+    telemetryIp = replyIp;
+    telemetryPort = replyPort;
+    telemetryBinary = binary;
+    telemetryPeriodMs = max(1, 1000 / rateHz);
+  }
+  return rateHz;
+}
+
+void cmdSubscribeTelemetry() {
+  int rateHz = execSubscribeTelemetry(jsonDoc["rate_hz"] | 50, false);
+
+  snprintf(responseBuffer, sizeof(responseBuffer),
+    "{\"ok\":true,\"cmd\":\"subscribe_telemetry\",\"rate_hz\":%d}", rateHz);
+  sendResponse(responseBuffer);
+}
+
+/**
+ * One leg of the host's NTP-style exchange: reply with our receive (t1)
+ * and transmit (t2) times. With "offset_us", "rtt_us" and "at_us" the host
+ * also hands back the offset it computed from its best recent sample.
+ */
+void cmdTimeSync() {
+  if (jsonDoc.containsKey("offset_us")) {
+    timesync_update(jsonDoc["offset_us"].as<long long>(),
+                    jsonDoc["rtt_us"] | 0,
+                    jsonDoc["at_us"].as<long long>());
+  }
+
+  snprintf(responseBuffer, sizeof(responseBuffer),
+    "{\"ok\":true,\"cmd\":\"time_sync\",\"t1\":%lld,\"t2\":%lld,"
+    "\"synced\":%s,\"skew_ppm\":%.2f}",
+    (long long)replyRxUs, (long long)timesync_local_us(),
+    timesync_valid() ? "true" : "false", timeSync.skewPpm);
+  sendResponse(responseBuffer);
+}
+
 void cmdGetStatus() {
+  OdometrySample odom = odometrySnapshot();
   snprintf(responseBuffer, sizeof(responseBuffer),
     "{\"ok\":true,\"cmd\":\"get_status\","
     "\"pose\":{\"x\":%.2f,\"y\":%.2f,\"heading\":%.4f},"
     "\"steps\":{\"left\":%ld,\"right\":%ld},"
+    "\"time_us\":%lld,"
+    "\"time_synced\":%s,"
     "\"running\":%s,"
     "\"emergency\":%s,"
+    "\"overruns\":%lu,"
     "\"wifi_rssi\":%d}",
-    pose.x, pose.y, pose.heading,
-    leftMotor.currentPosition(), rightMotor.currentPosition(),
+    odom.pose.x, odom.pose.y, odom.pose.heading,
+    (long)odom.leftSteps, (long)odom.rightSteps,
+    (long long)odom.timeUs,
+    timesync_valid() ? "true" : "false",
     motorsRunning ? "true" : "false",
     emergencyStopped ? "true" : "false",
+    (unsigned long)perf_total_overruns(perfSections, PERF_COUNT),
     WiFi.RSSI());
   sendResponse(responseBuffer);
 }
@@ -363,54 +1088,686 @@ void cmdGetStatus() {
 void cmdSetConfig() {
   if (jsonDoc.containsKey("wheel_diameter_cm")) {
     wheelDiameterCm = jsonDoc["wheel_diameter_cm"];
+    updateKinematics();
   }
   if (jsonDoc.containsKey("wheel_base_cm")) {
     wheelBaseCm = jsonDoc["wheel_base_cm"];
+    updateKinematics();
   }
   if (jsonDoc.containsKey("max_speed")) {
     maxSpeedStepsS = constrain((int)jsonDoc["max_speed"], 1, 1024);
-    leftMotor.setMaxSpeed(maxSpeedStepsS);
-    rightMotor.setMaxSpeed(maxSpeedStepsS);
+    queueMotion(MOTION_PROFILE, 0, 0, maxSpeedStepsS, 0);
   }
   if (jsonDoc.containsKey("acceleration")) {
     int accel = constrain((int)jsonDoc["acceleration"], 1, 2048);
-    leftMotor.setAcceleration(accel);
-    rightMotor.setAcceleration(accel);
+    queueMotion(MOTION_PROFILE, 0, 0, 0, accel);
+  }
+  if (jsonDoc.containsKey("binary")) {
+    binaryEnabled = jsonDoc["binary"];
+  }
+  if (jsonDoc.containsKey("ack_coalesce_ms")) {
+    ackCoalesceMs = constrain((int)jsonDoc["ack_coalesce_ms"], 0, 1000);
+  }
+  if (jsonDoc["seq_reset"] | false) {
+    seq_reset(seqWindow);
+    cachedReplyLen = 0;
+  }
+
+  snprintf(responseBuffer, sizeof(responseBuffer),
+    "{\"ok\":true,\"cmd\":\"set_config\",\"binary\":%s,\"ack_coalesce_ms\":%d}",
+    binaryEnabled ? "true" : "false", ackCoalesceMs);
+  sendResponse(responseBuffer);
+}
+
+/**
+ * {"cmd":"get_perf","commands":bool,"reset":bool}: per-section timing as
+ * [n,min,mean,p50,p99,max,overruns] (us). With "commands" the reply lists
+ * per-command handler times as [n,mean,max] instead, to stay within one
+ * datagram. "reset" starts a new measurement after replying.
+ */
+void cmdGetPerf() {
+  bool commands = jsonDoc["commands"] | false;
+  const size_t reserve = 16;   // "}}" + ,"seq":65535
+  size_t size = sizeof(responseBuffer) - reserve;
+
+  int n = snprintf(responseBuffer, size, "{\"ok\":true,\"cmd\":\"get_perf\",\"cpu_mhz\":%lu,",
+                   (unsigned long)perfCpuMhz);
+  if (commands) {
+    n += snprintf(responseBuffer + n, size - n, "\"commands\":{");
+    n += command_format_stats(responseBuffer + n, size - n, COMMANDS, commandStats, COMMAND_COUNT);
+  } else {
+    n += snprintf(responseBuffer + n, size - n, "\"sections\":{");
+    n += perf_format(responseBuffer + n, size - n, perfSections, PERF_COUNT);
+  }
+  snprintf(responseBuffer + n, sizeof(responseBuffer) - n, "}}");
+  sendResponse(responseBuffer);
+
+  if (jsonDoc["reset"] | false) {
+    perf_reset(perfSections, PERF_COUNT);
+    memset(commandStats, 0, sizeof(commandStats));
+  }
+}
+
+void cmdGetPower() {
+  sendPowerStatus("get_power");
+}
+
+/**
+ * {"cmd":"set_power","enabled":bool,"idle_timeout_ms":N,"idle_cpu_mhz":80|160}:
+ * configure the idle state. Omitted fields keep their value.
+ */
+void cmdSetPower() {
+  power_configure(jsonDoc["enabled"] | power.enabled,
+                  jsonDoc["idle_timeout_ms"] | power.idleTimeoutMs,
+                  jsonDoc["idle_cpu_mhz"] | power.idleCpuMhz);
+  sendPowerStatus("set_power");
+}
+
+void sendPowerStatus(const char* cmd) {
+  const size_t size = sizeof(responseBuffer);
+  int n = snprintf(responseBuffer, size, "{\"ok\":true,\"cmd\":\"%s\",", cmd);
+  n += power_format(responseBuffer + n, size - n - 1);
+  snprintf(responseBuffer + n, size - n, "}");
+  sendResponse(responseBuffer);
+}
+
+void cmdGetRecorder() {
+  sendRecorderStatus("get_recorder");
+}
+
+/**
+ * {"cmd":"set_recorder","enabled":bool,"clear":bool}: start/stop recording
+ * and/or drop everything recorded so far.
+ */
+void cmdSetRecorder() {
+  if (jsonDoc["clear"] | false) {
+    recorder_clear();
+  }
+  if (jsonDoc.containsKey("enabled")) {
+    recorder_set_enabled(jsonDoc["enabled"] | false);
+  }
+  sendRecorderStatus("set_recorder");
+}
+
+/**
+ * {"cmd":"dump_recorder","from":N,"count":N}: reply with the range, then
+ * netTask sends it to this sender as BIN_OP_RECORD_CHUNK datagrams; a
+ * chunk with count 0 ends the download. Defaults to everything still
+ * recorded. Re-request a range to fill in datagrams lost on the way.
+ */
+void cmdDumpRecorder() {
+  if (!binaryEnabled) {
+    sendResponse("{\"error\":\"binary_disabled\"}");
+    return;
   }
 
-  sendResponse("{\"ok\":true,\"cmd\":\"set_config\"}");
+  uint32_t head = recorder_head();
+  uint32_t from = min(max((uint32_t)(jsonDoc["from"] | 0), recorder_oldest(head)), head);
+  uint32_t count = jsonDoc["count"] | (head - from);
+
+  dumpIp = replyIp;
+  dumpPort = replyPort;
+  dumpFrom = from;
+  dumpEnd = from + min(count, head - from);
+  dumpRequests.fetch_add(1, std::memory_order_release);
+
+  snprintf(responseBuffer, sizeof(responseBuffer),
+    "{\"ok\":true,\"cmd\":\"dump_recorder\",\"from\":%lu,\"to\":%lu,"
+    "\"records\":%lu,\"record_size\":%u,\"chunk_records\":%d}",
+    (unsigned long)dumpFrom, (unsigned long)dumpEnd, (unsigned long)(dumpEnd - dumpFrom),
+    (unsigned)sizeof(RecordEntry), BIN_RECORD_CHUNK_MAX);
+  sendResponse(responseBuffer);
+}
+
+void sendRecorderStatus(const char* cmd) {
+  uint32_t head = recorder_head();
+  uint32_t oldest = recorder_oldest(head);
+  snprintf(responseBuffer, sizeof(responseBuffer),
+    "{\"ok\":true,\"cmd\":\"%s\",\"enabled\":%s,\"psram\":%s,"
+    "\"capacity\":%lu,\"record_size\":%u,\"head\":%lu,\"oldest\":%lu,"
+    "\"available\":%lu,\"dumping\":%s}",
+    cmd, recorder.enabled ? "true" : "false", recorder.psram ? "true" : "false",
+    (unsigned long)recorder.capacity, (unsigned)sizeof(RecordEntry),
+    (unsigned long)head, (unsigned long)oldest, (unsigned long)(head - oldest),
+    dumpActive ? "true" : "false");
+  sendResponse(responseBuffer);
 }
 
 // =============================================================================
-// Pose Tracking (Differential Drive Odometry)
+// Binary Command Handler
 // =============================================================================
 
-void updatePose() {
-  long currentLeft = leftMotor.currentPosition();
-  long currentRight = rightMotor.currentPosition();
+void handleBinaryCommand(const uint8_t* frame, size_t len) {
+  BinHeader header = {};
+  const uint8_t* payload;
+  size_t payloadLen;
+  BinErrorCode err;
+
+  if (!bin_parse_frame(frame, len, header, payload, payloadLen, err)) {
+    sendBinaryError(header.seq, err);
+    return;
+  }
+  if (!binaryEnabled) {
+    sendBinaryError(header.seq, BIN_ERR_DISABLED);
+    return;
+  }
+
+  currentHasSeq = true;
+  currentSeq = header.seq;
+  if (!admitSequence(true)) {
+    return;
+  }
+  int index = command_find_opcode(commandOpcodes, header.opcode);
+  if (index < 0) {
+    sendBinaryError(header.seq, BIN_ERR_OPCODE);
+    return;
+  }
+  bool isQuery = COMMANDS[index].flags & CMD_FLAG_QUERY;
+  currentCoalescable = !isQuery;
+
+  // Reset emergency stop on any valid command
+  if (emergencyStopped && header.opcode != BIN_OP_STOP && !isQuery) {
+    queueMotion(MOTION_RESUME, 0, 0, 0, 0);
+  }
+
+  int64_t start = esp_timer_get_time();
+  execBinaryCommand(header, payload, payloadLen);
+  int64_t elapsed = esp_timer_get_time() - start;
+  command_record(commandStats[index], elapsed);
+
+  float values[2] = {(float)elapsed, (float)header.seq};
+  recorder_write_at((uint32_t)replyRxUs, REC_COMMAND, RECORD_FLAG_BINARY, index, values, 2);
+}
+
+/**
+ * Execute one validated, admitted binary command and send its reply.
+ */
+void execBinaryCommand(const BinHeader& header, const uint8_t* payload, size_t payloadLen) {
+  switch (header.opcode) {
+    case BIN_OP_MOVE_STEPS: {
+      BinMoveSteps req;
+      if (payloadLen != sizeof(req)) break;
+      memcpy(&req, payload, sizeof(req));
+      sendBinaryMoveAck(header, execMoveSteps(req.left, req.right, req.speed));
+      return;
+    }
+    case BIN_OP_MOVE_CM: {
+      BinMoveCm req;
+      if (payloadLen != sizeof(req)) break;
+      memcpy(&req, payload, sizeof(req));
+      sendBinaryMoveAck(header, execMoveCm(req.leftCm, req.rightCm, req.speedCmS));
+      return;
+    }
+    case BIN_OP_ROTATE_DEG: {
+      BinRotateDeg req;
+      if (payloadLen != sizeof(req)) break;
+      memcpy(&req, payload, sizeof(req));
+      sendBinaryMoveAck(header, execRotateDeg(req.degrees, req.speedCmS));
+      return;
+    }
+    case BIN_OP_STOP:
+      queueMotion(MOTION_STOP, 0, 0, 0, 0);
+      sendBinaryReply(header, nullptr, 0);
+      return;
+
+    case BIN_OP_QUEUE_MOVE: {
+      BinMoveSteps req;
+      if (payloadLen != sizeof(req)) break;
+      memcpy(&req, payload, sizeof(req));
+      if (!execQueueMove(clampMove(req.left, req.right, req.speed))) {
+        currentCoalescable = false;
+        sendBinaryError(header.seq, BIN_ERR_QUEUE_FULL);
+        return;
+      }
+      sendBinaryQueueStatus(header);
+      return;
+    }
+    case BIN_OP_QUEUE_CLEAR:
+      queueMotion(MOTION_QUEUE_CLEAR, 0, 0, 0, 0);
+      sendBinaryQueueStatus(header);
+      return;
+
+    case BIN_OP_QUEUE_STATUS:
+      sendBinaryQueueStatus(header);
+      return;
+
+    case BIN_OP_SET_VELOCITY: {
+      BinSetVelocity req;
+      if (payloadLen != sizeof(req)) break;
+      memcpy(&req, payload, sizeof(req));
+      WheelVelocity v = execSetVelocity(req.linearCmS, req.angularRadS);
+      BinVelocityAck ack = {(int32_t)v.left, (int32_t)v.right};
+      sendBinaryReply(header, &ack, sizeof(ack));
+      return;
+    }
+    case BIN_OP_SUBSCRIBE: {
+      BinSubscribe req;
+      if (payloadLen != sizeof(req)) break;
+      memcpy(&req, payload, sizeof(req));
+      req.rateHz = execSubscribeTelemetry(req.rateHz, true);
+      sendBinaryReply(header, &req, sizeof(req));
+      return;
+    }
+    case BIN_OP_TIME_SYNC: {
+      BinTimeSync req;
+      if (payloadLen != sizeof(req)) break;
+      memcpy(&req, payload, sizeof(req));
+      if (req.rttUs > 0) {
+        timesync_update(req.offsetUs, req.rttUs, req.atUs);
+      }
+      BinTimeSyncReply reply = {replyRxUs, timesync_local_us(),
+                                (uint8_t)(timesync_valid() ? 1 : 0)};
+      sendBinaryReply(header, &reply, sizeof(reply));
+      return;
+    }
+    case BIN_OP_GET_STATUS: {
+      OdometrySample odom = odometrySnapshot();
+      BinStatus status;
+      status.x = odom.pose.x;
+      status.y = odom.pose.y;
+      status.heading = odom.pose.heading;
+      status.leftSteps = odom.leftSteps;
+      status.rightSteps = odom.rightSteps;
+      status.flags = statusFlags();
+      status.rssi = (int8_t)WiFi.RSSI();
+      sendBinaryReply(header, &status, sizeof(status));
+      return;
+    }
+    default:
+      currentCoalescable = false;
+      sendBinaryError(header.seq, BIN_ERR_OPCODE);
+      return;
+  }
+
+  currentCoalescable = false;
+
+  // Known opcode with a payload of the wrong size
+  sendBinaryError(header.seq, BIN_ERR_LENGTH);
+}
+
+uint8_t statusFlags() {
+  return (motorsRunning ? BIN_STATUS_RUNNING : 0) |
+         (emergencyStopped ? BIN_STATUS_EMERGENCY : 0) |
+         (timesync_valid() ? BIN_STATUS_TIME_SYNCED : 0);
+}
+
+void sendBinaryReply(const BinHeader& request, const void* payload, size_t payloadLen) {
+  uint8_t frame[BIN_FRAME_MAX];
+  size_t len = bin_build_frame(frame, request.opcode | BIN_REPLY_FLAG, request.seq,
+                               payload, payloadLen);
+  sendResponseBytes(frame, len);
+}
+
+void sendBinaryMoveAck(const BinHeader& request, const MoveResult& r) {
+  BinMoveAck ack = {(int32_t)r.leftSteps, (int32_t)r.rightSteps, (int32_t)r.speed};
+  sendBinaryReply(request, &ack, sizeof(ack));
+}
+
+void sendBinaryQueueStatus(const BinHeader& request) {
+  BinQueueStatus status = {
+    (uint8_t)segmentQueue.size(), SEGMENT_QUEUE_SIZE,
+    (uint8_t)(segmentActive ? 1 : 0), segmentsCompleted
+  };
+  sendBinaryReply(request, &status, sizeof(status));
+}
+
+void sendBinaryError(uint16_t seq, BinErrorCode code) {
+  uint8_t frame[BIN_FRAME_MAX];
+  BinError error = {code};
+  size_t len = bin_build_frame(frame, BIN_OP_ERROR, seq, &error, sizeof(error));
+  sendResponseBytes(frame, len);
+}
+
+// =============================================================================
+// Sequence Numbers & ACKs
+// =============================================================================
+
+/**
+ * Check currentSeq against the window. Returns true if the command should
+ * execute; otherwise answers the duplicate or stale command itself.
+ */
+bool admitSequence(bool binary) {
+  switch (seq_accept(seqWindow, currentSeq)) {
+    case SEQ_NEW:
+      return true;
+
+    case SEQ_DUPLICATE:
+      // The reply was probably lost: resend it, or report the window
+      if (cachedReplyLen > 0 && cachedReplySeq == currentSeq) {
+        queueReply(cachedReply, cachedReplyLen);
+      } else {
+        sendAck(binary);
+      }
+      return false;
+
+    case SEQ_STALE:
+    default:
+      if (binary) {
+        sendBinaryError(currentSeq, BIN_ERR_STALE);
+      } else {
+        snprintf(responseBuffer, sizeof(responseBuffer),
+          "{\"error\":\"stale_seq\",\"seq\":%u}", currentSeq);
+        queueReply((const uint8_t*)responseBuffer, strlen(responseBuffer));
+      }
+      return false;
+  }
+}
+
+/**
+ * Send one ACK covering every command in the sequence window.
+ */
+void sendAck(bool binary) {
+  if (binary) {
+    uint8_t frame[BIN_FRAME_MAX];
+    BinAck ack = {seqWindow.highest, seqWindow.mask};
+    size_t len = bin_build_frame(frame, BIN_OP_ACK, seqWindow.highest, &ack, sizeof(ack));
+    queueReply(frame, len);
+  } else {
+    snprintf(responseBuffer, sizeof(responseBuffer),
+      "{\"ok\":true,\"ack\":%u,\"ack_mask\":%lu}",
+      seqWindow.highest, (unsigned long)seqWindow.mask);
+    queueReply((const uint8_t*)responseBuffer, strlen(responseBuffer));
+  }
+}
+
+void flushAck() {
+  ackPending = false;
+  sendAck(ackBinary);
+}
+
+// =============================================================================
+// Motion Commands (executed on motionTask)
+// =============================================================================
+
+/**
+ * Hand a motion command to motionTask. Called from cmdTask only.
+ */
+void queueMotion(MotionOp op, long left, long right, int speed, int accel) {
+  MotionCommand mc = {
+    op, (int32_t)left, (int32_t)right, speed, accel,
+    segmentQueue.head.load(std::memory_order_relaxed)
+  };
+  if (!motionQueue.push(mc)) {
+    Serial.println("[Stepper] Motion queue full — command dropped");
+  }
+}
+
+void applyMotionCommand(const MotionCommand& mc) {
+  switch (mc.op) {
+    case MOTION_MOVE:
+      // A direct move replaces any queued path or velocity stream
+      discardSegments(mc.segmentMark);
+      segmentActive = false;
+      velocityMode = false;
+      applySyncedProfile(mc.left, mc.right, mc.speed);
+      step_move(stepLeft, mc.left);
+      step_move(stepRight, mc.right);
+      motorsRunning = true;
+      break;
+
+    case MOTION_STOP:
+      discardSegments(mc.segmentMark);
+      segmentActive = false;
+      velocityMode = false;
+      step_halt(stepLeft);
+      step_halt(stepRight);
+      motorsRunning = false;
+      disableMotorCoils();
+      break;
+
+    case MOTION_PROFILE:
+      if (mc.speed > 0) {
+        step_set_max_speed(stepLeft, mc.speed);
+        step_set_max_speed(stepRight, mc.speed);
+      }
+      if (mc.accel > 0) {
+        profileAccel = mc.accel;
+        step_set_acceleration(stepLeft, mc.accel);
+        step_set_acceleration(stepRight, mc.accel);
+      }
+      break;
+
+    case MOTION_RESUME:
+      emergencyStopped = false;
+      break;
+
+    case MOTION_QUEUE_CLEAR:
+      discardSegments(mc.segmentMark);
+      break;
+
+    case MOTION_VELOCITY:
+      discardSegments(mc.segmentMark);
+      segmentActive = false;
+      lastVelocityMs = millis();
+      setVelocityTarget(mc.left, mc.right);
+      break;
+  }
+}
+
+/**
+ * Scale each wheel's acceleration by its share of the larger change, so
+ * both wheels finish ramping at the same moment.
+ */
+void syncAcceleration(long leftChange, long rightChange) {
+  long l = labs(leftChange);
+  long r = labs(rightChange);
+  long larger = max(l, r);
+  if (larger == 0) {
+    return;
+  }
+  step_set_acceleration(stepLeft, max(1L, (profileAccel * l + larger / 2) / larger));
+  step_set_acceleration(stepRight, max(1L, (profileAccel * r + larger / 2) / larger));
+}
+
+/**
+ * Give both wheels trapezoid profiles of the same duration: the longer
+ * move runs at `speed`, the shorter one at a proportionally lower cruise
+ * speed and acceleration. Keeps arcs on their curvature from start to stop.
+ */
+void applySyncedProfile(long left, long right, int speed) {
+  long l = labs(left);
+  long r = labs(right);
+  long longer = max(l, r);
+  if (longer == 0) {
+    return;
+  }
+  step_set_max_speed(stepLeft, max(1L, (speed * l + longer / 2) / longer));
+  step_set_max_speed(stepRight, max(1L, (speed * r + longer / 2) / longer));
+  syncAcceleration(left, right);
+}
+
+// =============================================================================
+// Velocity Mode (executed on motionTask)
+// =============================================================================
+
+void setVelocityTarget(long left, long right) {
+  syncAcceleration(left - step_speed(stepLeft), right - step_speed(stepRight));
+  velocitySetpoint = {left, right};
+  velocityMode = true;
+  motorsRunning = true;
+}
+
+/**
+ * Keep the wheel targets a short horizon ahead of the current setpoint.
+ * If the host stops streaming, ramp both wheels down together; once the
+ * setpoint is zero and both wheels are at rest, velocity mode ends.
+ */
+void serviceVelocity() {
+  if (!velocityMode) {
+    return;
+  }
+
+  bool moving = velocitySetpoint.left != 0 || velocitySetpoint.right != 0;
+  if (moving && millis() - lastVelocityMs > VELOCITY_TIMEOUT_MS) {
+    setVelocityTarget(0, 0);
+    moving = false;
+  }
+
+  step_set_velocity(stepLeft, velocitySetpoint.left,
+                    labs(velocitySetpoint.left) * VELOCITY_HORIZON_MS / 1000 + 1);
+  step_set_velocity(stepRight, velocitySetpoint.right,
+                    labs(velocitySetpoint.right) * VELOCITY_HORIZON_MS / 1000 + 1);
+
+  if (!moving && step_is_idle(stepLeft) && step_is_idle(stepRight)) {
+    velocityMode = false;
+  }
+}
+
+// =============================================================================
+// Motion Queue (executed on motionTask)
+// =============================================================================
+
+/**
+ * Drop queued segments pushed before `mark` (a segmentQueue head value).
+ * Segments queued after the clear command was issued are kept.
+ */
+void discardSegments(uint32_t mark) {
+  MotionSegment seg;
+  while ((int32_t)(mark - segmentQueue.tail.load(std::memory_order_relaxed)) > 0 &&
+         segmentQueue.pop(seg)) {
+  }
+}
+
+void startSegment(const MotionSegment& seg) {
+  applySyncedProfile(seg.left, seg.right, seg.speed);
+  step_extend(stepLeft, seg.left);
+  step_extend(stepRight, seg.right);
+  segmentActive = true;
+  motorsRunning = true;
+}
+
+/**
+ * A wheel can continue into the next segment without stopping if it is
+ * at rest, the next segment leaves it still, or it keeps its direction.
+ */
+bool canBlend(const StepChannel& ch, int32_t nextSteps) {
+  int dir = step_direction(ch);
+  return dir == 0 || nextSteps == 0 || (nextSteps > 0) == (dir > 0);
+}
+
+/**
+ * Start the next queued segment when the current one is about to begin
+ * braking, so the wheels carry their speed across the boundary. Direction
+ * reversals wait until both wheels have stopped.
+ */
+void serviceSegments() {
+  if (velocityMode) {
+    return;  // Queued segments wait until the velocity stream ends
+  }
+  bool idle = step_is_idle(stepLeft) && step_is_idle(stepRight);
+
+  if (!segmentActive && !idle) {
+    return;  // A direct move is still running
+  }
 
-  long deltaLeft = currentLeft - prevLeftSteps;
-  long deltaRight = currentRight - prevRightSteps;
+  if (segmentActive) {
+    if (!step_near_target(stepLeft, SEGMENT_LOOKAHEAD_MS) ||
+        !step_near_target(stepRight, SEGMENT_LOOKAHEAD_MS)) {
+      return;
+    }
+  }
 
-  if (deltaLeft == 0 && deltaRight == 0) return;
+  MotionSegment next;
+  if (!segmentQueue.peek(next)) {
+    if (segmentActive && idle) {
+      segmentActive = false;
+      segmentsCompleted++;
+    }
+    return;
+  }
 
-  float currentStepsPerCm = STEPS_PER_REV / (wheelDiameterCm * PI);
-  float leftDistCm = deltaLeft / currentStepsPerCm;
-  float rightDistCm = deltaRight / currentStepsPerCm;
+  if (!idle && !(canBlend(stepLeft, next.left) && canBlend(stepRight, next.right))) {
+    return;
+  }
 
-  float linearCm = (leftDistCm + rightDistCm) / 2.0f;
-  float angularRad = (rightDistCm - leftDistCm) / wheelBaseCm;
+  if (segmentActive) {
+    segmentsCompleted++;
+  }
+  segmentQueue.pop(next);
+  startSegment(next);
+}
 
-  pose.heading += angularRad;
-  // Normalize heading to [-PI, PI]
-  while (pose.heading > PI) pose.heading -= 2.0f * PI;
-  while (pose.heading < -PI) pose.heading += 2.0f * PI;
+// =============================================================================
+// Pose Tracking (Differential Drive Odometry)
+// =============================================================================
 
-  pose.x += linearCm * cos(pose.heading);
-  pose.y += linearCm * sin(pose.heading);
+/**
+ * Integrate one fixed-rate odometry step from the latched step counts and
+ * publish it. Over one sample the robot follows a circular arc, so the
+ * exact displacement is the chord d * sin(dθ/2) / (dθ/2) taken at the
+ * midpoint heading θ + dθ/2.
+ */
+void updatePose() {
+  PERF_SCOPE(perfSections[PERF_POSE]);
+  int32_t currentLeft, currentRight;
+  int64_t latchedUs;
+  step_engine_read_sample(currentLeft, currentRight, latchedUs);
 
+  int32_t deltaLeft = currentLeft - prevLeftSteps;
+  int32_t deltaRight = currentRight - prevRightSteps;
   prevLeftSteps = currentLeft;
   prevRightSteps = currentRight;
+
+  if (deltaLeft != 0 || deltaRight != 0) {
+    float k = cmPerStep;
+    float linearCm = (deltaLeft + deltaRight) * 0.5f * k;
+    float angularRad = (deltaRight - deltaLeft) * k * invWheelBase;
+
+    float half = 0.5f * angularRad;
+    float chordCm = fabsf(half) < 1e-4f ? linearCm : linearCm * sinf(half) / half;
+    float midHeading = pose.heading + half;
+    pose.x += chordCm * cosf(midHeading);
+    pose.y += chordCm * sinf(midHeading);
+
+    // One sample turns far less than PI, so a single wrap is enough
+    pose.heading += angularRad;
+    if (pose.heading > PI) {
+      pose.heading -= 2.0f * PI;
+    } else if (pose.heading < -PI) {
+      pose.heading += 2.0f * PI;
+    }
+
+    float values[5] = {pose.x, pose.y, pose.heading, (float)currentLeft, (float)currentRight};
+    recorder_write_at((uint32_t)latchedUs, REC_POSE, 0, 0, values, 5);
+  }
+
+  uint32_t next = odomSeq.load(std::memory_order_relaxed) + 1;
+  odomBuffers[next & 1] = {pose, currentLeft, currentRight, timesync_to_host(latchedUs)};
+  odomSeq.store(next, std::memory_order_release);
+}
+
+/**
+ * Record wheel speeds and remaining distance (motionTask, while running).
+ */
+void recordWheels() {
+  float values[4] = {
+    (float)step_speed(stepLeft), (float)step_speed(stepRight),
+    (float)step_distance_to_go(stepLeft), (float)step_distance_to_go(stepRight)
+  };
+  recorder_write(REC_MOTORS, statusFlags(), segmentQueue.size(), values, 4);
+}
+
+/**
+ * Tear-free copy of the latest published odometry, from any task.
+ */
+OdometrySample odometrySnapshot() {
+  OdometrySample snap;
+  uint32_t seq;
+  do {
+    seq = odomSeq.load(std::memory_order_acquire);
+    snap = odomBuffers[seq & 1];
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while (odomSeq.load(std::memory_order_relaxed) != seq);
+  return snap;
+}
+
+/**
+ * Recompute the cached conversion constants after a geometry change.
+ */
+void updateKinematics() {
+  stepsPerCm = STEPS_PER_REV / (wheelDiameterCm * PI);
+  cmPerStep = 1.0f / stepsPerCm;
+  invWheelBase = 1.0f / wheelBaseCm;
 }
 
 // =============================================================================
@@ -418,10 +1775,11 @@ void updatePose() {
 // =============================================================================
 
 void emergencyStop() {
-  leftMotor.stop();
-  rightMotor.stop();
-  leftMotor.setCurrentPosition(leftMotor.currentPosition());
-  rightMotor.setCurrentPosition(rightMotor.currentPosition());
+  discardSegments(segmentQueue.head.load(std::memory_order_acquire));
+  segmentActive = false;
+  velocityMode = false;
+  step_halt(stepLeft);
+  step_halt(stepRight);
   motorsRunning = false;
   emergencyStopped = true;
   disableMotorCoils();
@@ -429,18 +1787,58 @@ void emergencyStop() {
 
 void disableMotorCoils() {
   // Turn off all coils to save power (28BYJ-48 draws ~240mA when energized)
-  digitalWrite(LEFT_IN1, LOW);
-  digitalWrite(LEFT_IN2, LOW);
-  digitalWrite(LEFT_IN3, LOW);
-  digitalWrite(LEFT_IN4, LOW);
-  digitalWrite(RIGHT_IN1, LOW);
-  digitalWrite(RIGHT_IN2, LOW);
-  digitalWrite(RIGHT_IN3, LOW);
-  digitalWrite(RIGHT_IN4, LOW);
+  step_release(stepLeft);
+  step_release(stepRight);
+}
+
+/**
+ * Queue a reply to the sender of the current command; netTask transmits it.
+ */
+void queueReply(const uint8_t* data, size_t len) {
+  UdpPacket pkt;
+  pkt.ip = replyIp;
+  pkt.port = replyPort;
+  pkt.len = min(len, sizeof(pkt.data));
+  memcpy(pkt.data, data, pkt.len);
+  txQueue.push(pkt);
+}
+
+/**
+ * Reply to the current command. Sequenced replies are cached for
+ * retransmits, and plain ACKs are deferred when coalescing is enabled.
+ */
+void sendResponseBytes(const uint8_t* data, size_t len) {
+  if (currentHasSeq) {
+    if (ackCoalesceMs > 0 && currentCoalescable) {
+      if (!ackPending) {
+        ackPending = true;
+        ackPendingSince = millis();
+      }
+      ackBinary = data[0] == BIN_MAGIC;
+      cachedReplyLen = 0;
+      return;
+    }
+    cachedReplyLen = min(len, sizeof(cachedReply));
+    memcpy(cachedReply, data, cachedReplyLen);
+    cachedReplySeq = currentSeq;
+  }
+  queueReply(data, len);
 }
 
 void sendResponse(const char* response) {
-  udp.beginPacket(udp.remoteIP(), udp.remotePort());
-  udp.write((const uint8_t*)response, strlen(response));
-  udp.endPacket();
+  if (batchActive) {
+    appendBatchReply(response, true);
+    return;
+  }
+
+  size_t len = strlen(response);
+  if (!currentHasSeq || len == 0 || response[len - 1] != '}') {
+    sendResponseBytes((const uint8_t*)response, len);
+    return;
+  }
+
+  // Echo the sequence number: {...} -> {...,"seq":N}
+  char tagged[UDP_PACKET_MAX];
+  int n = snprintf(tagged, sizeof(tagged), "%.*s,\"seq\":%u}", (int)(len - 1), response, currentSeq);
+  sendResponseBytes((const uint8_t*)tagged, min((size_t)n, sizeof(tagged) - 1));
 }
@@ -0,0 +1,82 @@
+/**
+ * Command Sequence Window for ESP32-S3 Stepper Controller
+ *
+ * Tracks which 16-bit command sequence numbers have been executed, so
+ * retransmitted UDP commands are not executed twice and reordered ones
+ * still are. Same idea as an anti-replay window: `highest` is the newest
+ * sequence seen, bit i of `mask` means (highest - i) was seen.
+ *
+ * The (highest, mask) pair doubles as a coalesced ACK: one reply tells the
+ * host about the last SEQ_WINDOW_SIZE commands at once.
+ */
+
+#ifndef SEQ_WINDOW_H
+#define SEQ_WINDOW_H
+
+#include <Arduino.h>
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define SEQ_WINDOW_SIZE  32
+
+enum SeqStatus : uint8_t {
+  SEQ_NEW,        // Not seen before — execute it
+  SEQ_DUPLICATE,  // Already executed — do not execute again
+  SEQ_STALE       // Older than the window — cannot tell, reject
+};
+
+struct SeqWindow {
+  uint16_t highest;
+  uint32_t mask;
+  bool started;
+};
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+/**
+ * Forget all history, e.g. when a new host session starts.
+ */
+inline void seq_reset(SeqWindow& w) {
+  w.highest = 0;
+  w.mask = 0;
+  w.started = false;
+}
+
+/**
+ * Classify a received sequence number and record it if it is new.
+ * Wrap-around is handled with signed 16-bit distance.
+ */
+inline SeqStatus seq_accept(SeqWindow& w, uint16_t seq) {
+  if (!w.started) {
+    w.started = true;
+    w.highest = seq;
+    w.mask = 1;
+    return SEQ_NEW;
+  }
+
+  int16_t ahead = (int16_t)(seq - w.highest);
+  if (ahead > 0) {
+    w.mask = ahead >= SEQ_WINDOW_SIZE ? 0 : (w.mask << ahead);
+    w.mask |= 1;
+    w.highest = seq;
+    return SEQ_NEW;
+  }
+
+  uint16_t behind = (uint16_t)(-ahead);
+  if (behind >= SEQ_WINDOW_SIZE) {
+    return SEQ_STALE;
+  }
+
+  uint32_t bit = 1UL << behind;
+  if (w.mask & bit) {
+    return SEQ_DUPLICATE;
+  }
+  w.mask |= bit;
+  return SEQ_NEW;
+}
+
+#endif // SEQ_WINDOW_H
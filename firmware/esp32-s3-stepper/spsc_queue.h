@@ -0,0 +1,72 @@
+/**
+ * Lock-Free Single-Producer / Single-Consumer Queue
+ *
+ * Fixed-capacity ring buffer for passing messages between exactly two
+ * FreeRTOS tasks (possibly on different cores) without a mutex. The
+ * producer only writes `head`, the consumer only writes `tail`; acquire /
+ * release ordering publishes each slot before its index.
+ *
+ * Pair with a task notification (xTaskNotifyGive / ulTaskNotifyTake) when
+ * the consumer should block instead of polling.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+template <typename T, uint32_t N>
+struct SpscQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+  T slots[N];
+  std::atomic<uint32_t> head{0};  // Next slot to write (producer)
+  std::atomic<uint32_t> tail{0};  // Next slot to read (consumer)
+  uint32_t dropped = 0;           // Pushes rejected because the queue was full
+
+  /**
+   * Producer side. Returns false (and counts a drop) if the queue is full.
+   */
+  bool push(const T& item) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N) {
+      dropped++;
+      return false;
+    }
+    slots[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Consumer side. Returns false if the queue is empty.
+   */
+  bool pop(T& item) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = slots[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Consumer side. Copy the oldest item without removing it.
+   */
+  bool peek(T& item) const {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = slots[t & (N - 1)];
+    return true;
+  }
+
+  uint32_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+};
+
+#endif // SPSC_QUEUE_H
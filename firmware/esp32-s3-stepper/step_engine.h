@@ -0,0 +1,344 @@
+/**
+ * Step Engine for ESP32-S3 Stepper Controller
+ *
+ * Generates half-step sequences for two ULN2003 / 28BYJ-48 channels from a
+ * hardware timer interrupt, so step timing is independent of how long
+ * loop() spends in UDP receive, JSON parsing or response formatting.
+ *
+ * Features:
+ * - Fixed-rate timer tick (STEP_TICK_HZ) shared by both channels
+ * - Trapezoidal acceleration profile in integer fixed-point (no FPU in ISR)
+ * - Direct GPIO register writes for the coil phase patterns
+ * - AccelStepper-style move / halt / position semantics
+ * - Continuous velocity mode with a self-limiting target horizon
+ * - Periodic position sampling that wakes a task (fixed-rate odometry)
+ *
+ * All ULN2003 inputs must be on GPIO 0-31 (single W1TS/W1TC register).
+ */
+
+#ifndef STEP_ENGINE_H
+#define STEP_ENGINE_H
+
+#include <Arduino.h>
+#include "soc/gpio_reg.h"
+#include "esp_timer.h"
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define STEP_TICK_HZ       20000   // Step timer rate (50us resolution)
+#define STEP_TIMER_NUM     0       // Hardware timer group/index
+#define STEP_SPEED_SHIFT   16      // Speeds are Q16 steps/s
+#define STEP_MAX_RATE      (STEP_TICK_HZ / 2)
+
+// Phase accumulator wraps once per step: speed (Q16) summed every tick
+#define STEP_PHASE_WRAP    ((uint32_t)STEP_TICK_HZ << STEP_SPEED_SHIFT)
+
+struct StepChannel {
+  uint32_t phaseMask[8];     // GPIO set-mask for each half-step phase
+  uint32_t coilMask;         // All four coil pins of this channel
+  volatile int32_t position; // Current absolute position (steps)
+  volatile int32_t target;   // Absolute target position (steps)
+  volatile uint32_t speed;   // Current speed, Q16 steps/s
+  uint32_t maxSpeed;         // Cruise speed, Q16 steps/s
+  uint32_t accelPerTick;     // Speed change per tick, Q16 steps/s
+  uint32_t twoAccel;         // 2 * acceleration, steps/s^2 (stop distance)
+  uint32_t phaseAcc;         // Accumulates speed until STEP_PHASE_WRAP
+  int8_t dir;                // Current direction of travel (+1 / -1)
+  uint8_t phase;             // Current half-step phase (0-7)
+};
+
+static StepChannel stepLeft;
+static StepChannel stepRight;
+
+static hw_timer_t* stepTimer = nullptr;
+static portMUX_TYPE stepEngineMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Position sampling: every stepSampleTicks ticks the ISR latches both
+// positions and notifies stepSampleTask
+static TaskHandle_t stepSampleTask = nullptr;
+static uint32_t stepSampleTicks = 0;
+static uint32_t stepSampleCountdown = 0;
+static int32_t stepSampleLeft = 0;
+static int32_t stepSampleRight = 0;
+static int64_t stepSampleUs = 0;             // esp_timer time of the latch
+
+// ---------------------------------------------------------------------------
+// Timer ISR
+// ---------------------------------------------------------------------------
+
+/**
+ * Advance one channel by one timer tick: ramp the speed toward cruise or
+ * toward zero (if the remaining distance is within the stopping distance),
+ * then emit a step when the phase accumulator wraps.
+ */
+static inline void IRAM_ATTR step_channel_tick(StepChannel& ch) {
+  int32_t dist = ch.target - ch.position;
+
+  if (ch.speed == 0) {
+    if (dist == 0) {
+      return;
+    }
+    ch.dir = dist > 0 ? 1 : -1;
+  }
+
+  int32_t remaining = ch.dir > 0 ? dist : -dist;
+  if (remaining == 0) {
+    // Arrived — the ramp has brought speed down to (near) zero
+    ch.speed = 0;
+    ch.phaseAcc = 0;
+    return;
+  }
+
+  uint32_t s = ch.speed >> STEP_SPEED_SHIFT;
+  bool mustBrake = remaining < 0 || (s * s) / ch.twoAccel >= (uint32_t)remaining;
+
+  if (mustBrake) {
+    ch.speed = ch.speed > ch.accelPerTick ? ch.speed - ch.accelPerTick : 0;
+  } else if (ch.speed < ch.maxSpeed) {
+    ch.speed = min(ch.speed + ch.accelPerTick, ch.maxSpeed);
+  } else if (ch.speed > ch.maxSpeed) {
+    // Cruise speed was lowered mid-move: ramp down to it
+    ch.speed = max(ch.speed - ch.accelPerTick, ch.maxSpeed);
+  }
+
+  ch.phaseAcc += ch.speed;
+  if (ch.phaseAcc >= STEP_PHASE_WRAP) {
+    ch.phaseAcc -= STEP_PHASE_WRAP;
+    ch.position += ch.dir;
+    ch.phase = (ch.phase + ch.dir) & 7;
+    REG_WRITE(GPIO_OUT_W1TC_REG, ch.coilMask & ~ch.phaseMask[ch.phase]);
+    REG_WRITE(GPIO_OUT_W1TS_REG, ch.phaseMask[ch.phase]);
+  }
+}
+
+static void IRAM_ATTR step_engine_isr() {
+  bool sample = false;
+
+  portENTER_CRITICAL_ISR(&stepEngineMux);
+  step_channel_tick(stepLeft);
+  step_channel_tick(stepRight);
+  if (stepSampleTicks > 0 && --stepSampleCountdown == 0) {
+    stepSampleCountdown = stepSampleTicks;
+    stepSampleLeft = stepLeft.position;
+    stepSampleRight = stepRight.position;
+    stepSampleUs = esp_timer_get_time();
+    sample = true;
+  }
+  portEXIT_CRITICAL_ISR(&stepEngineMux);
+
+  if (sample && stepSampleTask != nullptr) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(stepSampleTask, &woken);
+    if (woken) {
+      portYIELD_FROM_ISR();
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+/**
+ * Set the cruise speed of a channel in steps/s. Takes effect on the next
+ * tick; a running move ramps to the new speed at the configured acceleration.
+ */
+inline void step_set_max_speed(StepChannel& ch, int stepsPerSec) {
+  uint32_t rate = constrain(stepsPerSec, 1, STEP_MAX_RATE);
+  portENTER_CRITICAL(&stepEngineMux);
+  ch.maxSpeed = rate << STEP_SPEED_SHIFT;
+  portEXIT_CRITICAL(&stepEngineMux);
+}
+
+/**
+ * Set the acceleration (and deceleration) of a channel in steps/s^2.
+ */
+inline void step_set_acceleration(StepChannel& ch, int stepsPerSec2) {
+  uint32_t accel = constrain(stepsPerSec2, 1, 65535);
+  uint32_t perTick = (accel << STEP_SPEED_SHIFT) / STEP_TICK_HZ;
+  portENTER_CRITICAL(&stepEngineMux);
+  ch.accelPerTick = perTick > 0 ? perTick : 1;
+  ch.twoAccel = 2 * accel;
+  portEXIT_CRITICAL(&stepEngineMux);
+}
+
+/**
+ * Configure a channel's coil pins (IN1..IN4 order) and default profile.
+ */
+inline void step_channel_init(StepChannel& ch, const uint8_t pins[4],
+                              int maxSpeed, int accel) {
+  // 28BYJ-48 half-step sequence: IN1, IN1+IN2, IN2, IN2+IN3, ...
+  static const uint8_t HALF_STEP[8] = {
+    0b0001, 0b0011, 0b0010, 0b0110, 0b0100, 0b1100, 0b1000, 0b1001
+  };
+
+  ch.coilMask = 0;
+  for (int i = 0; i < 4; i++) {
+    pinMode(pins[i], OUTPUT);
+    digitalWrite(pins[i], LOW);
+    ch.coilMask |= (1UL << pins[i]);
+  }
+  for (int p = 0; p < 8; p++) {
+    ch.phaseMask[p] = 0;
+    for (int i = 0; i < 4; i++) {
+      if (HALF_STEP[p] & (1 << i)) {
+        ch.phaseMask[p] |= (1UL << pins[i]);
+      }
+    }
+  }
+
+  ch.position = 0;
+  ch.target = 0;
+  ch.speed = 0;
+  ch.phaseAcc = 0;
+  ch.dir = 1;
+  ch.phase = 0;
+  step_set_max_speed(ch, maxSpeed);
+  step_set_acceleration(ch, accel);
+}
+
+/**
+ * Start the step timer. Call once in setup() after both channels are
+ * initialized.
+ */
+inline void step_engine_begin() {
+  stepTimer = timerBegin(STEP_TIMER_NUM, 80, true);  // 80 MHz APB / 80 = 1 MHz
+  timerAttachInterrupt(stepTimer, &step_engine_isr, true);
+  timerAlarmWrite(stepTimer, 1000000 / STEP_TICK_HZ, true);
+  timerAlarmEnable(stepTimer);
+}
+
+/**
+ * Latch both channel positions every `periodTicks` step ticks and notify
+ * `task` (which waits with ulTaskNotifyTake). Samples are exactly
+ * periodTicks / STEP_TICK_HZ apart regardless of task scheduling.
+ */
+inline void step_engine_sample_every(TaskHandle_t task, uint32_t periodTicks) {
+  portENTER_CRITICAL(&stepEngineMux);
+  stepSampleTask = task;
+  stepSampleTicks = periodTicks;
+  stepSampleCountdown = periodTicks;
+  portEXIT_CRITICAL(&stepEngineMux);
+}
+
+/**
+ * Read the most recent latched positions and when they were latched
+ * (esp_timer microseconds).
+ */
+inline void step_engine_read_sample(int32_t& left, int32_t& right, int64_t& latchedUs) {
+  portENTER_CRITICAL(&stepEngineMux);
+  left = stepSampleLeft;
+  right = stepSampleRight;
+  latchedUs = stepSampleUs;
+  portEXIT_CRITICAL(&stepEngineMux);
+}
+
+/**
+ * Queue a relative move, like AccelStepper::move(). Replaces any target
+ * currently in progress; the ramp continues from the current speed.
+ */
+inline void step_move(StepChannel& ch, long relativeSteps) {
+  portENTER_CRITICAL(&stepEngineMux);
+  ch.target = ch.position + relativeSteps;
+  portEXIT_CRITICAL(&stepEngineMux);
+}
+
+/**
+ * Move the target by `deltaSteps` relative to the current target rather
+ * than the current position. Used to chain segments without losing steps.
+ */
+inline void step_extend(StepChannel& ch, long deltaSteps) {
+  portENTER_CRITICAL(&stepEngineMux);
+  ch.target += deltaSteps;
+  portEXIT_CRITICAL(&stepEngineMux);
+}
+
+/**
+ * Run a channel continuously at a signed speed in steps/s. The target is
+ * kept `horizonSteps` beyond the current stopping distance, so the channel
+ * ramps to the new speed (or reverses) without resetting its profile and
+ * brakes to a stop on its own if it is not refreshed. 0 brakes to rest.
+ */
+inline void step_set_velocity(StepChannel& ch, long stepsPerSec, long horizonSteps) {
+  uint32_t rate = constrain(labs(stepsPerSec), 1L, (long)STEP_MAX_RATE);
+  portENTER_CRITICAL(&stepEngineMux);
+  uint32_t s = ch.speed >> STEP_SPEED_SHIFT;
+  long stopSteps = (long)((s * s) / ch.twoAccel) + 1;
+  if (stepsPerSec == 0) {
+    ch.target = ch.speed == 0 ? ch.position : ch.position + ch.dir * stopSteps;
+  } else {
+    ch.maxSpeed = rate << STEP_SPEED_SHIFT;
+    long ahead = stopSteps + horizonSteps;
+    ch.target = ch.position + (stepsPerSec > 0 ? ahead : -ahead);
+  }
+  portEXIT_CRITICAL(&stepEngineMux);
+}
+
+/**
+ * Stop a channel immediately (no deceleration) at its current position.
+ */
+inline void step_halt(StepChannel& ch) {
+  portENTER_CRITICAL(&stepEngineMux);
+  ch.target = ch.position;
+  ch.speed = 0;
+  ch.phaseAcc = 0;
+  portEXIT_CRITICAL(&stepEngineMux);
+}
+
+/**
+ * De-energize all four coils of a channel. Only meaningful while the
+ * channel is idle; the next step re-energizes the current phase.
+ */
+inline void step_release(StepChannel& ch) {
+  portENTER_CRITICAL(&stepEngineMux);
+  REG_WRITE(GPIO_OUT_W1TC_REG, ch.coilMask);
+  portEXIT_CRITICAL(&stepEngineMux);
+}
+
+inline long step_position(const StepChannel& ch) {
+  return ch.position;
+}
+
+inline long step_distance_to_go(const StepChannel& ch) {
+  return ch.target - ch.position;
+}
+
+/**
+ * Current signed speed in steps/s.
+ */
+inline long step_speed(const StepChannel& ch) {
+  long s = ch.speed >> STEP_SPEED_SHIFT;
+  return ch.dir > 0 ? s : -s;
+}
+
+/**
+ * Direction of travel while moving (+1 / -1), 0 when at rest.
+ */
+inline int step_direction(const StepChannel& ch) {
+  return ch.speed == 0 ? 0 : ch.dir;
+}
+
+/**
+ * True if the channel will start braking within `lookaheadMs`, i.e. the
+ * remaining distance is inside its stopping distance plus that margin.
+ */
+inline bool step_near_target(const StepChannel& ch, uint32_t lookaheadMs) {
+  uint32_t s = ch.speed >> STEP_SPEED_SHIFT;
+  uint32_t brakeSteps = (s * s) / ch.twoAccel + (s * lookaheadMs) / 1000 + 1;
+  long remaining = ch.target - ch.position;
+  if (remaining < 0) {
+    remaining = -remaining;
+  }
+  return (uint32_t)remaining <= brakeSteps;
+}
+
+/**
+ * True once the channel has reached its target and come to rest.
+ */
+inline bool step_is_idle(const StepChannel& ch) {
+  return ch.target == ch.position && ch.speed == 0;
+}
+
+#endif // STEP_ENGINE_H
@@ -0,0 +1,115 @@
+/**
+ * Host Time Sync for the Cube Robot Boards
+ *
+ * Puts every board on the host's microsecond clock so camera frames and
+ * odometry samples can be fused without guessing latency. The host is the
+ * time master and runs an NTP-style exchange:
+ *
+ *   host t0 --ping--> board t1 (receive) ... t2 (reply) --pong--> host t3
+ *
+ *   offset = ((t1 - t0) + (t2 - t3)) / 2      rtt = (t3 - t0) - (t2 - t1)
+ *
+ * The host repeats the ping a few times, keeps the sample with the lowest
+ * rtt and sends back the offset (local -> host). Between updates the board
+ * extrapolates with a measured skew, so periodic re-syncs every ~10 s keep
+ * the error near the rtt / 2 bound of the best sample.
+ *
+ * Identical copies live next to each sketch (Arduino only builds files in
+ * the sketch directory).
+ *
+ * Features:
+ * - Local clock is esp_timer (64-bit, 1 us, same clock as the camera driver)
+ * - Offset + skew (ppm) model, updated from host-computed samples
+ * - Tear-free reads from any task or core
+ */
+
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+
+// ---------------------------------------------------------------------------
+// Configuration & State
+// ---------------------------------------------------------------------------
+
+#define TIMESYNC_SKEW_MIN_S   5        // Shortest update gap used to estimate skew
+#define TIMESYNC_SKEW_GAIN    0.5f     // Weight of each new skew estimate
+#define TIMESYNC_MAX_SKEW_PPM 200.0f   // Crystals are specified far below this
+
+struct TimeSyncState {
+  int64_t offsetUs;      // host_us = local_us + offset at anchorUs
+  int64_t anchorUs;      // Local time the offset was measured
+  float skewPpm;         // Host clock rate relative to ours, minus one
+  uint32_t rttUs;        // Round trip of the sample behind the offset
+  uint32_t updates;
+  bool valid;
+};
+
+static TimeSyncState timeSync = {0, 0, 0.0f, 0, 0, false};
+static portMUX_TYPE timeSyncMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+inline int64_t timesync_local_us() {
+  return esp_timer_get_time();
+}
+
+/**
+ * Convert a local esp_timer timestamp to the host timebase. Before the
+ * first sync the local value is returned unchanged.
+ */
+inline int64_t timesync_to_host(int64_t localUs) {
+  portENTER_CRITICAL(&timeSyncMux);
+  TimeSyncState s = timeSync;
+  portEXIT_CRITICAL(&timeSyncMux);
+  if (!s.valid) {
+    return localUs;
+  }
+  int64_t drift = (int64_t)((localUs - s.anchorUs) * (double)s.skewPpm * 1e-6);
+  return localUs + s.offsetUs + drift;
+}
+
+inline int64_t timesync_now_us() {
+  return timesync_to_host(timesync_local_us());
+}
+
+inline bool timesync_valid() {
+  return timeSync.valid;
+}
+
+/**
+ * Apply an offset measured by the host at local time `anchorUs`. The
+ * error against the previous model's prediction, spread over the time
+ * since the previous anchor, refines the skew estimate.
+ */
+inline void timesync_update(int64_t offsetUs, uint32_t rttUs, int64_t anchorUs) {
+  portENTER_CRITICAL(&timeSyncMux);
+  TimeSyncState& s = timeSync;
+  int64_t elapsed = anchorUs - s.anchorUs;
+  if (s.valid && elapsed >= TIMESYNC_SKEW_MIN_S * 1000000LL) {
+    double predicted = s.offsetUs + elapsed * (double)s.skewPpm * 1e-6;
+    float correction = (float)((offsetUs - predicted) * 1e6 / elapsed);
+    s.skewPpm = constrain(s.skewPpm + TIMESYNC_SKEW_GAIN * correction,
+                          -TIMESYNC_MAX_SKEW_PPM, TIMESYNC_MAX_SKEW_PPM);
+  }
+  if (!s.valid || elapsed >= TIMESYNC_SKEW_MIN_S * 1000000LL || rttUs <= s.rttUs) {
+    // Keep close-together bursts from pulling the anchor to a worse sample
+    s.offsetUs = offsetUs;
+    s.anchorUs = anchorUs;
+    s.rttUs = rttUs;
+  }
+  s.updates++;
+  s.valid = true;
+  portEXIT_CRITICAL(&timeSyncMux);
+}
+
+inline void timesync_reset() {
+  portENTER_CRITICAL(&timeSyncMux);
+  timeSync = {0, 0, 0.0f, 0, 0, false};
+  portEXIT_CRITICAL(&timeSyncMux);
+}
+
+#endif // TIME_SYNC_H
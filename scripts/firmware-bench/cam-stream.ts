@@ -0,0 +1,245 @@
+/**
+ * Camera Stream Client
+ *
+ * Reads the camera's multipart MJPEG `/stream` and measures it per frame:
+ * arrival rate and jitter on the host, capture-interval jitter on the
+ * camera's own clock (X-Timestamp-Us), frames the camera skipped for this
+ * client (gaps in X-Frame-Seq), and grab / send times it reports.
+ */
+
+import * as http from 'http';
+import { IntervalSummary, LatencySummary, nowMs, round, summarize, summarizeIntervals } from './stats';
+
+/** One complete multipart part */
+export interface StreamPart {
+  headers: Record<string, string>;
+  bytes: number;
+}
+
+interface FrameRecord {
+  receivedMs: number;
+  seq: number;
+  captureMs: number;
+  bytes: number;
+  grabMs: number;
+  prevSendMs: number;
+}
+
+export interface StreamWindow {
+  startS: number;
+  frames: number;
+  fps: number;
+  arrivalMs: IntervalSummary;
+  skipped: number;
+}
+
+export interface StreamResult {
+  durationS: number;
+  firstFrameMs: number;
+  frames: number;
+  fps: number;
+  kbytesPerSecond: number;
+  /** Frames the camera published but did not send to this client */
+  skipped: number;
+  arrivalMs: IntervalSummary;
+  captureMs: IntervalSummary;
+  grabMs: LatencySummary;
+  sendMs: LatencySummary;
+  windowMs: number;
+  windows: StreamWindow[];
+  /** Why the stream ended early, if it did */
+  error: string | null;
+}
+
+/**
+ * Stream for `durationMs`, reporting a window every `windowMs` (0 = none).
+ */
+export function measureStream(
+  host: string,
+  port: number,
+  durationMs: number,
+  windowMs: number,
+  onWindow: (window: StreamWindow) => void = () => {}
+): Promise<StreamResult> {
+  return new Promise((resolve) => {
+    const frames: FrameRecord[] = [];
+    const windows: StreamWindow[] = [];
+    const start = nowMs();
+    let windowStartIndex = 0;
+    let windowStart = start;
+    let buffer = Buffer.alloc(0);
+    let error: string | null = null;
+    let finished = false;
+
+    const closeWindow = (now: number) => {
+      const slice = frames.slice(windowStartIndex);
+      if (slice.length > 0) {
+        const window: StreamWindow = {
+          startS: round((windowStart - start) / 1000, 1),
+          frames: slice.length,
+          fps: round(slice.length / ((now - windowStart) / 1000), 2),
+          arrivalMs: summarizeIntervals(slice.map((f) => f.receivedMs)),
+          skipped: countSkipped(slice),
+        };
+        windows.push(window);
+        onWindow(window);
+      }
+      windowStartIndex = frames.length;
+      windowStart = now;
+    };
+
+    const finish = () => {
+      if (finished) return;
+      finished = true;
+      clearTimeout(timer);
+      request.destroy();
+      const now = nowMs();
+      if (windowMs > 0) closeWindow(now);
+      resolve(buildResult(frames, start, now, windowMs, windows, error));
+    };
+
+    const parse = () => {
+      const { parts, rest } = splitParts(buffer);
+      buffer = rest;
+      for (const { headers, bytes } of parts) {
+        const received = nowMs();
+        frames.push({
+          receivedMs: received,
+          seq: Number(headers['x-frame-seq'] ?? 0),
+          captureMs: Number(headers['x-timestamp-us'] ?? 0) / 1000,
+          bytes,
+          grabMs: Number(headers['x-grab-us'] ?? 0) / 1000,
+          prevSendMs: Number(headers['x-prev-send-us'] ?? 0) / 1000,
+        });
+
+        if (windowMs > 0 && received - windowStart >= windowMs) {
+          closeWindow(received);
+        }
+      }
+    };
+
+    const request = http.get({ host, port, path: '/stream' }, (response) => {
+      if (response.statusCode !== 200) {
+        error = `HTTP ${response.statusCode}`;
+        finish();
+        return;
+      }
+      response.on('data', (chunk: Buffer) => {
+        buffer = buffer.length > 0 ? Buffer.concat([buffer, chunk]) : chunk;
+        parse();
+      });
+      response.on('end', () => {
+        error = error ?? 'stream closed by the camera';
+        finish();
+      });
+    });
+    request.on('error', (err) => {
+      error = err.message;
+      finish();
+    });
+    const timer = setTimeout(finish, durationMs);
+  });
+}
+
+/**
+ * GET a JSON endpoint (e.g. /status, /perf); null if it fails.
+ */
+export function fetchJson(host: string, port: number, path: string, timeoutMs = 3000): Promise<any> {
+  return new Promise((resolve) => {
+    const request = http.get({ host, port, path, timeout: timeoutMs }, (response) => {
+      let body = '';
+      response.setEncoding('utf8');
+      response.on('data', (chunk: string) => { body += chunk; });
+      response.on('end', () => {
+        try {
+          resolve(JSON.parse(body));
+        } catch {
+          resolve(null);
+        }
+      });
+    });
+    request.on('timeout', () => request.destroy());
+    request.on('error', () => resolve(null));
+  });
+}
+
+/**
+ * Split the complete parts off the front of a multipart stream buffer.
+ * Header blocks without a Content-Length (boundaries, preamble) are
+ * skipped; `rest` holds an incomplete part to prepend to the next chunk.
+ */
+export function splitParts(buffer: Buffer): { parts: StreamPart[]; rest: Buffer } {
+  const parts: StreamPart[] = [];
+  for (;;) {
+    const headerEnd = buffer.indexOf('\r\n\r\n');
+    if (headerEnd < 0) break;
+
+    const headers = parseHeaders(buffer.subarray(0, headerEnd).toString('latin1'));
+    const length = Number(headers['content-length']);
+    if (!Number.isFinite(length)) {
+      buffer = buffer.subarray(headerEnd + 4);   // Not a frame part
+      continue;
+    }
+    const bodyStart = headerEnd + 4;
+    if (buffer.length < bodyStart + length) break;
+
+    parts.push({ headers, bytes: length });
+    buffer = buffer.subarray(bodyStart + length);
+  }
+  return { parts, rest: buffer };
+}
+
+export function parseHeaders(block: string): Record<string, string> {
+  const headers: Record<string, string> = {};
+  for (const line of block.split('\r\n')) {
+    const colon = line.indexOf(':');
+    if (colon > 0) {
+      headers[line.slice(0, colon).trim().toLowerCase()] = line.slice(colon + 1).trim();
+    }
+  }
+  return headers;
+}
+
+/**
+ * Frames missing from a run of X-Frame-Seq numbers.
+ */
+export function countSkipped(frames: { seq: number }[]): number {
+  let skipped = 0;
+  for (let i = 1; i < frames.length; i++) {
+    const gap = frames[i].seq - frames[i - 1].seq;
+    if (gap > 1) skipped += gap - 1;
+  }
+  return skipped;
+}
+
+function buildResult(
+  frames: FrameRecord[],
+  start: number,
+  end: number,
+  windowMs: number,
+  windows: StreamWindow[],
+  error: string | null
+): StreamResult {
+  const streamS = frames.length > 1
+    ? (frames[frames.length - 1].receivedMs - frames[0].receivedMs) / 1000
+    : 0;
+  let bytes = 0;
+  for (const frame of frames) bytes += frame.bytes;
+
+  return {
+    durationS: round((end - start) / 1000, 1),
+    firstFrameMs: frames.length > 0 ? round(frames[0].receivedMs - start) : 0,
+    frames: frames.length,
+    fps: streamS > 0 ? round((frames.length - 1) / streamS, 2) : 0,
+    kbytesPerSecond: streamS > 0 ? round(bytes / 1024 / streamS, 1) : 0,
+    skipped: countSkipped(frames),
+    arrivalMs: summarizeIntervals(frames.map((f) => f.receivedMs)),
+    captureMs: summarizeIntervals(frames.map((f) => f.captureMs)),
+    grabMs: summarize(frames.map((f) => f.grabMs)),
+    // Each part reports the previous one's send time; the first has none
+    sendMs: summarize(frames.slice(1).map((f) => f.prevSendMs)),
+    windowMs,
+    windows,
+    error,
+  };
+}
@@ -0,0 +1,276 @@
+/**
+ * Firmware Benchmark & Soak CLI
+ *
+ * Usage:
+ *   node scripts/firmware-bench/dist/cli.js stepper --host 192.168.1.50
+ *   node scripts/firmware-bench/dist/cli.js fc --port /dev/ttyACM0
+ *   node scripts/firmware-bench/dist/cli.js cam --host 192.168.1.60 --duration 60
+ *
+ * --host takes an optional :port (defaults 4210 for the stepper, 80 for
+ * the camera).
+ *
+ * Common options:
+ *   --label <text>      Run label stored in the result (e.g. a git revision)
+ *   --out <file>        Result file (default bench-<target>-<time>.json)
+ *   --compare <file>    Baseline result; exit 1 on regressions
+ *   --tolerance <pct>   Allowed change before a metric regresses (10)
+ *   --soak <s>          Soak duration; 0 skips the soak phase (0)
+ *   --window <s>        Soak report window (60)
+ *
+ * stepper / fc options:
+ *   --latency-count <n> Closed-loop probes (500)
+ *   --rates <a,b,...>   Sweep rates in Hz
+ *   --step <s>          Seconds per sweep rate (5)
+ *   --timeout <ms>      Reply timeout (500)
+ *   --max-loss <pct>    Sweep pass criterion (1)
+ *   --max-p99 <ms>      Sweep pass criterion (50)
+ *   --soak-rate <hz>    Soak rate (half the max sustainable rate)
+ *
+ * fc options:
+ *   --baud <n>          Serial baud rate (115200)
+ *   --stream-rate <hz>  stream_sensors rate to measure; 0 skips (500)
+ *
+ * cam options:
+ *   --duration <s>      Stream duration when not soaking (30)
+ */
+
+import { FlightControllerLink, measureSensorStream } from './fc-serial';
+import { ProbeLink, RateResult, measureLatency, soak, sweepRate } from './load';
+import { BenchResult, BenchTarget, RESULT_FORMAT, compareResults, formatRegressions, readResult, writeResult } from './results';
+import { STEPPER_PORT, StepperLink } from './stepper-udp';
+import { StreamWindow, fetchJson, measureStream } from './cam-stream';
+import { round, sleep } from './stats';
+
+type Options = Record<string, string>;
+
+const DEFAULT_RATES: Record<string, number[]> = {
+  stepper: [50, 100, 200, 400, 800, 1600, 3200],
+  fc: [50, 100, 200, 400, 800, 1600],
+};
+
+function parseArgs(argv: string[]): { target: string; options: Options } {
+  const [target, ...rest] = argv;
+  const options: Options = {};
+  for (let i = 0; i < rest.length; i++) {
+    const arg = rest[i];
+    if (!arg.startsWith('--')) throw new Error(`Unexpected argument: ${arg}`);
+    const value = rest[i + 1];
+    if (value === undefined || value.startsWith('--')) {
+      options[arg.slice(2)] = 'true';
+    } else {
+      options[arg.slice(2)] = value;
+      i++;
+    }
+  }
+  return { target, options };
+}
+
+function num(options: Options, key: string, fallback: number): number {
+  if (options[key] === undefined) return fallback;
+  const value = Number(options[key]);
+  if (!Number.isFinite(value)) throw new Error(`--${key} must be a number`);
+  return value;
+}
+
+function required(options: Options, key: string): string {
+  const value = options[key];
+  if (!value || value === 'true') throw new Error(`--${key} is required`);
+  return value;
+}
+
+function hostPort(options: Options, defaultPort: number): { host: string; port: number } {
+  const [host, port] = required(options, 'host').split(':');
+  return { host, port: port ? Number(port) : defaultPort };
+}
+
+function logRate(prefix: string): (step: RateResult) => void {
+  return (step) => console.log(
+    `[Bench] ${prefix} ${step.targetHz > 0 ? `${step.targetHz} Hz` : 'closed loop'}: sent ${step.sentHz}/s, received ${step.receivedHz}/s, ` +
+    `loss ${step.lossPct}%, p50 ${step.rttMs.p50} ms, p99 ${step.rttMs.p99} ms`
+  );
+}
+
+/**
+ * Latency, rate sweep and optional soak over any probe link.
+ */
+async function runProbePhases(
+  link: ProbeLink,
+  target: string,
+  options: Options,
+  phases: Record<string, unknown>,
+  metrics: Record<string, number>
+): Promise<void> {
+  const timeoutMs = num(options, 'timeout', 500);
+
+  console.log('[Bench] Closed-loop latency...');
+  const latency = await measureLatency(link, num(options, 'latency-count', 500), timeoutMs);
+  logRate('latency')(latency);
+  phases.latency = latency;
+  metrics.rtt_p50_ms = latency.rttMs.p50;
+  metrics.rtt_p99_ms = latency.rttMs.p99;
+  metrics.latency_loss_pct = latency.lossPct;
+
+  console.log('[Bench] Rate sweep...');
+  const rates = options.rates
+    ? options.rates.split(',').map(Number)
+    : DEFAULT_RATES[target];
+  const sweep = await sweepRate(link, rates, num(options, 'step', 5) * 1000, timeoutMs, {
+    maxLossPct: num(options, 'max-loss', 1),
+    maxP99Ms: num(options, 'max-p99', 50),
+  }, logRate('sweep'));
+  phases.sweep = sweep;
+  metrics.max_sustainable_hz = sweep.maxSustainableHz;
+  console.log(`[Bench] Max sustainable rate: ${sweep.maxSustainableHz} Hz`);
+
+  const soakS = num(options, 'soak', 0);
+  if (soakS > 0) {
+    const rate = num(options, 'soak-rate', Math.max(10, Math.floor(sweep.maxSustainableHz / 2)));
+    console.log(`[Bench] Soak at ${rate} Hz for ${soakS} s...`);
+    const result = await soak(link, rate, soakS * 1000, num(options, 'window', 60) * 1000,
+      timeoutMs, logRate('soak'));
+    phases.soak = result;
+    metrics.soak_rtt_p99_ms = result.overall.rttMs.p99;
+    metrics.soak_loss_pct = result.overall.lossPct;
+  }
+  phases.unmatchedReplies = link.unmatched();
+}
+
+async function benchStepper(options: Options, result: BenchResult): Promise<void> {
+  const { host, port } = hostPort(options, STEPPER_PORT);
+  result.endpoint = `udp://${host}:${port}`;
+  const link = await StepperLink.open(host, port);
+  try {
+    await link.devicePerf(true);
+    await runProbePhases(link, 'stepper', options, result.phases, result.metrics);
+
+    const status = await link.request({ cmd: 'get_status' }, 1000);
+    if (status) result.metrics.device_overruns = status.body.overruns ?? 0;
+    result.devicePerf = await link.devicePerf(false);
+  } finally {
+    link.close();
+  }
+}
+
+async function benchFlightController(options: Options, result: BenchResult): Promise<void> {
+  const port = required(options, 'port');
+  result.endpoint = `serial://${port}`;
+  const link = await FlightControllerLink.open(port, num(options, 'baud', 115200));
+  try {
+    const info = await link.request({ action: 'get_info' }, 1000);
+    result.firmware = info?.body.firmware ?? null;
+    const txDroppedBefore = info?.body.tx_dropped ?? 0;
+    await link.devicePerf(true);
+
+    await runProbePhases(link, 'fc', options, result.phases, result.metrics);
+
+    const streamRate = num(options, 'stream-rate', 500);
+    if (streamRate > 0) {
+      console.log(`[Bench] Sensor stream at ${streamRate} Hz...`);
+      await sleep(500);   // Let the last sweep replies drain
+      const stream = await measureSensorStream(link, streamRate, num(options, 'step', 5) * 1000);
+      console.log(`[Bench] stream: ${stream.receivedHz} Hz, ${stream.missedSlots} missed slots, ` +
+        `arrival jitter ${stream.arrivalMs.jitter} ms`);
+      result.phases.sensorStream = stream;
+      result.metrics.sensor_stream_hz = stream.receivedHz;
+      result.metrics.sensor_stream_missed_pct = stream.frames > 0
+        ? round((stream.missedSlots / (stream.frames + stream.missedSlots)) * 100, 2)
+        : 100;
+      result.metrics.sensor_arrival_p99_ms = stream.arrivalMs.p99;
+    }
+
+    const after = await link.request({ action: 'get_info' }, 1000);
+    if (after) {
+      result.metrics.device_overruns = after.body.perf_overruns ?? 0;
+      result.metrics.tx_dropped = (after.body.tx_dropped ?? 0) - txDroppedBefore;
+    }
+    result.devicePerf = await link.devicePerf(false);
+  } finally {
+    await link.close();
+  }
+}
+
+async function benchCamera(options: Options, result: BenchResult): Promise<void> {
+  const { host, port } = hostPort(options, 80);
+  result.endpoint = `http://${host}:${port}/stream`;
+  await fetchJson(host, port, '/perf?reset=1');
+
+  const soakS = num(options, 'soak', 0);
+  const durationS = soakS > 0 ? soakS : num(options, 'duration', 30);
+  const windowMs = soakS > 0 ? num(options, 'window', 60) * 1000 : 0;
+  console.log(`[Bench] Streaming for ${durationS} s...`);
+  const stream = await measureStream(host, port, durationS * 1000, windowMs, (window: StreamWindow) => {
+    console.log(`[Bench] window @${window.startS} s: ${window.fps} fps, ` +
+      `p99 gap ${window.arrivalMs.p99} ms, ${window.skipped} skipped`);
+  });
+  if (stream.error) console.warn(`[Bench] Stream ended early: ${stream.error}`);
+  console.log(`[Bench] stream: ${stream.fps} fps, jitter ${stream.arrivalMs.jitter} ms, ` +
+    `${stream.skipped} skipped, ${stream.kbytesPerSecond} KB/s`);
+
+  result.phases.stream = stream;
+  result.metrics.stream_fps = stream.fps;
+  result.metrics.first_frame_ms = stream.firstFrameMs;
+  result.metrics.stream_arrival_p99_ms = stream.arrivalMs.p99;
+  result.metrics.stream_jitter_ms = stream.arrivalMs.jitter;
+  result.metrics.capture_jitter_ms = stream.captureMs.jitter;
+  result.metrics.stream_skipped_pct = stream.frames > 0
+    ? round((stream.skipped / (stream.frames + stream.skipped)) * 100, 2)
+    : 100;
+
+  const status = await fetchJson(host, port, '/status');
+  if (status) result.metrics.device_overruns = status.perf_overruns ?? 0;
+  result.phases.status = status;
+  result.devicePerf = await fetchJson(host, port, '/perf');
+}
+
+async function main(): Promise<number> {
+  const { target, options } = parseArgs(process.argv.slice(2));
+  const runners: Record<BenchTarget, (o: Options, r: BenchResult) => Promise<void>> = {
+    stepper: benchStepper,
+    fc: benchFlightController,
+    cam: benchCamera,
+  };
+  if (!(target in runners)) {
+    console.error('Usage: cli.js <stepper|fc|cam> [options] (see the header of cli.ts)');
+    return 2;
+  }
+
+  const started = new Date();
+  const result: BenchResult = {
+    format: RESULT_FORMAT,
+    target: target as BenchTarget,
+    label: options.label ?? '',
+    firmware: null,
+    endpoint: '',
+    startedAt: started.toISOString(),
+    durationS: 0,
+    options,
+    metrics: {},
+    phases: {},
+    devicePerf: null,
+  };
+
+  await runners[target as BenchTarget](options, result);
+  result.durationS = round((Date.now() - started.getTime()) / 1000, 1);
+
+  const out = options.out ?? `bench-${target}-${started.toISOString().replace(/[:.]/g, '-')}.json`;
+  writeResult(out, result);
+  console.log(`[Bench] Results written to ${out}`);
+  console.log(JSON.stringify(result.metrics, null, 2));
+
+  if (options.compare) {
+    const baseline = readResult(options.compare);
+    const regressions = compareResults(baseline, result, num(options, 'tolerance', 10));
+    console.log(`[Bench] Compared with ${options.compare} (${baseline.label || baseline.startedAt}):`);
+    console.log(formatRegressions(regressions));
+    if (regressions.length > 0) return 1;
+  }
+  return 0;
+}
+
+main().then(
+  (code) => process.exit(code),
+  (error) => {
+    console.error('[Bench] Failed:', error instanceof Error ? error.message : error);
+    process.exit(2);
+  }
+);
@@ -0,0 +1,243 @@
+/**
+ * Flight Controller Serial Link
+ *
+ * Drives the flight controller's newline-delimited JSON protocol over USB
+ * CDC. Probes are `get_motors` queries, which never arm or spin anything.
+ *
+ * JSON replies carry no request id, but the firmware answers strictly in
+ * order with exactly one line per command (an oversized reply becomes a
+ * "Reply too large" error), so replies are matched first-in first-out. A
+ * line lost or garbled on the link would still shift that matching, so
+ * after a timeout the link stops probing until the line has been quiet for
+ * RESYNC_QUIET_MS and then starts matching afresh.
+ *
+ * Uses the optional `serialport` dependency, like the Electron serial
+ * manager.
+ */
+
+import { ProbeLink } from './load';
+import { IntervalSummary, nowMs, round, sleep, summarizeIntervals } from './stats';
+
+const RESYNC_QUIET_MS = 100;
+
+interface SerialPortLike {
+  write(data: string, callback?: (err: Error | null | undefined) => void): boolean;
+  close(callback?: (err: Error | null) => void): void;
+  on(event: string, callback: (...args: any[]) => void): this;
+}
+
+interface Pending {
+  sentAt: number;
+  timer: NodeJS.Timeout | null;
+  resolve: (reply: { rtt: number; body: any } | null) => void;
+}
+
+export interface StreamFrame {
+  receivedMs: number;
+  body: any;
+}
+
+export class FlightControllerLink implements ProbeLink {
+  private port: SerialPortLike;
+  private pending: Pending[] = [];
+  private lineBuffer = '';
+  private lastLineMs = 0;
+  private resyncing = false;
+  private unmatchedReplies = 0;
+  private onStreamFrame: ((frame: StreamFrame) => void) | null = null;
+
+  /** Most probes kept in flight; the firmware reads one line at a time */
+  maxInFlight = 4;
+
+  private constructor(port: SerialPortLike) {
+    this.port = port;
+    this.port.on('data', (data: Buffer) => this.onData(data));
+  }
+
+  static async open(path: string, baudRate = 115200): Promise<FlightControllerLink> {
+    let SerialPort: any;
+    try {
+      SerialPort = (await import('serialport')).SerialPort;
+    } catch {
+      throw new Error('SerialPort module not available. Install with: npm install serialport');
+    }
+
+    const port: SerialPortLike = new SerialPort({ path, baudRate, autoOpen: true });
+    await new Promise<void>((resolve, reject) => {
+      port.on('open', () => resolve());
+      port.on('error', (err: Error) => reject(err));
+      setTimeout(() => reject(new Error(`Timed out opening ${path}`)), 5000);
+    });
+
+    // Let the boot banner and anything queued for a previous host pass
+    const link = new FlightControllerLink(port);
+    await sleep(300);
+    return link;
+  }
+
+  /**
+   * Send one command line and wait for its reply, in order.
+   */
+  request(command: Record<string, unknown>, timeoutMs: number): Promise<{ rtt: number; body: any } | null> {
+    if (this.resyncing) {
+      return Promise.resolve(null);
+    }
+
+    return new Promise((resolve) => {
+      const entry: Pending = { sentAt: nowMs(), timer: null, resolve };
+      entry.timer = setTimeout(() => this.onTimeout(), timeoutMs);
+      this.pending.push(entry);
+      this.port.write(JSON.stringify(command) + '\n');
+    });
+  }
+
+  async probe(timeoutMs: number): Promise<number | null> {
+    if (this.pending.length >= this.maxInFlight) {
+      return null;   // Counts as lost: the link could not keep up
+    }
+    const reply = await this.request({ action: 'get_motors' }, timeoutMs);
+    return reply ? reply.rtt : null;
+  }
+
+  unmatched(): number {
+    return this.unmatchedReplies;
+  }
+
+  /**
+   * Receive `stream_sensors` frames; null stops.
+   */
+  setStreamHandler(handler: ((frame: StreamFrame) => void) | null): void {
+    this.onStreamFrame = handler;
+  }
+
+  async devicePerf(reset: boolean): Promise<unknown> {
+    const reply = await this.request({ action: 'get_perf', commands: true, reset }, 1000);
+    return reply ? reply.body : null;
+  }
+
+  close(): Promise<void> {
+    this.failPending();
+    return new Promise((resolve) => this.port.close(() => resolve()));
+  }
+
+  private onData(data: Buffer): void {
+    this.lineBuffer += data.toString('utf8');
+    let newline: number;
+    while ((newline = this.lineBuffer.indexOf('\n')) >= 0) {
+      const line = this.lineBuffer.slice(0, newline).trim();
+      this.lineBuffer = this.lineBuffer.slice(newline + 1);
+      if (line.length > 0) this.onLine(line);
+    }
+  }
+
+  private onLine(line: string): void {
+    const received = nowMs();
+    let body: any;
+    try {
+      body = JSON.parse(line);
+    } catch {
+      return;   // Boot log or debug output
+    }
+
+    if (body.stream !== undefined) {
+      this.onStreamFrame?.({ receivedMs: received, body });
+      return;
+    }
+    if (body.status === undefined) {
+      return;
+    }
+    this.lastLineMs = received;
+
+    const entry = this.resyncing ? undefined : this.pending.shift();
+    if (!entry) {
+      this.unmatchedReplies++;
+      return;
+    }
+    if (entry.timer) clearTimeout(entry.timer);
+    entry.resolve({ rtt: received - entry.sentAt, body });
+  }
+
+  private onTimeout(): void {
+    if (this.resyncing) return;
+    this.resyncing = true;
+    this.failPending();
+    void this.resync();
+  }
+
+  private async resync(): Promise<void> {
+    this.lastLineMs = nowMs();
+    while (nowMs() - this.lastLineMs < RESYNC_QUIET_MS) {
+      await sleep(RESYNC_QUIET_MS / 4);
+    }
+    this.resyncing = false;
+  }
+
+  private failPending(): void {
+    for (const entry of this.pending) {
+      if (entry.timer) clearTimeout(entry.timer);
+      entry.resolve(null);
+    }
+    this.pending = [];
+  }
+}
+
+export interface SensorStreamResult {
+  rateHz: number;
+  frames: number;
+  receivedHz: number;
+  /** Sample slots missing from the `stream` numbering */
+  missedSlots: number;
+  /** Increase of the firmware's own `dropped` counter */
+  deviceDropped: number;
+  /** Gaps between frame arrivals on the host (ms) */
+  arrivalMs: IntervalSummary;
+  /** Gaps between the firmware's sample timestamps (ms) */
+  sampleMs: IntervalSummary;
+}
+
+/**
+ * Run `stream_sensors` at `rateHz` for `durationMs` and measure what
+ * arrives: rate, skipped slots, and jitter on both clocks.
+ */
+export async function measureSensorStream(
+  link: FlightControllerLink,
+  rateHz: number,
+  durationMs: number
+): Promise<SensorStreamResult> {
+  const arrivals: number[] = [];
+  const samples: number[] = [];
+  let firstSlot = -1;
+  let lastSlot = -1;
+  let firstDropped = -1;
+  let lastDropped = 0;
+
+  link.setStreamHandler((frame) => {
+    const { stream, us, dropped } = frame.body;
+    if (firstSlot < 0) {
+      firstSlot = stream;
+      firstDropped = dropped ?? 0;
+    }
+    lastSlot = stream;
+    lastDropped = dropped ?? 0;
+    arrivals.push(frame.receivedMs);
+    samples.push(us / 1000);
+  });
+
+  await link.request({ action: 'stream_sensors', rate_hz: rateHz }, 1000);
+  const start = nowMs();
+  await sleep(durationMs);
+  const elapsed = nowMs() - start;
+  await link.request({ action: 'stream_sensors', rate_hz: 0 }, 1000);
+  link.setStreamHandler(null);
+
+  const frames = arrivals.length;
+  return {
+    rateHz,
+    frames,
+    receivedHz: round(frames / (elapsed / 1000), 1),
+    missedSlots: frames > 0 ? Math.max(0, lastSlot - firstSlot + 1 - frames) : 0,
+    deviceDropped: frames > 0 ? lastDropped - firstDropped : 0,
+    arrivalMs: summarizeIntervals(arrivals),
+    sampleMs: summarizeIntervals(samples),
+  };
+}
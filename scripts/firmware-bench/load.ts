@@ -0,0 +1,206 @@
+/**
+ * Load Phases
+ *
+ * Protocol-independent drivers for request/response links: closed-loop
+ * latency, open-loop fixed-rate runs, a rate sweep that finds the highest
+ * sustainable command rate, and windowed soak runs that show drift over
+ * time (a slow leak, a queue that fills after ten minutes).
+ *
+ * A link only has to implement `probe()`: send one harmless query and
+ * resolve with its round-trip time, or null if no reply came in time.
+ */
+
+import { LatencySummary, nowMs, round, sleep, summarize } from './stats';
+
+export interface ProbeLink {
+  /** Send one query; resolves with the round trip in ms, or null if lost */
+  probe(timeoutMs: number): Promise<number | null>;
+  /** Replies that could not be matched to a probe (late or duplicate) */
+  unmatched(): number;
+}
+
+export interface RateResult {
+  targetHz: number;
+  sentHz: number;
+  receivedHz: number;
+  sent: number;
+  lost: number;
+  lossPct: number;
+  rttMs: LatencySummary;
+}
+
+export interface SweepCriteria {
+  maxLossPct: number;
+  maxP99Ms: number;
+}
+
+export interface SweepResult {
+  criteria: SweepCriteria;
+  steps: RateResult[];
+  /** Highest rate that met the criteria, 0 if none did */
+  maxSustainableHz: number;
+}
+
+export interface SoakResult {
+  overall: RateResult;
+  windowMs: number;
+  windows: RateResult[];
+}
+
+/**
+ * One query at a time, as fast as replies come back.
+ */
+export async function measureLatency(
+  link: ProbeLink,
+  count: number,
+  timeoutMs: number
+): Promise<RateResult> {
+  const start = nowMs();
+  const rtts: number[] = [];
+  let lost = 0;
+  for (let i = 0; i < count; i++) {
+    const rtt = await link.probe(timeoutMs);
+    if (rtt === null) lost++;
+    else rtts.push(rtt);
+  }
+  return rateResult(0, count, rtts, lost, nowMs() - start);
+}
+
+/**
+ * Send at a fixed rate regardless of replies (open loop), so a link that
+ * falls behind shows up as loss and growing latency rather than as a
+ * politely lower rate.
+ */
+export async function measureRate(
+  link: ProbeLink,
+  rateHz: number,
+  durationMs: number,
+  timeoutMs: number,
+  onWindow?: (result: RateResult) => void,
+  windowMs = 0
+): Promise<RateResult> {
+  const periodMs = 1000 / rateHz;
+  const start = nowMs();
+  const pending: Promise<void>[] = [];
+  const rtts: number[] = [];
+  let sent = 0;
+  let lost = 0;
+
+  // Per-window accumulators for soak runs
+  let windowStart = start;
+  let windowRtts: number[] = [];
+  let windowSent = 0;
+  let windowLost = 0;
+
+  const flushWindow = (now: number) => {
+    if (onWindow && windowSent > 0) {
+      onWindow(rateResult(rateHz, windowSent, windowRtts, windowLost, now - windowStart));
+    }
+    windowStart = now;
+    windowRtts = [];
+    windowSent = 0;
+    windowLost = 0;
+  };
+
+  while (nowMs() - start < durationMs) {
+    // Catch up on every slot that is due; timers are ~1 ms coarse
+    const due = Math.floor((nowMs() - start) / periodMs) + 1;
+    while (sent < due) {
+      sent++;
+      windowSent++;
+      pending.push(
+        link.probe(timeoutMs).then((rtt) => {
+          if (rtt === null) {
+            lost++;
+            windowLost++;
+          } else {
+            rtts.push(rtt);
+            windowRtts.push(rtt);
+          }
+        })
+      );
+    }
+
+    const now = nowMs();
+    if (windowMs > 0 && now - windowStart >= windowMs) {
+      flushWindow(now);
+    }
+    await sleep(Math.max(0, Math.min(periodMs, start + due * periodMs - now)));
+  }
+
+  const sendEnd = nowMs();
+  await Promise.all(pending);
+  if (windowMs > 0) flushWindow(nowMs());
+  return rateResult(rateHz, sent, rtts, lost, sendEnd - start);
+}
+
+/**
+ * Run each rate for `stepMs` and report the highest one that met the
+ * criteria. Stops after the first two failing steps in a row.
+ */
+export async function sweepRate(
+  link: ProbeLink,
+  rates: number[],
+  stepMs: number,
+  timeoutMs: number,
+  criteria: SweepCriteria,
+  log: (step: RateResult) => void = () => {}
+): Promise<SweepResult> {
+  const steps: RateResult[] = [];
+  let maxSustainableHz = 0;
+  let failures = 0;
+
+  for (const rate of rates) {
+    const step = await measureRate(link, rate, stepMs, timeoutMs);
+    steps.push(step);
+    log(step);
+
+    const sustained = step.lossPct <= criteria.maxLossPct &&
+      step.rttMs.p99 <= criteria.maxP99Ms &&
+      step.receivedHz >= rate * 0.95 * (1 - criteria.maxLossPct / 100);
+    if (sustained) {
+      maxSustainableHz = rate;
+      failures = 0;
+    } else if (++failures >= 2) {
+      break;
+    }
+    await sleep(Math.min(1000, timeoutMs));   // Let queues drain between steps
+  }
+
+  return { criteria, steps, maxSustainableHz };
+}
+
+export async function soak(
+  link: ProbeLink,
+  rateHz: number,
+  durationMs: number,
+  windowMs: number,
+  timeoutMs: number,
+  log: (window: RateResult) => void = () => {}
+): Promise<SoakResult> {
+  const windows: RateResult[] = [];
+  const overall = await measureRate(link, rateHz, durationMs, timeoutMs, (window) => {
+    windows.push(window);
+    log(window);
+  }, windowMs);
+  return { overall, windowMs, windows };
+}
+
+function rateResult(
+  targetHz: number,
+  sent: number,
+  rtts: number[],
+  lost: number,
+  elapsedMs: number
+): RateResult {
+  const seconds = Math.max(elapsedMs, 1) / 1000;
+  return {
+    targetHz,
+    sentHz: round(sent / seconds, 1),
+    receivedHz: round(rtts.length / seconds, 1),
+    sent,
+    lost,
+    lossPct: sent > 0 ? round((lost / sent) * 100, 2) : 0,
+    rttMs: summarize(rtts),
+  };
+}
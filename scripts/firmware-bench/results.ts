@@ -0,0 +1,101 @@
+/**
+ * Benchmark Results
+ *
+ * One JSON file per run, with the same shape for every target, so runs of
+ * different firmware versions can be diffed or compared automatically.
+ * `compareResults` flags metrics that got worse than a baseline by more
+ * than a tolerance; the CLI exits non-zero when it finds any.
+ */
+
+import * as fs from 'fs';
+
+export const RESULT_FORMAT = 1;
+
+export type BenchTarget = 'stepper' | 'fc' | 'cam';
+
+export interface BenchResult {
+  format: number;
+  target: BenchTarget;
+  /** Free-form run label, e.g. the firmware git revision */
+  label: string;
+  /** Version the firmware reports, if it reports one */
+  firmware: string | null;
+  endpoint: string;
+  startedAt: string;
+  durationS: number;
+  options: Record<string, unknown>;
+  /** Headline numbers used for comparisons; lower is better unless noted */
+  metrics: Record<string, number>;
+  /** Full phase results (latency, sweep, soak, stream) */
+  phases: Record<string, unknown>;
+  /** The firmware's own timings (get_perf or /perf) after the run */
+  devicePerf: unknown;
+}
+
+/** Metrics where a larger value is better */
+const HIGHER_IS_BETTER = new Set([
+  'max_sustainable_hz',
+  'stream_fps',
+  'sensor_stream_hz',
+]);
+
+export interface Regression {
+  metric: string;
+  baseline: number;
+  current: number;
+  changePct: number;
+}
+
+export function writeResult(path: string, result: BenchResult): void {
+  fs.writeFileSync(path, JSON.stringify(result, null, 2) + '\n');
+}
+
+export function readResult(path: string): BenchResult {
+  const result = JSON.parse(fs.readFileSync(path, 'utf8')) as BenchResult;
+  if (result.format !== RESULT_FORMAT) {
+    throw new Error(`${path}: unsupported result format ${result.format}`);
+  }
+  return result;
+}
+
+/**
+ * Metrics present in both runs that moved the wrong way by more than
+ * `tolerancePct`. Latencies below `floorMs` and loss below 0.1% are
+ * ignored; a 0.4 -> 0.6 ms change is noise on WiFi, not a regression.
+ */
+export function compareResults(
+  baseline: BenchResult,
+  current: BenchResult,
+  tolerancePct: number,
+  floorMs = 1
+): Regression[] {
+  if (baseline.target !== current.target) {
+    throw new Error(`Cannot compare a ${baseline.target} run with a ${current.target} run`);
+  }
+
+  const regressions: Regression[] = [];
+  for (const [metric, base] of Object.entries(baseline.metrics)) {
+    const value = current.metrics[metric];
+    if (value === undefined) continue;
+
+    const higherIsBetter = HIGHER_IS_BETTER.has(metric);
+    const worse = higherIsBetter ? value < base : value > base;
+    if (!worse) continue;
+    if (metric.endsWith('_ms') && Math.max(base, value) < floorMs) continue;
+    if (metric.endsWith('_pct') && Math.max(base, value) < 0.1) continue;
+
+    const changePct = base === 0 ? Infinity : ((value - base) / base) * 100;
+    if (base === 0 ? value > 0 : Math.abs(changePct) > tolerancePct) {
+      regressions.push({ metric, baseline: base, current: value, changePct });
+    }
+  }
+  return regressions;
+}
+
+export function formatRegressions(regressions: Regression[]): string {
+  if (regressions.length === 0) return 'No regressions against the baseline.';
+  return regressions.map((r) => {
+    const change = Number.isFinite(r.changePct) ? `${r.changePct.toFixed(1)}%` : 'new';
+    return `  REGRESSION ${r.metric}: ${r.baseline} -> ${r.current} (${change})`;
+  }).join('\n');
+}
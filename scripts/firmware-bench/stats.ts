@@ -0,0 +1,89 @@
+/**
+ * Latency Statistics
+ *
+ * Summaries shared by every benchmark: exact percentiles over the raw
+ * samples (a soak run keeps at most a few million numbers, so sorting is
+ * cheaper than being clever) and interval jitter for periodic streams.
+ */
+
+export interface LatencySummary {
+  count: number;
+  min: number;
+  mean: number;
+  p50: number;
+  p90: number;
+  p99: number;
+  p999: number;
+  max: number;
+}
+
+export interface IntervalSummary extends LatencySummary {
+  /** Standard deviation of the intervals */
+  jitter: number;
+}
+
+/**
+ * Nearest-rank percentile of an ascending array. The rank is rounded
+ * before ceil(), so 99.9% of 1000 samples is rank 999 and not 1000.
+ */
+export function percentile(sorted: number[], p: number): number {
+  if (sorted.length === 0) return 0;
+  const rank = Math.ceil(round((p / 100) * sorted.length, 6));
+  return sorted[Math.min(sorted.length - 1, Math.max(0, rank - 1))];
+}
+
+export function summarize(samples: number[]): LatencySummary {
+  if (samples.length === 0) {
+    return { count: 0, min: 0, mean: 0, p50: 0, p90: 0, p99: 0, p999: 0, max: 0 };
+  }
+
+  const sorted = Float64Array.from(samples).sort();
+  const values = Array.from(sorted);
+  let total = 0;
+  for (const value of values) total += value;
+
+  return {
+    count: values.length,
+    min: round(values[0]),
+    mean: round(total / values.length),
+    p50: round(percentile(values, 50)),
+    p90: round(percentile(values, 90)),
+    p99: round(percentile(values, 99)),
+    p999: round(percentile(values, 99.9)),
+    max: round(values[values.length - 1]),
+  };
+}
+
+/**
+ * Summarize the gaps between consecutive timestamps.
+ */
+export function summarizeIntervals(timestamps: number[]): IntervalSummary {
+  const intervals: number[] = [];
+  for (let i = 1; i < timestamps.length; i++) {
+    intervals.push(timestamps[i] - timestamps[i - 1]);
+  }
+
+  const summary = summarize(intervals);
+  let variance = 0;
+  for (const interval of intervals) {
+    variance += (interval - summary.mean) ** 2;
+  }
+  const jitter = intervals.length > 1 ? Math.sqrt(variance / (intervals.length - 1)) : 0;
+  return { ...summary, jitter: round(jitter) };
+}
+
+export function round(value: number, digits = 3): number {
+  const scale = 10 ** digits;
+  return Math.round(value * scale) / scale;
+}
+
+/**
+ * High-resolution monotonic clock in milliseconds.
+ */
+export function nowMs(): number {
+  return Number(process.hrtime.bigint()) / 1e6;
+}
+
+export function sleep(ms: number): Promise<void> {
+  return new Promise((resolve) => setTimeout(resolve, ms));
+}
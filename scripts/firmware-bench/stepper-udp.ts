@@ -0,0 +1,118 @@
+/**
+ * Stepper UDP Link
+ *
+ * Drives the stepper controller's JSON port (UDP 4210). Probes are
+ * `get_status` queries: they never move the wheels, bypass ACK
+ * coalescing, and echo the `seq` they were sent with, so replies can be
+ * matched even when they arrive out of order or not at all.
+ */
+
+import * as dgram from 'dgram';
+import { ProbeLink } from './load';
+import { nowMs, sleep } from './stats';
+
+export const STEPPER_PORT = 4210;
+
+interface Pending {
+  sentAt: number;
+  timer: NodeJS.Timeout;
+  resolve: (reply: { rtt: number; body: any } | null) => void;
+}
+
+export class StepperLink implements ProbeLink {
+  private socket: dgram.Socket;
+  private pending = new Map<number, Pending>();
+  private nextSeq = 1;
+  private unmatchedReplies = 0;
+
+  private constructor(socket: dgram.Socket) {
+    this.socket = socket;
+    this.socket.on('message', (data) => this.onMessage(data));
+  }
+
+  static async open(host: string, port = STEPPER_PORT): Promise<StepperLink> {
+    const socket = dgram.createSocket('udp4');
+    await new Promise<void>((resolve, reject) => {
+      socket.once('error', reject);
+      socket.connect(port, host, () => {
+        socket.off('error', reject);
+        resolve();
+      });
+    });
+
+    // Start a new sequence session so seq 1 is not stale against an
+    // earlier run; this command carries no seq itself
+    const link = new StepperLink(socket);
+    socket.send('{"cmd":"set_config","seq_reset":true}');
+    await sleep(200);
+    return link;
+  }
+
+  /**
+   * Send one command with the next seq and wait for its reply.
+   */
+  request(command: Record<string, unknown>, timeoutMs: number): Promise<{ rtt: number; body: any } | null> {
+    const seq = this.nextSeq;
+    this.nextSeq = (this.nextSeq + 1) & 0xffff || 1;
+
+    return new Promise((resolve) => {
+      const timer = setTimeout(() => {
+        this.pending.delete(seq);
+        resolve(null);
+      }, timeoutMs);
+      this.pending.set(seq, { sentAt: nowMs(), timer, resolve });
+      this.socket.send(JSON.stringify({ ...command, seq }));
+    });
+  }
+
+  async probe(timeoutMs: number): Promise<number | null> {
+    const reply = await this.request({ cmd: 'get_status' }, timeoutMs);
+    return reply ? reply.rtt : null;
+  }
+
+  unmatched(): number {
+    return this.unmatchedReplies;
+  }
+
+  /**
+   * The firmware's section and command timings (get_perf). The stepper
+   * returns one or the other per datagram, so this asks twice.
+   */
+  async devicePerf(reset: boolean): Promise<unknown> {
+    const sections = await this.request({ cmd: 'get_perf' }, 1000);
+    const commands = await this.request({ cmd: 'get_perf', commands: true, reset }, 1000);
+    return {
+      sections: sections?.body.sections ?? null,
+      commands: commands?.body.commands ?? null,
+    };
+  }
+
+  close(): void {
+    for (const entry of this.pending.values()) {
+      clearTimeout(entry.timer);
+      entry.resolve(null);
+    }
+    this.pending.clear();
+    this.socket.close();
+  }
+
+  private onMessage(data: Buffer): void {
+    const received = nowMs();
+    let body: any;
+    try {
+      body = JSON.parse(data.toString('utf8'));
+    } catch {
+      this.unmatchedReplies++;   // Binary frame or telemetry from another host
+      return;
+    }
+
+    const entry = typeof body.seq === 'number' ? this.pending.get(body.seq) : undefined;
+    if (!entry || body.error) {
+      this.unmatchedReplies++;   // Late, duplicate or stale_seq
+      return;
+    }
+    this.pending.delete(body.seq);
+    clearTimeout(entry.timer);
+    entry.resolve({ rtt: received - entry.sentAt, body });
+  }
+}